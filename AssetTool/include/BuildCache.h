@@ -0,0 +1,167 @@
+// Build cache for AssetTool build
+// - processed clips are stored under a key hashed from the input file's contents & the clip's
+// options, so an unchanged clip is never reprocessed, whatever its file timestamps
+// - one file per entry, <dir>/<key>.clip, written via a temporary file & rename so concurrent
+// workers & interrupted builds never leave a partial entry
+// - entry: CachedClipHeader, the encoded clip data, then the envelope track (if any)
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <sys/stat.h>
+#ifdef _WIN32
+#   include <direct.h>
+#endif
+
+// Bump when processing changes, so stale entries miss
+static const uint32_t kBuildCacheVersion = 3;
+
+// FNV-1a, 64-bit
+inline uint64_t BuildHash(const void *data, size_t len, uint64_t hash=0xcbf29ce484222325ull)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    for( size_t i=0; i<len; i++ )
+    {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Create a directory, if it doesn't exist already
+inline void MakeDir(const std::string & dir)
+{
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0777);
+#endif
+}
+
+// Read a whole file
+inline bool ReadFileBytes(const char *path, std::vector<uint8_t> & bytes)
+{
+    FILE *file = fopen(path, "rb");
+    if( file == nullptr )
+        return false;
+    bytes.clear();
+    uint8_t chunk[65536];
+    size_t n;
+    while( (n = fread(chunk, 1, sizeof(chunk), file)) > 0 )
+        bytes.insert(bytes.end(), chunk, chunk + n);
+    fclose(file);
+    return true;
+}
+
+struct CachedClipHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_bytes;
+    uint32_t num_samples;
+    uint32_t samplerate;
+    uint8_t bits_per_sample;
+    uint8_t codec;
+    uint8_t reserved[2];
+    uint32_t envelope_bytes;
+};
+
+struct CachedClip
+{
+    CachedClipHeader header;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> envelope;
+};
+
+class BuildCache
+{
+public:
+    static const uint32_t kMagic = 0x31435441;  // "ATC1"
+
+    // dir: empty to disable the cache
+    BuildCache(const std::string & dir)
+        : dir_(dir)
+    {
+        if( !dir_.empty() )
+            MakeDir(dir_);
+    }
+
+    bool IsEnabled() const
+    {
+        return !dir_.empty();
+    }
+
+    static uint64_t Key(const std::vector<uint8_t> & input, const std::string & options)
+    {
+        uint64_t hash = BuildHash(&kBuildCacheVersion, sizeof(kBuildCacheVersion));
+        hash = BuildHash(options.c_str(), options.size(), hash);
+        return BuildHash(input.empty() ? nullptr : &input[0], input.size(), hash);
+    }
+
+    bool Load(uint64_t key, CachedClip & clip) const
+    {
+        if( !IsEnabled() )
+            return false;
+        std::vector<uint8_t> bytes;
+        if( !ReadFileBytes(_Path(key).c_str(), bytes) || (bytes.size() < sizeof(CachedClipHeader)) )
+            return false;
+        memcpy(&clip.header, &bytes[0], sizeof(clip.header));
+        if( (clip.header.magic != kMagic) || (clip.header.version != kBuildCacheVersion) ||
+            ((uint64_t)clip.header.num_bytes + clip.header.envelope_bytes != bytes.size() - sizeof(CachedClipHeader)) )
+        {
+            return false;
+        }
+        auto data = bytes.begin() + sizeof(CachedClipHeader);
+        clip.data.assign(data, data + clip.header.num_bytes);
+        clip.envelope.assign(data + clip.header.num_bytes, bytes.end());
+        return true;
+    }
+
+    // Thread-safe
+    bool Store(uint64_t key, const CachedClip & clip) const
+    {
+        if( !IsEnabled() )
+            return false;
+        static std::atomic<unsigned int> tmp_count(0);
+        std::string path = _Path(key);
+        std::string tmp_path = path + "." + std::to_string(tmp_count++) + ".tmp";
+        FILE *file = fopen(tmp_path.c_str(), "wb");
+        if( file == nullptr )
+            return false;
+        CachedClipHeader header = clip.header;
+        header.magic = kMagic;
+        header.version = kBuildCacheVersion;
+        header.num_bytes = clip.data.size();
+        header.envelope_bytes = clip.envelope.size();
+        bool ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+        if( ok && !clip.data.empty() )
+            ok = (fwrite(&clip.data[0], clip.data.size(), 1, file) == 1);
+        if( ok && !clip.envelope.empty() )
+            ok = (fwrite(&clip.envelope[0], clip.envelope.size(), 1, file) == 1);
+        ok = (fclose(file) == 0) && ok;
+#ifdef _WIN32
+        remove(path.c_str());   // rename() won't replace an existing file
+#endif
+        ok = ok && (rename(tmp_path.c_str(), path.c_str()) == 0);
+        if( !ok )
+            remove(tmp_path.c_str());
+        return ok;
+    }
+
+private:
+    std::string _Path(uint64_t key) const
+    {
+        char name[24];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+        return dir_ + "/" + name + ".clip";
+    }
+
+    std::string dir_;
+};
+
+// vim: sw=4:ts=4
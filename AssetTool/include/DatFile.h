@@ -0,0 +1,83 @@
+// Reader & writer for the .dat PCM include files
+// - comma-separated C integer literals (e.g. "0x80, 0x7f," or "0xffc7,"), as included into the
+// sketches' data arrays
+// - 8-bit files hold unsigned samples, 16-bit files hold the int16_t bit patterns
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <vector>
+
+// Parse .dat file text as bytes of bits_per_sample samples (16-bit little-endian)
+// - returns false if the text holds an out-of-range value
+inline bool ParseDat(const char *text, unsigned int bits_per_sample, std::vector<uint8_t> & data)
+{
+    const unsigned long max_val = (bits_per_sample == 8) ? 0xff : 0xffff;
+    data.clear();
+    const char *p = text;
+    while( *p )
+    {
+        if( !isdigit((unsigned char)*p) )
+        {
+            p++;
+            continue;
+        }
+        char *end;
+        unsigned long val = strtoul(p, &end, 0);
+        if( val > max_val )
+            return false;
+        data.push_back((uint8_t)val);
+        if( bits_per_sample == 16 )
+            data.push_back((uint8_t)(val >> 8));
+        p = end;
+    }
+    return true;
+}
+
+// Read a .dat file as bytes of bits_per_sample samples (16-bit little-endian)
+// - returns false if the file can't be read or holds an out-of-range value
+inline bool ReadDatFile(const char *path, unsigned int bits_per_sample, std::vector<uint8_t> & data)
+{
+    FILE *file = fopen(path, "rb");
+    if( file == nullptr )
+        return false;
+
+    std::vector<char> text;
+    char chunk[4096];
+    size_t n;
+    while( (n = fread(chunk, 1, sizeof(chunk), file)) > 0 )
+    {
+        text.insert(text.end(), chunk, chunk + n);
+    }
+    fclose(file);
+    text.push_back('\0');
+    return ParseDat(&text[0], bits_per_sample, data);
+}
+
+// Write bytes of bits_per_sample samples as a .dat file
+// - same layout as the existing data files: 16 8-bit or 8 16-bit values per line
+// - returns false if the file can't be written
+inline bool WriteDatFile(const char *path, unsigned int bits_per_sample, const std::vector<uint8_t> & data)
+{
+    FILE *file = fopen(path, "wb");
+    if( file == nullptr )
+        return false;
+
+    const unsigned int per_line = (bits_per_sample == 8) ? 16 : 8;
+    const unsigned int bytes_per_sample = bits_per_sample / 8;
+    size_t num_samples = data.size() / bytes_per_sample;
+    for( size_t i=0; i<num_samples; i++ )
+    {
+        if( bits_per_sample == 8 )
+            fprintf(file, "0x%02x,", data[i]);
+        else
+            fprintf(file, "0x%04x,", data[2 * i] | (data[2 * i + 1] << 8));
+        fputc(((i % per_line == per_line - 1) || (i + 1 == num_samples)) ? '\n' : ' ', file);
+    }
+    return fclose(file) == 0;
+}
+
+// vim: sw=4:ts=4
@@ -0,0 +1,197 @@
+// Asset build manifest
+// - line-oriented text, '#' starts a comment:
+//      bank <file>                     output a packed asset bank
+//      dat <dir>                       or output one .dat include file per clip, <dir>/<name>.dat
+//      defaults <option> ...           options for the clips that follow
+//      clip <name> <input> <option> ...
+// - inputs are .wav files, or .dat files (which need in_rate & in_bits)
+// - clip options:
+//      rate=<Hz>                       output samplerate, default: the input's
+//      bits=8|16                       output bit depth, default 8
+//      codec=<codec>                   pcm (default), adpcm, ulaw, alaw, lz, rle
+//      normalize[=<dBFS>]              scale the peak to dBFS (default -1), after trimming
+//      trim[=<dBFS>]                   drop leading/trailing silence below dBFS (default -60, any bit
+//                                      depth), also the rle codec's silence threshold
+//      envelope                        also output the clip's envelope track (see DAC/include/Envelope.h)
+//      in_rate=<Hz> in_bits=8|16       .dat input format
+// - paths are relative to the manifest's directory
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <sstream>
+
+struct ManifestClip
+{
+    std::string name;
+    std::string input;          // resolved path
+    std::string codec = "pcm";
+    unsigned int rate = 0;      // 0: same as input
+    unsigned int bits = 8;
+    bool normalize = false;
+    double normalize_dBFS = -1.0;
+    bool trim = false;
+    double trim_dBFS = -60.0;   // as kSilence_dBFS
+    bool envelope = false;
+    unsigned int in_rate = 0;
+    unsigned int in_bits = 0;
+    int line = 0;
+
+    // Everything that affects the output, for build cache keys
+    std::string OptionsKey() const
+    {
+        char key[160];
+        snprintf(key, sizeof(key), "codec=%s rate=%u bits=%u normalize=%d/%.3f trim=%d/%.3f in=%u/%u envelope=%d",
+                codec.c_str(), rate, bits, normalize, normalize_dBFS, trim, trim_dBFS, in_rate, in_bits, envelope);
+        return key;
+    }
+};
+
+struct Manifest
+{
+    enum class Output
+    {
+        None,
+        Bank,
+        Dat,
+    };
+
+    Output output = Output::None;
+    std::string output_path;    // resolved
+    std::vector<ManifestClip> clips;
+};
+
+// Apply one key[=value] option
+// - returns false for an unknown option or bad value
+inline bool _ManifestOption(ManifestClip & clip, const std::string & option)
+{
+    size_t eq = option.find('=');
+    std::string key = option.substr(0, eq);
+    std::string value = (eq == std::string::npos) ? "" : option.substr(eq + 1);
+    unsigned long num = strtoul(value.c_str(), nullptr, 10);
+    if( key == "rate" )
+        clip.rate = num;
+    else if( key == "bits" )
+        clip.bits = num;
+    else if( key == "codec" )
+        clip.codec = value;
+    else if( key == "in_rate" )
+        clip.in_rate = num;
+    else if( key == "in_bits" )
+        clip.in_bits = num;
+    else if( key == "normalize" )
+    {
+        clip.normalize = true;
+        if( !value.empty() )
+            clip.normalize_dBFS = atof(value.c_str());
+        return clip.normalize_dBFS <= 0.0;
+    }
+    else if( key == "trim" )
+    {
+        clip.trim = true;
+        if( !value.empty() )
+            clip.trim_dBFS = atof(value.c_str());
+        return clip.trim_dBFS < 0.0;
+    }
+    else if( key == "envelope" )
+        clip.envelope = true;
+    else
+        return false;
+    return ((clip.bits == 8) || (clip.bits == 16)) && ((clip.in_bits == 0) || (clip.in_bits == 8) || (clip.in_bits == 16));
+}
+
+// Read a manifest
+// - returns false on a syntax error, with a message in error
+inline bool ReadManifest(const char *path, Manifest & manifest, std::string & error)
+{
+    FILE *file = fopen(path, "rb");
+    if( file == nullptr )
+    {
+        error = std::string("can't read ") + path;
+        return false;
+    }
+    std::string text;
+    char chunk[4096];
+    size_t n;
+    while( (n = fread(chunk, 1, sizeof(chunk), file)) > 0 )
+        text.append(chunk, n);
+    fclose(file);
+
+    std::string dir(path);
+    size_t slash = dir.find_last_of("/\\");
+    dir = (slash == std::string::npos) ? "" : dir.substr(0, slash + 1);
+    auto resolve = [&](const std::string & rel) {
+        return ((rel[0] == '/') || dir.empty()) ? rel : dir + rel;
+    };
+
+    ManifestClip defaults;
+    std::istringstream lines(text);
+    std::string line;
+    int line_num = 0;
+    while( std::getline(lines, line) )
+    {
+        line_num++;
+        size_t hash = line.find('#');
+        if( hash != std::string::npos )
+            line.erase(hash);
+        std::istringstream words(line);
+        std::vector<std::string> args;
+        std::string word;
+        while( words >> word )
+            args.push_back(word);
+        if( args.empty() )
+            continue;
+
+        char where[32];
+        snprintf(where, sizeof(where), "line %d: ", line_num);
+        if( ((args[0] == "bank") || (args[0] == "dat")) && (args.size() == 2) )
+        {
+            manifest.output = (args[0] == "bank") ? Manifest::Output::Bank : Manifest::Output::Dat;
+            manifest.output_path = resolve(args[1]);
+        }
+        else if( args[0] == "defaults" )
+        {
+            for( size_t i=1; i<args.size(); i++ )
+            {
+                if( !_ManifestOption(defaults, args[i]) )
+                {
+                    error = where + ("bad option " + args[i]);
+                    return false;
+                }
+            }
+        }
+        else if( (args[0] == "clip") && (args.size() >= 3) )
+        {
+            ManifestClip clip = defaults;
+            clip.name = args[1];
+            clip.input = resolve(args[2]);
+            clip.line = line_num;
+            for( size_t i=3; i<args.size(); i++ )
+            {
+                if( !_ManifestOption(clip, args[i]) )
+                {
+                    error = where + ("bad option " + args[i]);
+                    return false;
+                }
+            }
+            manifest.clips.push_back(clip);
+        }
+        else
+        {
+            error = where + ("can't parse: " + line);
+            return false;
+        }
+    }
+    if( manifest.output == Manifest::Output::None )
+    {
+        error = "no output, need a bank or dat line";
+        return false;
+    }
+    return true;
+}
+
+// vim: sw=4:ts=4
@@ -0,0 +1,128 @@
+// Reader for RIFF/WAVE files
+// - PCM 8/16/24/32-bit integer & 32-bit float, incl. WAVE_FORMAT_EXTENSIBLE
+// - any channel count, downmixed to mono (average of the channels)
+// - samples come out as 16-bit signed, the source depth is kept for reporting
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+struct WavData
+{
+    std::vector<int16_t> samples;   // mono
+    unsigned int samplerate;
+    unsigned int bits_per_sample;   // as stored
+    unsigned int num_channels;
+};
+
+inline uint32_t _WavLe32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline uint16_t _WavLe16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// One channel sample, as 32-bit signed full scale
+inline int32_t _WavSample32(const uint8_t *p, unsigned int bytes_per_sample, bool is_float)
+{
+    if( is_float )
+    {
+        float val;
+        memcpy(&val, p, sizeof(val));
+        if( !(val > -1.0f) )    // incl. NaN
+            return INT32_MIN;
+        if( val >= 1.0f )
+            return INT32_MAX;
+        return (int32_t)lrintf(val * 2147483647.0f);
+    }
+    switch( bytes_per_sample )
+    {
+    case 1:
+        return (int32_t)((uint32_t)(p[0] ^ 0x80) << 24);   // 8-bit WAV is unsigned
+    case 2:
+        return (int32_t)((uint32_t)_WavLe16(p) << 16);
+    case 3:
+        return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+    default:
+        return (int32_t)_WavLe32(p);
+    }
+}
+
+// Parse a WAV file image
+// - returns false if it isn't a WAV file, or isn't in a supported format
+inline bool ParseWav(const uint8_t *file, size_t len, WavData & wav)
+{
+    if( (len < 12) || (memcmp(file, "RIFF", 4) != 0) || (memcmp(file + 8, "WAVE", 4) != 0) )
+        return false;
+
+    const uint8_t *fmt = nullptr;
+    const uint8_t *data = nullptr;
+    uint32_t data_len = 0;
+    size_t pos = 12;
+    while( pos + 8 <= len )
+    {
+        uint32_t chunk_len = _WavLe32(file + pos + 4);
+        const uint8_t *chunk = file + pos + 8;
+        size_t avail = len - pos - 8;
+        if( memcmp(file + pos, "fmt ", 4) == 0 )
+        {
+            if( (chunk_len < 16) || (chunk_len > avail) )
+                return false;
+            fmt = chunk;
+        }
+        else if( memcmp(file + pos, "data", 4) == 0 )
+        {
+            data = chunk;
+            data_len = (chunk_len <= avail) ? chunk_len : (uint32_t)avail;    // tolerate truncated files
+        }
+        pos += 8 + (size_t)chunk_len + (chunk_len & 1);    // chunks are padded to even
+    }
+    if( (fmt == nullptr) || (data == nullptr) )
+        return false;
+
+    uint16_t format = _WavLe16(fmt);
+    if( format == 0xfffe )
+    {
+        // WAVE_FORMAT_EXTENSIBLE: sub-format GUID starts with the format tag
+        if( _WavLe32(fmt - 4) < 40 )
+            return false;
+        format = _WavLe16(fmt + 24);
+    }
+    wav.num_channels = _WavLe16(fmt + 2);
+    wav.samplerate = _WavLe32(fmt + 4);
+    wav.bits_per_sample = _WavLe16(fmt + 14);
+    bool is_float = (format == 3);
+    if( (format != 1) && !(is_float && (wav.bits_per_sample == 32)) )
+        return false;
+    if( (wav.num_channels == 0) || (wav.samplerate == 0) || (wav.bits_per_sample == 0) ||
+        (wav.bits_per_sample > 32) || (wav.bits_per_sample % 8 != 0) )
+    {
+        return false;
+    }
+
+    unsigned int bytes_per_sample = wav.bits_per_sample / 8;
+    unsigned int frame_len = bytes_per_sample * wav.num_channels;
+    size_t num_frames = data_len / frame_len;
+    wav.samples.resize(num_frames);
+    for( size_t i=0; i<num_frames; i++ )
+    {
+        const uint8_t *frame = data + i * frame_len;
+        int64_t sum = 0;
+        for( unsigned int ch=0; ch<wav.num_channels; ch++ )
+            sum += _WavSample32(frame + ch * bytes_per_sample, bytes_per_sample, is_float);
+        // round to 16-bit
+        int64_t val = (sum / (int64_t)wav.num_channels + 0x8000) >> 16;
+        if( val > 32767 )
+            val = 32767;
+        wav.samples[i] = (int16_t)val;
+    }
+    return true;
+}
+
+// vim: sw=4:ts=4
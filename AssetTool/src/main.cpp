@@ -0,0 +1,604 @@
+// AssetTool
+// - host tool for asset banks (see DAC/include/AssetBankFormat.h)
+// - usage:
+//      AssetTool pack <bank> <name>=<file.dat>:<samplerate>:<bits>[:<codec>] ...
+//          - packs .dat PCM include files into a bank image, reporting each clip's savings
+//          - codec, default pcm (stored as is):
+//              - adpcm: IMA-ADPCM, 4 bits per sample (see DAC/include/Adpcm.h)
+//              - ulaw, alaw: G.711 companded, 8 bits per sample (see DAC/include/Companding.h)
+//              - lz: LZ block-compressed, lossless (see DAC/include/Lz.h)
+//              - rle: leading/trailing silence trimmed, internal silence run-length encoded
+//              (see DAC/include/Silence.h)
+//      AssetTool list <bank>
+//          - lists a bank's clips, reading it the same way the sketches do (mmap)
+//      AssetTool build <manifest> [-j <threads>] [--no-cache]
+//          - builds a bank or .dat include files from WAV (or .dat) sources, see Manifest.h
+//          - per clip: trim, normalize, resample (16-tap), convert bit depth (TPDF dither), encode
+//          - clips are processed in parallel, one worker per core by default
+//          - incremental: processed clips are cached in <manifest>.cache, keyed on the input's
+//          contents & the clip's options (see BuildCache.h), unchanged .dat outputs aren't rewritten
+// - flash a bank to its partition with e.g.
+//      esptool.py write_flash <assets partition offset> <bank>
+//  - see Player/partitions.csv
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include "DatFile.h"
+#include "WavFile.h"
+#include "Manifest.h"
+#include "BuildCache.h"
+#include "../../DAC/include/AssetBankWriter.h"
+#include "../../DAC/include/AssetBank.h"
+#include "../../DAC/include/Adpcm.h"
+#include "../../DAC/include/Companding.h"
+#include "../../DAC/include/Lz.h"
+#include "../../DAC/include/Silence.h"
+#include "../../DAC/include/DacRender.h"
+#include "../../DAC/include/Resampler.h"
+#include "../../DAC/include/SampleConvert.h"
+#include "../../DAC/include/Envelope.h"
+
+struct CodecInfo
+{
+    ClipCodec codec;
+    const char *name;
+};
+static const CodecInfo kCodecs[] =
+{
+    { ClipCodec::Pcm,       "pcm" },
+    { ClipCodec::ImaAdpcm,  "adpcm" },
+    { ClipCodec::MuLaw,     "ulaw" },
+    { ClipCodec::ALaw,      "alaw" },
+    { ClipCodec::Lz,        "lz" },
+    { ClipCodec::SilenceRle, "rle" },
+};
+
+static const char * CodecName(uint8_t codec)
+{
+    if( codec == (uint8_t)ClipCodec::Envelope )
+        return "env";
+    for( const CodecInfo & info : kCodecs )
+    {
+        if( (uint8_t)info.codec == codec )
+            return info.name;
+    }
+    return "?";
+}
+
+static bool ParseCodec(const std::string & name, ClipCodec & codec)
+{
+    for( const CodecInfo & info : kCodecs )
+    {
+        if( name == info.name )
+        {
+            codec = info.codec;
+            return true;
+        }
+    }
+    return false;
+}
+
+// PCM bytes (8-bit unsigned or 16-bit little-endian) to 16-bit samples
+static std::vector<int16_t> ToSamples16(const std::vector<uint8_t> & data, unsigned int bits)
+{
+    std::vector<int16_t> samples;
+    if( bits == 8 )
+    {
+        for( uint8_t val : data )
+            samples.push_back(ConvertSampleTo16Bit(val));
+    }
+    else
+    {
+        for( size_t i=0; i+1<data.size(); i+=2 )
+            samples.push_back((int16_t)(data[i] | (data[i + 1] << 8)));
+    }
+    return samples;
+}
+
+// Encode PCM data as read by ReadDatFile()
+// - bits & num_samples are updated to the decoded sample size & length
+// - detail gets any codec-specific notes for the report
+// - silence_dBFS: threshold for the rle codec, as for TrimSilence()
+static std::vector<uint8_t> Encode(const std::vector<uint8_t> & data, unsigned int & bits, unsigned int & num_samples,
+        ClipCodec codec, std::string & detail, double silence_dBFS=kSilence_dBFS)
+{
+    if( codec == ClipCodec::Pcm )
+        return data;
+    if( codec == ClipCodec::Lz )
+        return LzEncode(data.empty() ? nullptr : &data[0], data.size());   // lossless, bits as is
+    if( codec == ClipCodec::SilenceRle )
+    {
+        SilenceEncoded encoded = SilenceEncode(data.empty() ? nullptr : &data[0], num_samples, bits, silence_dBFS);
+        char note[96];
+        snprintf(note, sizeof(note), ", trimmed %u lead + %u tail samples, %u runs (%u samples)",
+                encoded.lead_trimmed, encoded.tail_trimmed, encoded.num_runs, encoded.run_samples);
+        detail = note;
+        num_samples = encoded.num_samples;
+        return encoded.data;
+    }
+
+    std::vector<int16_t> samples = ToSamples16(data, bits);
+    bits = 16;
+
+    std::vector<uint8_t> encoded;
+    switch( codec )
+    {
+    case ClipCodec::ImaAdpcm:
+        encoded = AdpcmEncode(samples.empty() ? nullptr : &samples[0], samples.size());
+        break;
+    case ClipCodec::MuLaw:
+        for( int16_t sample : samples )
+            encoded.push_back(MuLawEncode(sample));
+        break;
+    case ClipCodec::ALaw:
+        for( int16_t sample : samples )
+            encoded.push_back(ALawEncode(sample));
+        break;
+    default:
+        assert(false);
+    }
+    return encoded;
+}
+
+// <name>=<file.dat>:<samplerate>:<bits>[:<codec>]
+static bool AddClip(AssetBankWriter & writer, const char *spec)
+{
+    std::string s(spec);
+    ClipCodec codec = ClipCodec::Pcm;
+    size_t last_colon = s.rfind(':');
+    if( last_colon != std::string::npos )
+    {
+        if( ParseCodec(s.substr(last_colon + 1), codec) )
+            s.erase(last_colon);
+    }
+    size_t eq = s.find('=');
+    size_t colon2 = s.rfind(':');
+    size_t colon1 = (colon2 == std::string::npos || colon2 == 0) ? std::string::npos : s.rfind(':', colon2 - 1);
+    if( (eq == std::string::npos) || (colon1 == std::string::npos) || (colon1 < eq) )
+    {
+        fprintf(stderr, "bad clip spec: %s\n", spec);
+        return false;
+    }
+    std::string name = s.substr(0, eq);
+    std::string path = s.substr(eq + 1, colon1 - eq - 1);
+    unsigned int samplerate = atoi(s.substr(colon1 + 1, colon2 - colon1 - 1).c_str());
+    unsigned int bits = atoi(s.substr(colon2 + 1).c_str());
+    if( (samplerate == 0) || ((bits != 8) && (bits != 16)) )
+    {
+        fprintf(stderr, "bad samplerate/bits: %s\n", spec);
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    if( !ReadDatFile(path.c_str(), bits, data) )
+    {
+        fprintf(stderr, "can't read %s\n", path.c_str());
+        return false;
+    }
+    unsigned int num_samples = data.size() / (bits / 8);
+    unsigned int raw_samples = num_samples;
+    unsigned int raw_bytes = data.size();
+    std::string detail;
+    data = Encode(data, bits, num_samples, codec, detail);
+    if( writer.Add(name.c_str(), data.empty() ? nullptr : &data[0], data.size(), num_samples, samplerate, bits, codec) < 0 )
+    {
+        fprintf(stderr, "can't add %s (name too long or duplicate)\n", name.c_str());
+        return false;
+    }
+
+    double saved = (raw_bytes > 0) ? 100.0 - 100.0 * data.size() / raw_bytes : 0.0;
+    printf("%-24s %-5s %8u -> %8u bytes (%5.1f%% saved), %7.1f -> %7.1f ms%s\n", name.c_str(),
+            CodecName((uint8_t)codec), raw_bytes, (unsigned int)data.size(), saved,
+            raw_samples * 1000.0 / samplerate, num_samples * 1000.0 / samplerate, detail.c_str());
+    return true;
+}
+
+static const int kUsageError = 2;
+
+static int Pack(int argc, char *argv[])
+{
+    if( argc < 4 )
+        return kUsageError;
+
+    AssetBankWriter writer;
+    for( int i=3; i<argc; i++ )
+    {
+        if( !AddClip(writer, argv[i]) )
+            return 1;
+    }
+    if( !writer.Write(argv[2]) )
+    {
+        fprintf(stderr, "can't write %s\n", argv[2]);
+        return 1;
+    }
+    printf("wrote %s, %d clips\n", argv[2], argc - 3);
+    return 0;
+}
+
+static int List(int argc, char *argv[])
+{
+    if( argc != 3 )
+        return kUsageError;
+
+    AssetBank bank;
+    if( !bank.OpenFile(argv[2]) )
+    {
+        fprintf(stderr, "can't open %s (missing or not a valid bank)\n", argv[2]);
+        return 1;
+    }
+    printf("%-4s %-24s %8s %5s %-5s %9s %9s\n", "id", "name", "Hz", "bits", "codec", "samples", "bytes");
+    for( unsigned int id=0; id<bank.GetNumClips(); id++ )
+    {
+        const AssetClipEntry *clip = bank.Get(id);
+        printf("%-4u %-24s %8u %5u %-5s %9u %9u\n", id, clip->name, clip->samplerate,
+                clip->bits_per_sample, CodecName(clip->codec), clip->num_samples, clip->num_bytes);
+    }
+    return 0;
+}
+
+//-----------------------------------
+// build
+
+// Drop leading & trailing samples below threshold_dBFS, the same level as the rle codec's
+static void TrimSilence(std::vector<int16_t> & samples, double threshold_dBFS)
+{
+    const int threshold = SilenceThreshold(threshold_dBFS);
+    auto is_silent = [&](size_t idx) {
+        return (samples[idx] >= -threshold) && (samples[idx] <= threshold);
+    };
+    size_t end = samples.size();
+    while( (end > 0) && is_silent(end - 1) )
+        end--;
+    size_t start = 0;
+    while( (start < end) && is_silent(start) )
+        start++;
+    samples.erase(samples.begin() + end, samples.end());
+    samples.erase(samples.begin(), samples.begin() + start);
+}
+
+// Scale the peak to dBFS
+static void Normalize(std::vector<int16_t> & samples, double dBFS)
+{
+    int peak = 0;
+    for( int16_t val : samples )
+        peak = (abs(val) > peak) ? abs(val) : peak;
+    if( peak == 0 )
+        return;
+    double gain = 32767.0 * pow(10.0, dBFS / 20.0) / peak;
+    for( int16_t & val : samples )
+    {
+        long scaled = lrint(val * gain);
+        val = (int16_t)((scaled > 32767) ? 32767 : (scaled < -32768) ? -32768 : scaled);
+    }
+}
+
+// Via the sketches' own Resampler, trimmed to the nominal output length (drops the filter tail)
+static std::vector<int16_t> Resample(const std::vector<int16_t> & samples, unsigned int from_Hz, unsigned int to_Hz)
+{
+    std::vector<int16_t> out;
+    if( samples.empty() )
+        return out;
+    BufferSource source(&samples[0], samples.size(), 16);
+    Resampler resampler(&source, from_Hz, to_Hz, ResampleQuality::Taps16);
+    int16_t block[256];
+    unsigned int n;
+    while( (n = resampler.Read(block, 256)) > 0 )
+        out.insert(out.end(), block, block + n);
+    size_t expected = (size_t)(((uint64_t)samples.size() * to_Hz + from_Hz - 1) / from_Hz);
+    if( out.size() > expected )
+        out.resize(expected);
+    return out;
+}
+
+// Process one manifest clip from its input file's contents
+static bool ProcessClip(const ManifestClip & spec, const std::vector<uint8_t> & input, CachedClip & clip,
+        std::string & detail, std::string & error)
+{
+    ClipCodec codec;
+    if( !ParseCodec(spec.codec, codec) )
+    {
+        error = "unknown codec " + spec.codec;
+        return false;
+    }
+
+    // input as 16-bit mono
+    std::vector<int16_t> samples;
+    unsigned int samplerate;
+    const std::string & path = spec.input;
+    if( (path.size() >= 4) && (strcasecmp(path.c_str() + path.size() - 4, ".wav") == 0) )
+    {
+        WavData wav;
+        if( !ParseWav(input.empty() ? nullptr : &input[0], input.size(), wav) )
+        {
+            error = "not a supported WAV file (PCM 8/16/24/32-bit or 32-bit float)";
+            return false;
+        }
+        samples.swap(wav.samples);
+        samplerate = wav.samplerate;
+    }
+    else
+    {
+        if( (spec.in_rate == 0) || (spec.in_bits == 0) )
+        {
+            error = ".dat input needs in_rate & in_bits";
+            return false;
+        }
+        std::string text(input.begin(), input.end());
+        std::vector<uint8_t> data;
+        if( !ParseDat(text.c_str(), spec.in_bits, data) )
+        {
+            error = "bad .dat value";
+            return false;
+        }
+        samples = ToSamples16(data, spec.in_bits);
+        samplerate = spec.in_rate;
+    }
+
+    if( spec.trim )
+        TrimSilence(samples, spec.trim_dBFS);
+    if( spec.normalize )
+        Normalize(samples, spec.normalize_dBFS);
+    if( (spec.rate != 0) && (spec.rate != samplerate) )
+    {
+        samples = Resample(samples, samplerate, spec.rate);
+        samplerate = spec.rate;
+    }
+
+    // ADPCM & companding encode from 16-bit whatever the bits option, the rest store bits as given
+    unsigned int bits = spec.bits;
+    if( (codec == ClipCodec::ImaAdpcm) || (codec == ClipCodec::MuLaw) || (codec == ClipCodec::ALaw) )
+        bits = 16;
+    std::vector<uint8_t> data;
+    if( bits == 8 )
+    {
+        // samples that are 8-bit already (unprocessed 8-bit input) convert exactly, the rest dithered
+        bool exact = true;
+        for( int16_t val : samples )
+            exact = exact && ((val & 0xff) == 0);
+        data.resize(samples.size());
+        SampleConverter converter(exact ? ConvertMode::Truncate : ConvertMode::Dither);
+        if( !samples.empty() )
+            converter.Convert(&samples[0], &data[0], samples.size());
+    }
+    else
+    {
+        for( int16_t val : samples )
+        {
+            data.push_back((uint8_t)(val & 0xff));
+            data.push_back((uint8_t)((uint16_t)val >> 8));
+        }
+    }
+
+    unsigned int num_samples = samples.size();
+    clip.envelope.clear();
+    if( spec.envelope )
+    {
+        clip.envelope = EnvelopeBuild(data.empty() ? nullptr : &data[0], num_samples, bits,
+                EnvelopeHopLen(samplerate), EnvelopeWindowLen(samplerate));
+    }
+    clip.data = Encode(data, bits, num_samples, codec, detail, spec.trim_dBFS);
+    memset(&clip.header, 0, sizeof(clip.header));
+    clip.header.num_samples = num_samples;
+    clip.header.samplerate = samplerate;
+    clip.header.bits_per_sample = (uint8_t)bits;
+    clip.header.codec = (uint8_t)codec;
+    return true;
+}
+
+struct BuildResult
+{
+    CachedClip clip;
+    bool ok = false;
+    bool cached = false;
+    double ms = 0.0;
+    std::string detail;
+    std::string error;
+};
+
+static void BuildClip(const ManifestClip & spec, const BuildCache & cache, BuildResult & result)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> input;
+    if( !ReadFileBytes(spec.input.c_str(), input) )
+    {
+        result.error = "can't read " + spec.input;
+        return;
+    }
+    uint64_t key = BuildCache::Key(input, spec.OptionsKey());
+    result.cached = cache.Load(key, result.clip);
+    if( result.cached )
+    {
+        result.ok = true;
+    }
+    else
+    {
+        result.ok = ProcessClip(spec, input, result.clip, result.detail, result.error);
+        if( result.ok )
+            cache.Store(key, result.clip);
+    }
+    result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Write a .dat output unless it already holds the same data, so unchanged includes keep their
+// timestamps & don't trigger sketch rebuilds
+// - returns false on a write error, written is set if the file was (re)written
+static bool WriteDatIfChanged(const std::string & path, unsigned int bits_per_sample, const std::vector<uint8_t> & data,
+        bool & written)
+{
+    std::vector<uint8_t> existing;
+    written = false;
+    if( ReadDatFile(path.c_str(), bits_per_sample, existing) && (existing == data) )
+        return true;
+    written = true;
+    return WriteDatFile(path.c_str(), bits_per_sample, data);
+}
+
+static int Build(int argc, char *argv[])
+{
+    if( argc < 3 )
+        return kUsageError;
+    unsigned int num_threads = std::thread::hardware_concurrency();
+    bool use_cache = true;
+    for( int i=3; i<argc; i++ )
+    {
+        if( (strcmp(argv[i], "-j") == 0) && (i + 1 < argc) )
+            num_threads = atoi(argv[++i]);
+        else if( strcmp(argv[i], "--no-cache") == 0 )
+            use_cache = false;
+        else
+            return kUsageError;
+    }
+    if( num_threads == 0 )
+        num_threads = 1;
+
+    Manifest manifest;
+    std::string error;
+    if( !ReadManifest(argv[2], manifest, error) )
+    {
+        fprintf(stderr, "%s: %s\n", argv[2], error.c_str());
+        return 1;
+    }
+    for( const ManifestClip & spec : manifest.clips )
+    {
+        ClipCodec codec;
+        if( !ParseCodec(spec.codec, codec) ||
+            ((manifest.output == Manifest::Output::Dat) && (codec != ClipCodec::Pcm)) )
+        {
+            fprintf(stderr, "%s: line %d: codec %s not supported for this output\n", argv[2], spec.line, spec.codec.c_str());
+            return 1;
+        }
+    }
+
+    // process clips on all workers, pulling the next clip as each finishes
+    auto start = std::chrono::steady_clock::now();
+    BuildCache cache(use_cache ? std::string(argv[2]) + ".cache" : std::string());
+    std::vector<BuildResult> results(manifest.clips.size());
+    std::atomic<unsigned int> next(0);
+    auto worker = [&]() {
+        unsigned int i;
+        while( (i = next++) < manifest.clips.size() )
+            BuildClip(manifest.clips[i], cache, results[i]);
+    };
+    std::vector<std::thread> threads;
+    for( unsigned int i=1; i<num_threads; i++ )
+        threads.emplace_back(worker);
+    worker();
+    for( std::thread & thread : threads )
+        thread.join();
+
+    if( manifest.output == Manifest::Output::Dat )
+        MakeDir(manifest.output_path);
+
+    // report & write out, in manifest order
+    AssetBankWriter writer;
+    unsigned int num_cached = 0;
+    unsigned int num_written = 0;
+    int ret = 0;
+    for( size_t i=0; i<results.size(); i++ )
+    {
+        const ManifestClip & spec = manifest.clips[i];
+        const BuildResult & result = results[i];
+        if( !result.ok )
+        {
+            fprintf(stderr, "%s: %s\n", spec.name.c_str(), result.error.c_str());
+            ret = 1;
+            continue;
+        }
+        const CachedClipHeader & header = result.clip.header;
+        num_cached += result.cached;
+        printf("%-24s %-5s %6u Hz %2u-bit %8u bytes, %7.1f ms, %s %6.1f ms%s\n", spec.name.c_str(),
+                CodecName(header.codec), header.samplerate, header.bits_per_sample, (unsigned int)result.clip.data.size(),
+                header.num_samples * 1000.0 / header.samplerate, result.cached ? "cached   " : "processed",
+                result.ms, result.detail.c_str());
+
+        if( manifest.output == Manifest::Output::Bank )
+        {
+            if( writer.Add(spec.name.c_str(), result.clip.data.empty() ? nullptr : &result.clip.data[0],
+                    result.clip.data.size(), header.num_samples, header.samplerate, header.bits_per_sample,
+                    (ClipCodec)header.codec) < 0 )
+            {
+                fprintf(stderr, "can't add %s (name too long or duplicate)\n", spec.name.c_str());
+                ret = 1;
+            }
+            std::string env_name = spec.name + ".env";
+            if( !result.clip.envelope.empty() &&
+                (writer.Add(env_name.c_str(), &result.clip.envelope[0], result.clip.envelope.size(),
+                    result.clip.envelope.size() - kEnvelopeHeaderLen, header.samplerate, 8, ClipCodec::Envelope) < 0) )
+            {
+                fprintf(stderr, "can't add %s (name too long or duplicate)\n", env_name.c_str());
+                ret = 1;
+            }
+        }
+        else
+        {
+            std::string path = manifest.output_path + "/" + spec.name;
+            bool written;
+            if( !WriteDatIfChanged(path + ".dat", header.bits_per_sample, result.clip.data, written) )
+            {
+                fprintf(stderr, "can't write %s.dat\n", path.c_str());
+                ret = 1;
+            }
+            num_written += written;
+            if( !result.clip.envelope.empty() )
+            {
+                if( !WriteDatIfChanged(path + ".env.dat", 8, result.clip.envelope, written) )
+                {
+                    fprintf(stderr, "can't write %s.env.dat\n", path.c_str());
+                    ret = 1;
+                }
+                num_written += written;
+            }
+        }
+    }
+    if( ret != 0 )
+        return ret;
+
+    if( manifest.output == Manifest::Output::Bank )
+    {
+        if( !writer.Write(manifest.output_path.c_str()) )
+        {
+            fprintf(stderr, "can't write %s\n", manifest.output_path.c_str());
+            return 1;
+        }
+        printf("wrote %s, ", manifest.output_path.c_str());
+    }
+    else
+    {
+        printf("wrote %u .dat files to %s, ", num_written, manifest.output_path.c_str());
+    }
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("%u clips (%u cached), %u threads, %.1f ms\n", (unsigned int)results.size(), num_cached, num_threads, elapsed_ms);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int ret = kUsageError;
+    if( argc >= 2 )
+    {
+        if( strcmp(argv[1], "pack") == 0 )
+            ret = Pack(argc, argv);
+        else if( strcmp(argv[1], "list") == 0 )
+            ret = List(argc, argv);
+        else if( strcmp(argv[1], "build") == 0 )
+            ret = Build(argc, argv);
+    }
+    if( ret == kUsageError )
+    {
+        fprintf(stderr, "usage: %s pack <bank> <name>=<file.dat>:<samplerate>:<bits>[:<codec>] ...\n", argv[0]);
+        fprintf(stderr, "           codec: pcm (default), adpcm, ulaw, alaw, lz, rle\n");
+        fprintf(stderr, "       %s list <bank>\n", argv[0]);
+        fprintf(stderr, "       %s build <manifest> [-j <threads>] [--no-cache]\n", argv[0]);
+    }
+    return ret;
+}
+
+// vim: sw=4:ts=4
@@ -2,19 +2,21 @@
 
 #include "../../SerialLog/include/SerialLog.h"
 #include "../../Ticker/include/Ticker.h"
+#include "../../GpioOut/include/GpioOut.h"
 
 // LED Blinker class, implemented with Ticker
 // - toggles specified GPIO pin at specified interval
 // - calling code just needs to instantiate class instance which will setup Ticker fcn to periodically
 // update the pin-output state
+// - pin written with a single register store (see GpioOut.h), GPIO0-31
 class Blinker
 {
 public:
     Blinker(uint8_t pin, unsigned interval_millis)
     {
-        // TODO: check that pin is valid GPIO
-        pinMode(pin, OUTPUT); // Set specified pin to be an OUTPUT
-        ticker_.attach_ms<uint8_t>(interval_millis, Blinker::_Loop, pin);
+        led_.Init(&pin, 1);   // asserts pin is in the GPIO_OUT bank, sets it to OUTPUT
+        output_state_ = false;
+        ticker_.attach_ms<Blinker *>(interval_millis, Blinker::_Loop, this);
     }
 
     ~Blinker()
@@ -23,17 +25,21 @@ public:
     }
 
 private:
-    static void _Loop(uint8_t pin)
+    static void _Loop(Blinker *blinker)
     {
-        digitalWrite(pin, !digitalRead(pin));
+        blinker->output_state_ = !blinker->output_state_;
+        blinker->led_.Write(blinker->output_state_);
     }
     Ticker ticker_;
+    GpioGroup led_;
+    bool output_state_;
 };
 
 
 // LED Blinker class
 // - toggles specified GPIO pin at specified interval
 // - calling code needs to call ::Loop() periodically at rate faster than the specified interval
+// - pin written with a single register store (see GpioOut.h), GPIO0-31
 class BlinkerL
 {
 public:
@@ -41,8 +47,7 @@ public:
         : interval_millis_(interval_millis)
         , pin_(pin)
     {
-        // TODO: check that pin is valid GPIO
-        pinMode(pin, OUTPUT); // Set specified pin to be an OUTPUT
+        led_.Init(&pin, 1);   // asserts pin is in the GPIO_OUT bank, sets it to OUTPUT
         prev_toggle_millis_ = 0;
         output_state_ = LOW;
     }
@@ -53,7 +58,7 @@ public:
         if( (prev_toggle_millis_ == 0) || (now >= prev_toggle_millis_ + interval_millis_) )
         {
             output_state_ = (output_state_ == LOW) ? HIGH : LOW;
-            digitalWrite(pin_, output_state_); //
+            led_.Write(output_state_ == HIGH);
             SerialLog::Log("Toggled LED");
             prev_toggle_millis_ = now;
         }
@@ -62,6 +67,7 @@ public:
 private:
     unsigned interval_millis_;
     uint8_t pin_;
+    GpioGroup led_;
     unsigned long prev_toggle_millis_;
     int output_state_;
 };
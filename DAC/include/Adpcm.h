@@ -0,0 +1,238 @@
+// IMA-ADPCM codec
+// - 4 bits per sample, i.e. 1/4 the size of 16-bit PCM (1/2 of 8-bit) for near 16-bit quality
+// - block structured, each block is self-contained so errors don't propagate & decoding can
+// (re)start at any block:
+//      int16_t  predictor      first sample of the block, verbatim
+//      uint8_t  step_index
+//      uint8_t  reserved
+//      nibbles                 remaining samples, 2 per byte, low nibble first
+//  - kAdpcmBlockBytes per block, so kAdpcmBlockSamples samples per block (the last block of a
+//  clip may be short)
+// - AdpcmSource decodes incrementally as samples are read, no decompressed copy is made
+// - AdpcmEncode() is for host tools & tests
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <vector>
+#include "SampleSource.h"
+
+static const unsigned int kAdpcmBlockBytes = 256;
+static const unsigned int kAdpcmHeaderBytes = 4;
+static const unsigned int kAdpcmBlockSamples = 1 + (kAdpcmBlockBytes - kAdpcmHeaderBytes) * 2;
+
+static const int16_t kAdpcmStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t kAdpcmIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+// Decoder/encoder state, shared so both sides track identically
+struct AdpcmState
+{
+    int32_t predictor;
+    int32_t step_index;
+
+    // Apply one 4-bit code, returns the new sample
+    inline int16_t Decode(uint8_t code)
+    {
+        int32_t step = kAdpcmStepTable[step_index];
+        int32_t diff = step >> 3;
+        if( code & 4 )
+            diff += step;
+        if( code & 2 )
+            diff += step >> 1;
+        if( code & 1 )
+            diff += step >> 2;
+        if( code & 8 )
+            predictor -= diff;
+        else
+            predictor += diff;
+        if( predictor > 32767 )
+            predictor = 32767;
+        else if( predictor < -32768 )
+            predictor = -32768;
+
+        step_index += kAdpcmIndexTable[code];
+        if( step_index < 0 )
+            step_index = 0;
+        else if( step_index > 88 )
+            step_index = 88;
+        return (int16_t)predictor;
+    }
+
+    // Pick the code that best approximates sample, and apply it
+    inline uint8_t Encode(int16_t sample)
+    {
+        int32_t step = kAdpcmStepTable[step_index];
+        int32_t diff = (int32_t)sample - predictor;
+        uint8_t code = 0;
+        if( diff < 0 )
+        {
+            code = 8;
+            diff = -diff;
+        }
+        if( diff >= step )
+        {
+            code |= 4;
+            diff -= step;
+        }
+        if( diff >= (step >> 1) )
+        {
+            code |= 2;
+            diff -= step >> 1;
+        }
+        if( diff >= (step >> 2) )
+        {
+            code |= 1;
+        }
+        Decode(code);
+        return code;
+    }
+};
+
+// Number of bytes to encode num_samples samples
+inline uint32_t AdpcmEncodedSize(uint32_t num_samples)
+{
+    uint32_t num_full_blocks = num_samples / kAdpcmBlockSamples;
+    uint32_t rem = num_samples % kAdpcmBlockSamples;
+    uint32_t size = num_full_blocks * kAdpcmBlockBytes;
+    if( rem > 0 )
+        size += kAdpcmHeaderBytes + rem / 2;   // rem-1 nibbles, rounded up
+    return size;
+}
+
+// Encode 16-bit PCM
+inline std::vector<uint8_t> AdpcmEncode(const int16_t *samples, uint32_t num_samples)
+{
+    std::vector<uint8_t> out(AdpcmEncodedSize(num_samples), 0);
+    AdpcmState state = { 0, 0 };
+    uint8_t *p = out.empty() ? nullptr : &out[0];
+    for( uint32_t pos=0; pos<num_samples; pos+=kAdpcmBlockSamples )
+    {
+        uint32_t n = num_samples - pos;
+        if( n > kAdpcmBlockSamples )
+            n = kAdpcmBlockSamples;
+
+        // header: first sample verbatim, step index carried over from the previous block
+        state.predictor = samples[pos];
+        p[0] = (uint8_t)(samples[pos] & 0xff);
+        p[1] = (uint8_t)((uint16_t)samples[pos] >> 8);
+        p[2] = (uint8_t)state.step_index;
+        p[3] = 0;
+        p += kAdpcmHeaderBytes;
+
+        for( uint32_t i=1; i<n; i++ )
+        {
+            uint8_t code = state.Encode(samples[pos + i]);
+            if( i & 1 )
+                *p = code;
+            else
+                *p++ |= code << 4;
+        }
+        if( (n > 1) && ((n - 1) & 1) )
+            p++;    // partial last byte
+        if( n == kAdpcmBlockSamples )
+            assert( (p - &out[0]) % kAdpcmBlockBytes == 0 );
+    }
+    return out;
+}
+
+// Streaming decoder
+// - decodes a block's worth of state at a time, one sample per nibble as ::Read() asks for them
+class AdpcmSource : public ISampleSource
+{
+public:
+    AdpcmSource(const void *data=nullptr, uint32_t num_bytes=0, uint32_t num_samples=0)
+    {
+        SetData(data, num_bytes, num_samples);
+    }
+
+    void SetData(const void *data, uint32_t num_bytes, uint32_t num_samples)
+    {
+        data_ = (const uint8_t *)data;
+        num_bytes_ = num_bytes;
+        num_samples_ = num_samples;
+        assert( (data_ != nullptr) || (num_samples_ == 0) );
+        assert( AdpcmEncodedSize(num_samples_) <= num_bytes_ );
+        Restart();
+    }
+
+    // ISampleSource Interface overrides begin {
+
+    unsigned int Read(int16_t *out, unsigned int num_samples) override
+    {
+        unsigned int produced = 0;
+        while( (produced < num_samples) && (pos_ < num_samples_) )
+        {
+            unsigned int in_block = pos_ % kAdpcmBlockSamples;
+            if( in_block == 0 )
+            {
+                // block header
+                block_ = data_ + (pos_ / kAdpcmBlockSamples) * kAdpcmBlockBytes;
+                state_.predictor = (int16_t)(block_[0] | (block_[1] << 8));
+                state_.step_index = block_[2] > 88 ? 88 : block_[2];
+                out[produced++] = (int16_t)state_.predictor;
+                pos_++;
+                continue;
+            }
+
+            // run of nibbles to the end of the block, the clip, or the request
+            unsigned int n = kAdpcmBlockSamples - in_block;
+            if( n > num_samples_ - pos_ )
+                n = num_samples_ - pos_;
+            if( n > num_samples - produced )
+                n = num_samples - produced;
+
+            const uint8_t *nibbles = block_ + kAdpcmHeaderBytes;
+            unsigned int nibble_idx = in_block - 1;
+            AdpcmState state = state_;
+            for( unsigned int i=0; i<n; i++, nibble_idx++ )
+            {
+                uint8_t byte = nibbles[nibble_idx >> 1];
+                uint8_t code = (nibble_idx & 1) ? (byte >> 4) : (byte & 0x0f);
+                out[produced + i] = state.Decode(code);
+            }
+            state_ = state;
+            produced += n;
+            pos_ += n;
+        }
+        return produced;
+    }
+
+    void Restart() override
+    {
+        pos_ = 0;
+        block_ = data_;
+        state_.predictor = 0;
+        state_.step_index = 0;
+    }
+
+    // ISampleSource Interface overrides end }
+
+    uint32_t GetPos() const
+    {
+        return pos_;
+    }
+
+private:
+    const uint8_t *data_;
+    uint32_t num_bytes_;
+    uint32_t num_samples_;
+
+    uint32_t pos_;              // next sample
+    const uint8_t *block_;      // current block
+    AdpcmState state_;
+};
+
+// vim: sw=4:ts=4
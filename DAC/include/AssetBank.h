@@ -0,0 +1,243 @@
+// Asset bank reader
+// - zero-copy: the bank is memory-mapped and clip data is played straight from the mapping
+//  - on target, from a flash data partition via esp_partition_mmap()
+//  - on the host, from a file via mmap(), so the same bank image can be tested on Linux
+//  - or from any bank image already in memory, see ::Open()
+// - lookup by id (index position) or by name, both O(1)
+// - see AssetBankFormat.h for the layout
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include "AssetBankFormat.h"
+
+#ifdef ARDUINO
+#   include <esp_partition.h>
+#else
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
+class AssetBank
+{
+public:
+    AssetBank() {}
+
+    ~AssetBank()
+    {
+        Close();
+    }
+
+    AssetBank(AssetBank const&)         = delete;
+    void operator=(AssetBank const&)    = delete;
+
+    // Use a bank image already in memory (e.g. rodata, or mapped by the caller)
+    // - returns false if the image isn't a valid bank
+    bool Open(const void *base, size_t size)
+    {
+        Close();
+        return _Attach(base, size);
+    }
+
+#ifdef ARDUINO
+    // Map the bank from the flash data partition with the given label
+    bool OpenPartition(const char *label)
+    {
+        Close();
+        const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+        if( partition == nullptr )
+            return false;
+
+        // map only the bank, not the whole partition, so a small bank doesn't use up MMU pages
+        AssetBankHeader header;
+        if( esp_partition_read(partition, 0, &header, sizeof(header)) != ESP_OK )
+            return false;
+        if( (header.magic != kAssetBankMagic) || (header.total_size < sizeof(header)) ||
+            (header.total_size > partition->size) )
+            return false;
+
+        const void *ptr;
+        if( esp_partition_mmap(partition, 0, header.total_size, SPI_FLASH_MMAP_DATA, &ptr, &mmap_handle_) != ESP_OK )
+            return false;
+        mapped_ = true;
+
+        if( !_Attach(ptr, header.total_size) )
+        {
+            spi_flash_munmap(mmap_handle_);
+            mapped_ = false;
+            return false;
+        }
+        return true;
+    }
+#else
+    // Map the bank from a file
+    bool OpenFile(const char *path)
+    {
+        Close();
+        int fd = open(path, O_RDONLY);
+        if( fd < 0 )
+            return false;
+
+        struct stat st;
+        void *ptr = MAP_FAILED;
+        if( (fstat(fd, &st) == 0) && (st.st_size > 0) )
+        {
+            ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if( ptr == MAP_FAILED )
+            return false;
+        mapped_ = true;
+        mapped_ptr_ = ptr;
+        mapped_size_ = st.st_size;
+
+        if( !_Attach(ptr, st.st_size) )
+        {
+            munmap(mapped_ptr_, mapped_size_);
+            mapped_ = false;
+            return false;
+        }
+        return true;
+    }
+#endif
+
+    void Close()
+    {
+        if( mapped_ )
+        {
+#ifdef ARDUINO
+            spi_flash_munmap(mmap_handle_);
+#else
+            munmap(mapped_ptr_, mapped_size_);
+#endif
+            mapped_ = false;
+        }
+        base_ = nullptr;
+        num_clips_ = 0;
+    }
+
+    bool IsOpen() const
+    {
+        return base_ != nullptr;
+    }
+
+    unsigned int GetNumClips() const
+    {
+        return num_clips_;
+    }
+
+    // Clip by id, nullptr if out of range
+    const AssetClipEntry * Get(unsigned int id) const
+    {
+        if( id >= num_clips_ )
+            return nullptr;
+        return &index_[id];
+    }
+
+    // Clip by name, nullptr if not found
+    const AssetClipEntry * Find(const char *name) const
+    {
+        if( base_ == nullptr )
+            return nullptr;
+
+        uint32_t hash = AssetNameHash(name);
+        for( uint32_t slot = hash & hash_mask_; ; slot = (slot + 1) & hash_mask_ )
+        {
+            uint16_t entry = hash_[slot];
+            if( entry == 0 )
+                return nullptr;
+            const AssetClipEntry *clip = &index_[entry - 1];
+            if( (clip->name_hash == hash) && (strncmp(clip->name, name, kAssetNameLen) == 0) )
+                return clip;
+        }
+    }
+
+    // Id of a clip returned by ::Get()/::Find()
+    unsigned int GetId(const AssetClipEntry *clip) const
+    {
+        return (unsigned int)(clip - index_);
+    }
+
+    // Clip data, in place
+    const void * GetData(const AssetClipEntry *clip) const
+    {
+        assert(clip);
+        return base_ + clip->offset;
+    }
+
+private:
+    bool _Attach(const void *base, size_t size)
+    {
+        if( !_Validate((const uint8_t *)base, size) )
+            return false;
+
+        base_ = (const uint8_t *)base;
+        const AssetBankHeader *header = (const AssetBankHeader *)base_;
+        index_ = (const AssetClipEntry *)(base_ + header->index_offset);
+        hash_ = (const uint16_t *)(base_ + header->hash_offset);
+        num_clips_ = header->num_clips;
+        hash_mask_ = header->hash_size - 1;
+        return true;
+    }
+
+    static bool _Validate(const uint8_t *base, size_t size)
+    {
+        if( (base == nullptr) || (size < sizeof(AssetBankHeader)) )
+            return false;
+        const AssetBankHeader *header = (const AssetBankHeader *)base;
+        if( (header->magic != kAssetBankMagic) || (header->version != kAssetBankVersion) )
+            return false;
+        if( header->total_size > size )
+            return false;
+        if( (header->hash_size == 0) || ((header->hash_size & (header->hash_size - 1)) != 0) ||
+            (header->hash_size < header->num_clips + 1u) )
+            return false;   // need a power of two w/ room for an empty slot
+        if( header->index_offset + (uint64_t)header->num_clips * sizeof(AssetClipEntry) > header->total_size )
+            return false;
+        if( header->hash_offset + (uint64_t)header->hash_size * sizeof(uint16_t) > header->total_size )
+            return false;
+
+        const AssetClipEntry *index = (const AssetClipEntry *)(base + header->index_offset);
+        for( unsigned int i=0; i<header->num_clips; i++ )
+        {
+            const AssetClipEntry & clip = index[i];
+            if( ((uint64_t)clip.offset + clip.num_bytes > header->total_size) || ((clip.offset % kAssetAlign) != 0) )
+                return false;
+            if( clip.name[kAssetNameLen - 1] != '\0' )
+                return false;
+        }
+        // ::Find() probes until it hits an empty slot, so there must be one: a corrupt table can
+        // fill every slot (e.g. w/ repeated ids) despite hash_size > num_clips
+        const uint16_t *hash = (const uint16_t *)(base + header->hash_offset);
+        unsigned int num_empty = 0;
+        for( unsigned int i=0; i<header->hash_size; i++ )
+        {
+            if( hash[i] > header->num_clips )
+                return false;
+            if( hash[i] == 0 )
+                num_empty++;
+        }
+        return (num_empty > 0);
+    }
+
+    const uint8_t *base_ = nullptr;
+    const AssetClipEntry *index_ = nullptr;
+    const uint16_t *hash_ = nullptr;
+    unsigned int num_clips_ = 0;
+    uint32_t hash_mask_ = 0;
+
+    bool mapped_ = false;
+#ifdef ARDUINO
+    spi_flash_mmap_handle_t mmap_handle_;
+#else
+    void *mapped_ptr_ = nullptr;
+    size_t mapped_size_ = 0;
+#endif
+};
+
+// vim: sw=4:ts=4
@@ -0,0 +1,77 @@
+// Asset bank binary format
+// - a single image holding many audio clips, stored in its own flash partition and read in place
+// (see AssetBank.h), or written by the host tools (see AssetBankWriter.h, AssetTool)
+// - layout, all offsets from the start of the bank, all fields little-endian:
+//      AssetBankHeader
+//      AssetClipEntry[num_clips]       clip index, clip id == position in the index
+//      uint16_t[hash_size]             name hash table, clip index + 1 (0 == empty slot)
+//      payload                         clip data, each clip kAssetAlign aligned
+// - name lookup: FNV-1a hash of the name, open addressing w/ linear probing, hash_size is a power
+// of two at least twice num_clips so probe sequences stay short
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Clip data encodings
+enum class ClipCodec : uint8_t
+{
+    Pcm = 0,        // raw 8-bit unsigned or 16-bit signed PCM
+    ImaAdpcm = 1,   // IMA-ADPCM blocks, decodes to 16-bit (see Adpcm.h)
+    MuLaw = 2,      // G.711 µ-law, 8 bits per sample, decodes to 16-bit (see Companding.h)
+    ALaw = 3,       // G.711 A-law, ditto
+    Lz = 4,         // LZ block-compressed PCM, lossless, decodes to bits_per_sample (see Lz.h)
+    SilenceRle = 5, // silence trimmed & run-length encoded PCM, decodes to bits_per_sample (see Silence.h)
+    Envelope = 6,   // not audio: envelope track of the clip named without the ".env" suffix (see Envelope.h)
+};
+
+static const uint32_t kAssetBankMagic = 0x4b4e4241;    // "ABNK"
+static const uint16_t kAssetBankVersion = 1;
+static const uint32_t kAssetAlign = 16;                // payload alignment, in bytes
+static const unsigned int kAssetNameLen = 24;          // incl. terminating NUL
+
+struct AssetBankHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_clips;
+    uint32_t total_size;        // whole bank, in bytes
+    uint32_t index_offset;      // AssetClipEntry[num_clips]
+    uint32_t hash_offset;       // uint16_t[hash_size]
+    uint16_t hash_size;
+    uint16_t reserved0;
+    uint32_t payload_offset;
+    uint32_t reserved1;
+};
+
+struct AssetClipEntry
+{
+    char name[kAssetNameLen];
+    uint32_t name_hash;
+    uint32_t offset;            // clip data
+    uint32_t num_bytes;         // clip data size, as stored
+    uint32_t num_samples;       // decoded length
+    uint32_t samplerate;        // Hz
+    uint8_t bits_per_sample;    // decoded sample size, 8 or 16
+    uint8_t codec;              // ClipCodec
+    uint16_t reserved;
+};
+
+static_assert(sizeof(AssetBankHeader) == 32, "AssetBankHeader layout");
+static_assert(sizeof(AssetClipEntry) == 48, "AssetClipEntry layout");
+
+// FNV-1a, 32-bit
+inline uint32_t AssetNameHash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    while( *name )
+    {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// vim: sw=4:ts=4
@@ -0,0 +1,127 @@
+// Asset bank writer
+// - builds a bank image (see AssetBankFormat.h) from clips added one at a time
+// - intended for host tools (AssetTool) & tests, uses the standard library containers
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <string>
+#include <vector>
+#include "AssetBankFormat.h"
+
+class AssetBankWriter
+{
+public:
+    // Add a clip, data is copied
+    // - returns the clip id, or -1 if the name is too long or already used
+    int Add(const char *name, const void *data, uint32_t num_bytes, uint32_t num_samples,
+            uint32_t samplerate, uint8_t bits_per_sample, ClipCodec codec=ClipCodec::Pcm)
+    {
+        if( strlen(name) >= kAssetNameLen )
+            return -1;
+        for( const Clip & clip : clips_ )
+        {
+            if( strcmp(clip.entry.name, name) == 0 )
+                return -1;
+        }
+        if( clips_.size() >= 0xffff )
+            return -1;
+
+        Clip clip;
+        memset(&clip.entry, 0, sizeof(clip.entry));
+        strncpy(clip.entry.name, name, kAssetNameLen - 1);
+        clip.entry.name_hash = AssetNameHash(name);
+        clip.entry.num_bytes = num_bytes;
+        clip.entry.num_samples = num_samples;
+        clip.entry.samplerate = samplerate;
+        clip.entry.bits_per_sample = bits_per_sample;
+        clip.entry.codec = (uint8_t)codec;
+        clip.data.assign((const uint8_t *)data, (const uint8_t *)data + num_bytes);
+        clips_.push_back(clip);
+        return (int)clips_.size() - 1;
+    }
+
+    // Lay out the bank image
+    std::vector<uint8_t> Build() const
+    {
+        uint16_t num_clips = (uint16_t)clips_.size();
+        uint32_t hash_size = 2;
+        while( hash_size < 2u * num_clips )
+            hash_size *= 2;
+
+        AssetBankHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = kAssetBankMagic;
+        header.version = kAssetBankVersion;
+        header.num_clips = num_clips;
+        header.index_offset = sizeof(AssetBankHeader);
+        header.hash_offset = header.index_offset + num_clips * sizeof(AssetClipEntry);
+        header.hash_size = (uint16_t)hash_size;
+        header.payload_offset = _Align(header.hash_offset + hash_size * sizeof(uint16_t));
+
+        // payload layout
+        std::vector<AssetClipEntry> index;
+        uint32_t offset = header.payload_offset;
+        for( const Clip & clip : clips_ )
+        {
+            AssetClipEntry entry = clip.entry;
+            entry.offset = offset;
+            index.push_back(entry);
+            offset = _Align(offset + entry.num_bytes);
+        }
+        header.total_size = offset;
+
+        // name hash table
+        std::vector<uint16_t> hash(hash_size, 0);
+        for( unsigned int i=0; i<num_clips; i++ )
+        {
+            uint32_t slot = index[i].name_hash & (hash_size - 1);
+            while( hash[slot] != 0 )
+                slot = (slot + 1) & (hash_size - 1);
+            hash[slot] = (uint16_t)(i + 1);
+        }
+
+        std::vector<uint8_t> image(header.total_size, 0);
+        memcpy(&image[0], &header, sizeof(header));
+        if( num_clips > 0 )
+            memcpy(&image[header.index_offset], &index[0], num_clips * sizeof(AssetClipEntry));
+        memcpy(&image[header.hash_offset], &hash[0], hash_size * sizeof(uint16_t));
+        for( unsigned int i=0; i<num_clips; i++ )
+        {
+            if( index[i].num_bytes > 0 )
+                memcpy(&image[index[i].offset], &clips_[i].data[0], index[i].num_bytes);
+        }
+        return image;
+    }
+
+    // Build & write the bank image to a file
+    bool Write(const char *path) const
+    {
+        std::vector<uint8_t> image = Build();
+        FILE *file = fopen(path, "wb");
+        if( file == nullptr )
+            return false;
+        bool ok = fwrite(&image[0], 1, image.size(), file) == image.size();
+        ok = (fclose(file) == 0) && ok;
+        return ok;
+    }
+
+private:
+    struct Clip
+    {
+        AssetClipEntry entry;
+        std::vector<uint8_t> data;
+    };
+
+    static uint32_t _Align(uint32_t offset)
+    {
+        return (offset + kAssetAlign - 1) & ~(kAssetAlign - 1);
+    }
+
+    std::vector<Clip> clips_;
+};
+
+// vim: sw=4:ts=4
@@ -0,0 +1,297 @@
+// Hot-clip RAM cache
+// - copies recently played flash clips (see ClipView.h) into internal RAM, so their sample fetches
+// don't depend on the flash cache, which WiFi/MQTT code running from flash keeps evicting
+// - LRU within a byte budget, up to kMaxEntries clips
+// - optionally caches only each clip's first prefix_ms, see CachedClipSource to play the cached
+// prefix followed by the flash remainder
+// - entries are pinned while in use: ::Acquire() pins, ::Release() unpins, only unpinned entries
+// are evicted, so a playing copy is never freed under the DAC
+// - a miss copies the clip (prefix) from flash in the caller's context, so acquire from loop()
+// rather than from audio callbacks
+// - ::GetStats() for hit/miss counters
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "ClipView.h"
+#include "SampleSource.h"
+
+#ifdef ARDUINO
+#   include <esp_heap_caps.h>
+#endif
+
+class ClipCache
+{
+public:
+    static const unsigned int kMaxEntries = 16;
+
+    struct Stats
+    {
+        uint32_t hits;
+        uint32_t misses;        // incl. rejected
+        uint32_t rejected;      // misses that couldn't be cached, e.g. larger than the budget
+        uint32_t evictions;
+        size_t bytes_used;
+        size_t budget_bytes;
+    };
+
+    // prefix_ms: 0 to cache whole clips
+    ClipCache(size_t budget_bytes, unsigned int prefix_ms=0)
+    {
+        budget_bytes_ = budget_bytes;
+        prefix_ms_ = prefix_ms;
+        memset(entries_, 0, sizeof(entries_));
+        ResetStats();
+    }
+
+    ~ClipCache()
+    {
+        Clear();
+    }
+
+    ClipCache(ClipCache const&)         = delete;
+    void operator=(ClipCache const&)    = delete;
+
+    // RAM copy of the clip (or its prefix), promoting it on a miss, and pinned until ::Release()
+    // - cached_len is set to the number of samples cached, i.e. clip.GetLen() unless prefix-only
+    // - returns nullptr if it can't be cached (too large, or the rest of the cache is pinned),
+    // play the flash clip instead
+    const void * Acquire(const ClipView & clip, unsigned int & cached_len)
+    {
+        tick_++;
+        Entry *entry = _Find(clip.GetData());
+        if( entry != nullptr )
+        {
+            stats_.hits++;
+        }
+        else
+        {
+            stats_.misses++;
+            entry = _Promote(clip);
+            if( entry == nullptr )
+            {
+                stats_.rejected++;
+                cached_len = 0;
+                return nullptr;
+            }
+        }
+        entry->last_used = tick_;
+        entry->pins++;
+        cached_len = entry->len;
+        return entry->data;
+    }
+
+    // Unpin a clip acquired by ::Acquire()
+    void Release(const ClipView & clip)
+    {
+        Entry *entry = _Find(clip.GetData());
+        assert( (entry != nullptr) && (entry->pins > 0) );
+        if( entry != nullptr )
+            entry->pins--;
+    }
+
+    bool Contains(const ClipView & clip) const
+    {
+        return const_cast<ClipCache *>(this)->_Find(clip.GetData()) != nullptr;
+    }
+
+    // Free all unpinned entries
+    void Clear()
+    {
+        for( Entry & entry : entries_ )
+        {
+            if( (entry.source != nullptr) && (entry.pins == 0) )
+                _Free(entry);
+        }
+    }
+
+    Stats GetStats() const
+    {
+        Stats stats = stats_;
+        stats.bytes_used = bytes_used_;
+        stats.budget_bytes = budget_bytes_;
+        return stats;
+    }
+
+    void ResetStats()
+    {
+        memset(&stats_, 0, sizeof(stats_));
+    }
+
+private:
+    struct Entry
+    {
+        const void *source;     // flash clip data, nullptr == free entry
+        void *data;             // RAM copy
+        unsigned int len;       // in samples
+        size_t num_bytes;
+        uint32_t last_used;
+        unsigned int pins;
+    };
+
+    Entry * _Find(const void *source)
+    {
+        for( Entry & entry : entries_ )
+        {
+            if( (entry.source != nullptr) && (entry.source == source) )
+                return &entry;
+        }
+        return nullptr;
+    }
+
+    Entry * _Promote(const ClipView & clip)
+    {
+        unsigned int len = clip.GetLen();
+        if( prefix_ms_ > 0 )
+        {
+            unsigned int prefix_len = (unsigned int)((uint64_t)prefix_ms_ * clip.GetSamplerate() / 1000);
+            if( prefix_len < len )
+                len = prefix_len;
+        }
+        size_t num_bytes = (size_t)len * (clip.GetBitsPerSample() / 8);
+        if( (num_bytes == 0) || (num_bytes > budget_bytes_) )
+            return nullptr;
+
+        // make room: evict least recently used unpinned entries
+        Entry *slot = nullptr;
+        while( true )
+        {
+            slot = nullptr;
+            for( Entry & entry : entries_ )
+            {
+                if( entry.source == nullptr )
+                {
+                    slot = &entry;
+                    break;
+                }
+            }
+            if( (slot != nullptr) && (bytes_used_ + num_bytes <= budget_bytes_) )
+                break;
+            if( !_EvictLru() )
+                return nullptr;
+        }
+
+        void *data = _Alloc(num_bytes);
+        if( data == nullptr )
+            return nullptr;
+        memcpy(data, clip.GetData(), num_bytes);
+
+        slot->source = clip.GetData();
+        slot->data = data;
+        slot->len = len;
+        slot->num_bytes = num_bytes;
+        slot->pins = 0;
+        bytes_used_ += num_bytes;
+        return slot;
+    }
+
+    // Returns false if there's nothing evictable
+    bool _EvictLru()
+    {
+        Entry *lru = nullptr;
+        for( Entry & entry : entries_ )
+        {
+            if( (entry.source != nullptr) && (entry.pins == 0) &&
+                ((lru == nullptr) || ((int32_t)(entry.last_used - lru->last_used) < 0)) )
+            {
+                lru = &entry;
+            }
+        }
+        if( lru == nullptr )
+            return false;
+        _Free(*lru);
+        stats_.evictions++;
+        return true;
+    }
+
+    void _Free(Entry & entry)
+    {
+        free(entry.data);
+        bytes_used_ -= entry.num_bytes;
+        memset(&entry, 0, sizeof(entry));
+    }
+
+    static void * _Alloc(size_t num_bytes)
+    {
+#ifdef ARDUINO
+        return heap_caps_malloc(num_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+        return malloc(num_bytes);
+#endif
+    }
+
+    size_t budget_bytes_;
+    unsigned int prefix_ms_;
+    size_t bytes_used_ = 0;
+    uint32_t tick_ = 0;
+    Entry entries_[kMaxEntries];
+    Stats stats_;
+};
+
+// Play a clip from its cached prefix, then the rest from flash
+// - for prefix-only caches, whole-clip hits can go straight to IDac::SetBuffer()
+class CachedClipSource : public ISampleSource
+{
+public:
+    CachedClipSource() {}
+
+    // cached & cached_len: ::Acquire() results, cached may be nullptr to play from flash only
+    void SetClip(const ClipView & clip, const void *cached, unsigned int cached_len)
+    {
+        flash_ = (const uint8_t *)clip.GetData();
+        len_ = clip.GetLen();
+        bits_per_sample_ = clip.GetBitsPerSample();
+        cached_ = cached;
+        cached_len_ = (cached != nullptr) ? cached_len : 0;
+        assert( cached_len_ <= len_ );
+        Restart();
+    }
+
+    // ISampleSource Interface overrides begin {
+
+    unsigned int Read(int16_t *out, unsigned int num_samples) override
+    {
+        if( flash_ == nullptr )
+            return 0;
+
+        // RAM prefix, then the flash remainder, each a one-shot render
+        unsigned int produced = 0;
+        if( pos_ < cached_len_ )
+            produced = RenderBlock(cached_, cached_len_, bits_per_sample_, false, pos_, ram_done_, out, num_samples);
+        if( (produced < num_samples) && (pos_ >= cached_len_) )
+        {
+            const uint8_t *rest = flash_ + cached_len_ * (bits_per_sample_ / 8);
+            unsigned int rest_pos = pos_ - cached_len_;
+            produced += RenderBlock(rest, len_ - cached_len_, bits_per_sample_, false,
+                    rest_pos, flash_done_, out + produced, num_samples - produced);
+            pos_ = cached_len_ + rest_pos;
+        }
+        return produced;
+    }
+
+    void Restart() override
+    {
+        pos_ = 0;
+        ram_done_ = false;
+        flash_done_ = false;
+    }
+
+    // ISampleSource Interface overrides end }
+
+private:
+    const uint8_t *flash_ = nullptr;
+    unsigned int len_ = 0;
+    unsigned int bits_per_sample_ = 8;
+    const void *cached_ = nullptr;
+    unsigned int cached_len_ = 0;
+    unsigned int pos_ = 0;
+    bool ram_done_ = false;
+    bool flash_done_ = false;
+};
+
+// vim: sw=4:ts=4
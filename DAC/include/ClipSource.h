@@ -0,0 +1,100 @@
+// Clip source
+// - plays an asset bank clip (see AssetBank.h) whatever its codec, decoding in place as it's read
+// - one ClipSource per concurrently playing clip, e.g. per Mixer voice
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+#include "AssetBankFormat.h"
+#include "SampleSource.h"
+#include "Adpcm.h"
+#include "Companding.h"
+#include "Lz.h"
+#include "Silence.h"
+
+class ClipSource : public ISampleSource
+{
+public:
+    ClipSource() {}
+
+    // Clip & its data, as returned by AssetBank::Find()/Get() & AssetBank::GetData()
+    // - returns false for an unsupported codec (the source then reads as empty)
+    bool SetClip(const AssetClipEntry *clip, const void *data, bool looped=false)
+    {
+        assert(clip);
+        looped_ = looped;
+        active_ = nullptr;
+        switch( (ClipCodec)clip->codec )
+        {
+        case ClipCodec::Pcm:
+            pcm_.SetBuffer(data, clip->num_samples, clip->bits_per_sample);
+            pcm_.SetLooped(looped);
+            active_ = &pcm_;
+            break;
+        case ClipCodec::ImaAdpcm:
+            adpcm_.SetData(data, clip->num_bytes, clip->num_samples);
+            active_ = &adpcm_;
+            break;
+        case ClipCodec::MuLaw:
+            companded_.SetData(kMuLawTable, data, clip->num_samples);
+            active_ = &companded_;
+            break;
+        case ClipCodec::ALaw:
+            companded_.SetData(kALawTable, data, clip->num_samples);
+            active_ = &companded_;
+            break;
+        case ClipCodec::Lz:
+            lz_.SetData(data, clip->num_bytes, clip->num_samples, clip->bits_per_sample);
+            active_ = &lz_;
+            break;
+        case ClipCodec::SilenceRle:
+            silence_.SetData(data, clip->num_bytes, clip->num_samples, clip->bits_per_sample);
+            active_ = &silence_;
+            break;
+        case ClipCodec::Envelope:
+            break;  // not audio
+        }
+        Restart();
+        return active_ != nullptr;
+    }
+
+    // ISampleSource Interface overrides begin {
+
+    unsigned int Read(int16_t *out, unsigned int num_samples) override
+    {
+        if( active_ == nullptr )
+            return 0;
+        unsigned int n = active_->Read(out, num_samples);
+        // decoders are one-shot, loop them here
+        while( looped_ && (active_ != &pcm_) && (n < num_samples) )
+        {
+            active_->Restart();
+            unsigned int m = active_->Read(out + n, num_samples - n);
+            if( m == 0 )
+                break;  // empty clip
+            n += m;
+        }
+        return n;
+    }
+
+    void Restart() override
+    {
+        if( active_ != nullptr )
+            active_->Restart();
+    }
+
+    // ISampleSource Interface overrides end }
+
+private:
+    BufferSource pcm_;
+    AdpcmSource adpcm_;
+    CompandedSource companded_;
+    LzSource lz_;
+    SilenceSource silence_;
+    ISampleSource *active_ = nullptr;
+    bool looped_ = false;
+};
+
+// vim: sw=4:ts=4
@@ -0,0 +1,118 @@
+// Read-only clip view
+// - pointer, length, samplerate & bit depth of PCM clip data that lives in flash, played in place
+// - constructible only from:
+//  - const arrays, e.g. a const uint8_t[] .dat include, which the toolchain places in flash
+//  (rodata) rather than initialized DRAM
+//  - asset bank clips (flash partition mmap), or other mapped flash via ::FromFlash()
+// - what's enforced:
+//  - at compile time: non-const arrays are rejected (they'd be copied into DRAM at boot), as are
+//  raw pointers, which have no length
+//  - at run time, on target: every constructor asserts the data is in the flash data mapping, as
+//  const alone doesn't guarantee it (e.g. a const local array is on the stack)
+// - see IDac::SetBuffer(const ClipView &) & BufferSource
+// - no Arduino dependencies (the flash check is target-only)
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include "AssetBankFormat.h"
+
+#ifdef ARDUINO
+#   include <soc/soc.h>
+#endif
+
+class ClipView
+{
+public:
+    // From const arrays, length & bit depth deduced
+    // - .dat files of 16-bit hex values need uint16_t arrays, they hold the int16_t bit patterns
+    template<size_t N>
+    ClipView(const uint8_t (&data)[N], unsigned int samplerate)
+        : data_(data), len_(N), samplerate_(samplerate), bits_per_sample_(8)
+    {
+        assert( IsFlashResident(data) );
+    }
+
+    template<size_t N>
+    ClipView(const int16_t (&data)[N], unsigned int samplerate)
+        : data_(data), len_(N), samplerate_(samplerate), bits_per_sample_(16)
+    {
+        assert( IsFlashResident(data) );
+    }
+
+    template<size_t N>
+    ClipView(const uint16_t (&data)[N], unsigned int samplerate)
+        : data_(data), len_(N), samplerate_(samplerate), bits_per_sample_(16)
+    {
+        assert( IsFlashResident(data) );
+    }
+
+    // Non-const arrays would be copied into DRAM at boot, declare the data const
+    template<size_t N> ClipView(uint8_t (&data)[N], unsigned int samplerate) = delete;
+    template<size_t N> ClipView(int16_t (&data)[N], unsigned int samplerate) = delete;
+    template<size_t N> ClipView(uint16_t (&data)[N], unsigned int samplerate) = delete;
+
+    // From an asset bank clip & its data, as returned by AssetBank::Find()/Get() & ::GetData()
+    // - PCM clips only, other codecs need decoding (see ClipSource)
+    ClipView(const AssetClipEntry *clip, const void *data)
+        : ClipView(FromFlash(data, clip->num_samples, clip->samplerate, clip->bits_per_sample))
+    {
+        assert( clip->codec == (uint8_t)ClipCodec::Pcm );
+    }
+
+    // From a pointer into mapped flash
+    static ClipView FromFlash(const void *data, unsigned int len, unsigned int samplerate, unsigned int bits_per_sample)
+    {
+        assert( IsFlashResident(data) );
+        assert( (bits_per_sample == 8) || (bits_per_sample == 16) );
+        return ClipView(data, len, samplerate, bits_per_sample);
+    }
+
+    // True if ptr is in the flash data mapping (rodata & esp_partition_mmap() regions)
+    // - always true on the host
+    static bool IsFlashResident(const void *ptr)
+    {
+#ifdef ARDUINO
+        return ((uintptr_t)ptr >= SOC_DROM_LOW) && ((uintptr_t)ptr < SOC_DROM_HIGH);
+#else
+        (void)ptr;
+        return true;
+#endif
+    }
+
+    constexpr const void * GetData() const
+    {
+        return data_;
+    }
+
+    // In samples
+    constexpr unsigned int GetLen() const
+    {
+        return len_;
+    }
+
+    constexpr unsigned int GetSamplerate() const
+    {
+        return samplerate_;
+    }
+
+    constexpr unsigned int GetBitsPerSample() const
+    {
+        return bits_per_sample_;
+    }
+
+private:
+    constexpr ClipView(const void *data, unsigned int len, unsigned int samplerate, unsigned int bits_per_sample)
+        : data_(data), len_(len), samplerate_(samplerate), bits_per_sample_(bits_per_sample)
+    {
+    }
+
+    const void *data_;
+    unsigned int len_;
+    unsigned int samplerate_;
+    unsigned int bits_per_sample_;
+};
+
+// vim: sw=4:ts=4
@@ -0,0 +1,187 @@
+// G.711 µ-law & A-law companded 8-bit samples
+// - 8 bits per sample, like 8-bit linear PCM, but logarithmically spaced levels so quiet passages
+// keep ~13-14 bit resolution
+// - decode is a single lookup in a 256-entry table, the tables are generated at compile time
+// (constexpr) and checked with static_asserts
+//  - decoded values match the ITU-T G.711 reference (Sun g711.c) bit-exactly, scaled to 16 bits
+// - CompandedSource decodes as the DAC reads, see ClipCodec::MuLaw/ALaw for asset bank clips
+// - MuLawEncode()/ALawEncode() are for host tools & tests
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+#include "SampleSource.h"
+
+//-----------------------------------
+// Compile-time table generation
+// - C++11 has no std::index_sequence, so a minimal one
+
+template<unsigned... I> struct IndexSeq {};
+template<unsigned N, unsigned... I> struct MakeIndexSeq : MakeIndexSeq<N - 1, N - 1, I...> {};
+template<unsigned... I> struct MakeIndexSeq<0, I...>
+{
+    typedef IndexSeq<I...> type;
+};
+
+struct CompandTable
+{
+    int16_t val[256];
+};
+
+// µ-law: code is stored inverted, 3-bit segment + 4-bit step, bias 0x84
+constexpr int16_t _MuLawMagnitude(unsigned int u)
+{
+    return (int16_t)(((((u & 0x0f) << 3) + 0x84) << ((u & 0x70) >> 4)) - 0x84);
+}
+
+constexpr int16_t MuLawDecode(uint8_t code)
+{
+    return (~code & 0x80) ? (int16_t)-_MuLawMagnitude(~code & 0xff) : _MuLawMagnitude(~code & 0xff);
+}
+
+// A-law: even bits inverted (xor 0x55), 3-bit segment + 4-bit step, sign bit set == positive
+constexpr int16_t _ALawMagnitude(unsigned int a)
+{
+    return (int16_t)((((a & 0x70) >> 4) == 0) ? (((a & 0x0f) << 4) + 8)
+                                              : ((((a & 0x0f) << 4) + 0x108) << (((a & 0x70) >> 4) - 1)));
+}
+
+constexpr int16_t ALawDecode(uint8_t code)
+{
+    return ((code ^ 0x55) & 0x80) ? _ALawMagnitude(code ^ 0x55) : (int16_t)-_ALawMagnitude(code ^ 0x55);
+}
+
+template<unsigned... I>
+constexpr CompandTable _MakeMuLawTable(IndexSeq<I...>)
+{
+    return CompandTable{ { MuLawDecode(I)... } };
+}
+
+template<unsigned... I>
+constexpr CompandTable _MakeALawTable(IndexSeq<I...>)
+{
+    return CompandTable{ { ALawDecode(I)... } };
+}
+
+static constexpr CompandTable kMuLawTable = _MakeMuLawTable(MakeIndexSeq<256>::type());
+static constexpr CompandTable kALawTable = _MakeALawTable(MakeIndexSeq<256>::type());
+
+// Both laws are sign-symmetric about the top bit, checked over the whole table
+constexpr bool _IsSymmetric(const CompandTable & table, unsigned int code=0)
+{
+    return (code >= 128) || ((table.val[code] == -table.val[code | 0x80]) && _IsSymmetric(table, code + 1));
+}
+
+// G.711 reference values
+static_assert(kMuLawTable.val[0x00] == -32124 && kMuLawTable.val[0x80] == 32124, "µ-law full scale");
+static_assert(kMuLawTable.val[0x7f] == 0 && kMuLawTable.val[0xff] == 0, "µ-law zero");
+static_assert(kMuLawTable.val[0x70] == -120 && kMuLawTable.val[0xfe] == 8, "µ-law segment 0");
+static_assert(kALawTable.val[0xaa] == 32256 && kALawTable.val[0x2a] == -32256, "A-law full scale");
+static_assert(kALawTable.val[0xd5] == 8 && kALawTable.val[0x55] == -8, "A-law smallest step");
+static_assert(kALawTable.val[0xc5] == 264 && kALawTable.val[0xe5] == 1056, "A-law segments 1 & 3");
+static_assert(_IsSymmetric(kMuLawTable) && _IsSymmetric(kALawTable), "sign symmetry");
+
+//-----------------------------------
+// Encoders
+// - as per the G.711 reference, 16-bit input
+
+inline uint8_t MuLawEncode(int16_t sample)
+{
+    static const int16_t kSegEnd[8] = { 0x3f, 0x7f, 0xff, 0x1ff, 0x3ff, 0x7ff, 0xfff, 0x1fff };
+    int32_t val = sample >> 2;
+    uint8_t mask = 0xff;
+    if( val < 0 )
+    {
+        val = -val;
+        mask = 0x7f;
+    }
+    if( val > 8159 )
+        val = 8159;     // clip
+    val += 0x84 >> 2;
+
+    unsigned int seg = 0;
+    while( (seg < 8) && (val > kSegEnd[seg]) )
+        seg++;
+    if( seg >= 8 )
+        return 0x7f ^ mask;
+    return (uint8_t)(((seg << 4) | ((val >> (seg + 1)) & 0x0f)) ^ mask);
+}
+
+inline uint8_t ALawEncode(int16_t sample)
+{
+    static const int16_t kSegEnd[8] = { 0x1f, 0x3f, 0x7f, 0xff, 0x1ff, 0x3ff, 0x7ff, 0xfff };
+    int32_t val = sample >> 3;
+    uint8_t mask = 0xd5;
+    if( val < 0 )
+    {
+        val = -val - 1;
+        mask = 0x55;
+    }
+
+    unsigned int seg = 0;
+    while( (seg < 8) && (val > kSegEnd[seg]) )
+        seg++;
+    if( seg >= 8 )
+        return 0x7f ^ mask;
+    uint8_t code = (uint8_t)(seg << 4);
+    code |= (seg < 2) ? ((val >> 1) & 0x0f) : ((val >> seg) & 0x0f);
+    return code ^ mask;
+}
+
+//-----------------------------------
+// Companded data source
+// - one table lookup per sample, straight into the DAC's 16-bit render block
+class CompandedSource : public ISampleSource
+{
+public:
+    CompandedSource(const CompandTable & table=kMuLawTable, const void *data=nullptr, uint32_t num_samples=0)
+    {
+        SetData(table, data, num_samples);
+    }
+
+    void SetData(const CompandTable & table, const void *data, uint32_t num_samples)
+    {
+        table_ = table.val;
+        data_ = (const uint8_t *)data;
+        num_samples_ = num_samples;
+        assert( (data_ != nullptr) || (num_samples_ == 0) );
+        Restart();
+    }
+
+    // ISampleSource Interface overrides begin {
+
+    unsigned int Read(int16_t *out, unsigned int num_samples) override
+    {
+        if( num_samples > num_samples_ - pos_ )
+            num_samples = num_samples_ - pos_;
+        const uint8_t *src = data_ + pos_;
+        for( unsigned int i=0; i<num_samples; i++ )
+        {
+            out[i] = table_[src[i]];
+        }
+        pos_ += num_samples;
+        return num_samples;
+    }
+
+    void Restart() override
+    {
+        pos_ = 0;
+    }
+
+    // ISampleSource Interface overrides end }
+
+    uint32_t GetPos() const
+    {
+        return pos_;
+    }
+
+private:
+    const int16_t *table_;
+    const uint8_t *data_;
+    uint32_t num_samples_;
+    uint32_t pos_;
+};
+
+// vim: sw=4:ts=4
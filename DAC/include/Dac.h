@@ -39,7 +39,10 @@ SPKR   ▽     │      ┌───║BYPASS        IN-║
              │      │   ║        ◯        ║            ▽
              ▽      ▽   ╚═════════════════╝        
 
-- Two options:
+- Three options:
+    DacDMA - I2S DMA-based driver (need to call ::Loop() at least once per DMA buffer)
+        - built-in DAC fed via the I2S peripheral, CPU only involved for block refills
+        - intended for rates up to 44.1 kHz, and to not be disturbed by serial prints
     DacT - timer-based driver
         - good up to about 16 kHz (w/ either 8/16 bit data buffer)
             - beyond that, playback seems slowed down, guessing it's a limitation of the timer rate
@@ -86,19 +89,32 @@ See: https://github.com/earlephilhower/ESP8266Audio/#software-i2s-delta-sigma-da
 
 #include "../../SerialLog/include/SerialLog.h"
 #include "../../Ticker/include/Ticker.h"
+#include "DacRender.h"
+#include "SampleSource.h"
+#include "ClipView.h"
+#include "Resampler.h"
+#include "Mixer.h"
+#include "SampleRing.h"
+#include "DmaFiller.h"
+#include "SampleClock.h"
 #include <assert.h>
-
-// Helpers
-
-// Convert int16_t sample to uint8_t sample
-uint8_t ConvertSampleTo8Bit(int16_t i16_val)
+#include <driver/i2s.h>
+#include <soc/soc.h>
+#include <soc/rtc_io_reg.h>
+#include <soc/i2s_struct.h>
+#include <rom/lldesc.h>
+
+// Write DAC output value for a compile-time DAC pin
+// - only updates the output value register, relying on a prior dacWrite() to the pin to have
+// powered up the DAC channel (as done by the Static* DAC constructors)
+template<uint8_t PIN>
+inline void DacWritePin(uint8_t value)
 {
-    // input value in range [-32768, 32767]
-    i16_val >>= 8; // reduce range to [-128, 127]
-    i16_val += 128; // range [0, 255]
-    assert( i16_val >= 0 );
-    assert( i16_val <= 255 );
-    return (uint8_t)i16_val;
+    static_assert( (PIN == DAC1) || (PIN == DAC2), "PIN must be DAC1 or DAC2" );
+    if( PIN == DAC1 )
+        SET_PERI_REG_BITS(RTC_IO_PAD_DAC1_REG, RTC_IO_PDAC1_DAC, value, RTC_IO_PDAC1_DAC_S);
+    else
+        SET_PERI_REG_BITS(RTC_IO_PAD_DAC2_REG, RTC_IO_PDAC2_DAC, value, RTC_IO_PDAC2_DAC_S);
 }
 
 // Interface class to DAC functionality
@@ -145,10 +161,85 @@ public:
         buffer_pos_ = 0;
     }
 
+    // Play a flash-resident clip in place (see ClipView.h)
+    // - clip samplerate must match the DAC's, see Resampler otherwise
+    void SetBuffer(const ClipView & clip)
+    {
+        assert( clip.GetSamplerate() == GetSamplerate() );
+        SetBuffer(clip.GetData(), clip.GetLen(), clip.GetBitsPerSample());
+    }
+
+    // Block render API
+    // - renders up to num_samples output samples into the caller-supplied buffer, advancing the
+    // play position
+    // - returns number of samples rendered, less than num_samples only once a one-shot buffer is done
+    // - backends that render ahead of their output will report a GetCurrentPos() that leads the
+    // audible position by up to one block
+    // - 16-bit data is converted to 8-bit output as per ::SetConvertMode()
+    virtual unsigned int Render(uint8_t *out, unsigned int num_samples)
+    {
+        if( (source_ == nullptr) &&
+            ((bits_per_sample_ != 16) || (converter_.GetMode() == ConvertMode::Truncate)) )
+        {
+            return RenderBlock(buffer_, buffer_len_, bits_per_sample_, looped_, buffer_pos_, done_, out, num_samples);
+        }
+
+        // source, or dither/noise shaping: render 16-bit in chunks, then convert
+        unsigned int rendered = 0;
+        while( rendered < num_samples )
+        {
+            int16_t chunk[kConvertChunkLen];
+            unsigned int n = num_samples - rendered;
+            if( n > kConvertChunkLen )
+                n = kConvertChunkLen;
+            n = Render(chunk, n);
+            if( n == 0 )
+                break;
+            converter_.Convert(chunk, out + rendered, n);
+            rendered += n;
+        }
+        return rendered;
+    }
+
+    virtual unsigned int Render(int16_t *out, unsigned int num_samples)
+    {
+        if( source_ != nullptr )
+        {
+            if( done_ )
+                return 0;
+            unsigned int n = source_->Read(out, num_samples);
+            if( n < num_samples )
+                done_ = true;
+            return n;
+        }
+        return RenderBlock(buffer_, buffer_len_, bits_per_sample_, looped_, buffer_pos_, done_, out, num_samples);
+    }
+
+    // Play from a sample source (e.g. a Resampler) instead of the data buffer
+    // - source samples are at the DAC samplerate, the DAC is done once the source is exhausted
+    // - ::Restart() restarts the DAC but not the source, call source->Restart() to replay it
+    // - pass nullptr to go back to the data buffer
+    // - nothing to visualize in this mode, GetDataBuffer() & GetCurrentPos() refer to the data buffer
+    void SetSource(ISampleSource *source)
+    {
+        source_ = source;
+    }
+
+    // 16->8 bit conversion used for 8-bit output of 16-bit data, default is ConvertMode::Truncate
+    // - see SampleConvert.h for the modes
+    void SetConvertMode(ConvertMode mode)
+    {
+        converter_.SetMode(mode);
+    }
+
     virtual void Restart() = 0;
     virtual void Loop() = 0;
 
 protected:
+    static const unsigned int kConvertChunkLen = 64;    // in samples
+
+    SampleConverter converter_;
+    ISampleSource *source_ = nullptr;
     bool looped_;
     const void *buffer_;
     unsigned int buffer_len_;
@@ -158,88 +249,172 @@ protected:
     bool done_;
 };
 
-// Polled 8-bit DAC implementation
-// - user needs to call ::Loop() periodically at a rate faster than the output sampling rate.
-// - mainly for illustrative purposes, should use DacT for Timer-driven implementation which is:
-//  - lighter on CPU load
-// - ALSO NOTE:
-//  - this implementation uses micros() which will roll over every 70 mins or so, so beware of random glitch
-//  - another reason to use DacT instead
-class Dac : public IDac
+//-----------------------------------------------------------------
+// Render bases & DAC pin writers for the output drivers below
+// - each output driver (polled, Ticker, delta-sigma) is a template on its render base, and is
+// instantiated in two forms:
+//  - runtime-configured, e.g. Dac: sample format & loop mode are set at construction, the block
+//  render dispatches on them once per block (see RenderBlock())
+//  - compile-time specialized, e.g. StaticDac<uint8_t, Looped::No>: sample format, loop mode and
+//  (where applicable) DAC pin are template parameters, the block render is a direct RenderBlockT<>
+// - both forms share all setup/Restart/Loop/timer code, the per-sample path is a block index with no
+// format or loop-mode branches, and blocks are rendered via a non-virtual TBase::Render() call
+// - see DacBench for per-sample cycle comparisons of both forms
+
+// Runtime-configured render base
+class RuntimeDacBase : public IDac
 {
-public:
-    Dac(unsigned int samplerate_Hz, bool looped=true, const void *buffer=nullptr, unsigned int buffer_len=0, unsigned int bits_per_sample=8, uint8_t dac_pin=DAC1)
+protected:
+    RuntimeDacBase(unsigned int samplerate_Hz, bool looped, unsigned int bits_per_sample)
     {
         samplerate_ = samplerate_Hz;
         looped_ = looped;
         bits_per_sample_ = bits_per_sample;
+        buffer_ = nullptr;
+        buffer_len_ = 0;
+        buffer_pos_ = 0;
+        done_ = true;
+    }
+};
+
+// Compile-time specialized render base: typed data buffer
+// - 16-bit data is truncated to 8-bit, ::SetConvertMode() isn't applied
+// - plays the data buffer only, ::SetSource() isn't supported
+template<typename TSample, Looped LOOPED>
+class StaticDacBase : public IDac
+{
+    static_assert( (sizeof(TSample) == 1) || (sizeof(TSample) == 2), "TSample must be uint8_t or int16_t" );
+
+public:
+    static const unsigned int kBitsPerSample = 8 * sizeof(TSample);
+
+    using IDac::SetBuffer;
+
+    void SetBuffer(const void *buffer, unsigned int buffer_len, unsigned int bits_per_sample) override
+    {
+        assert( bits_per_sample == kBitsPerSample );
+        IDac::SetBuffer(buffer, buffer_len, bits_per_sample);
+        data_ = (const TSample *)buffer;
+    }
+
+    unsigned int Render(uint8_t *out, unsigned int num_samples) override
+    {
+        return RenderBlockT<TSample, LOOPED>(data_, buffer_len_, buffer_pos_, done_, out, num_samples);
+    }
+
+    unsigned int Render(int16_t *out, unsigned int num_samples) override
+    {
+        return RenderBlockT<TSample, LOOPED>(data_, buffer_len_, buffer_pos_, done_, out, num_samples);
+    }
+
+protected:
+    StaticDacBase(unsigned int samplerate_Hz, bool looped, unsigned int bits_per_sample)
+    {
+        assert( looped == (LOOPED == Looped::Yes) );
+        assert( bits_per_sample == kBitsPerSample );
+        (void)looped;
+        (void)bits_per_sample;
+
+        samplerate_ = samplerate_Hz;
+        looped_ = (LOOPED == Looped::Yes);
+        bits_per_sample_ = kBitsPerSample;
+        buffer_ = nullptr;
+        buffer_len_ = 0;
+        buffer_pos_ = 0;
         done_ = true;
+    }
 
+    const TSample *data_ = nullptr;
+};
+
+// Runtime-selected DAC pin
+class DacPin
+{
+public:
+    DacPin(uint8_t dac_pin)
+        : dac_pin_(dac_pin)
+    {
         // Verify DAC pin was specified
         assert( (dac_pin == DAC1) || (dac_pin == DAC2) );
-        dac_pin_ = dac_pin;
+    }
 
-        time_interval_ = 1000000 / samplerate_Hz;
+    void Write(uint8_t value)
+    {
+        dacWrite(dac_pin_, value);
+    }
 
-        if( buffer != nullptr )
-        {
-            assert(buffer_len > 0 );
+private:
+    uint8_t dac_pin_;
+};
 
-            SetBuffer(buffer, buffer_len, bits_per_sample);
-            Restart();
-        }
+// Compile-time DAC pin
+template<uint8_t PIN>
+class StaticDacPin
+{
+public:
+    StaticDacPin()
+    {
+        dacWrite(PIN, 0x80);    // power up the DAC channel, DacWritePin() then only updates the value
+    }
+
+    void Write(uint8_t value)
+    {
+        DacWritePin<PIN>(value);
     }
+};
 
-    virtual ~Dac() {}
+//-----------------------------------------------------------------
+// Polled 8-bit DAC implementation
+// - user needs to call ::Loop() periodically at a rate faster than the output sampling rate.
+// - mainly for illustrative purposes, should use DacT for Timer-driven implementation which is:
+//  - lighter on CPU load
+// - samples are scheduled by a SampleClock: exact average rate (fractional micro sec periods) and
+// safe across micros() roll-over
+//  - if ::Loop() stalls, up to max_lag missed samples are emitted on the following calls, beyond
+//  that the catch-up policy applies, see ::SetCatchUp()
+// - see Dac & StaticDac for the runtime-configured & compile-time specialized forms
+template<typename TBase, typename TPin>
+class DacPolledOut : public TBase
+{
+public:
+    virtual ~DacPolledOut() {}
 
     // IDac Interface overrides begin {
 
     // Intended to restart one-shot (ie. non-looped) mode
     void Restart() override
     {
-        done_ = false;
-        buffer_pos_ = 0;
-        time_prev_toggle_ = 0;
+        this->done_ = false;
+        this->buffer_pos_ = 0;
+        block_len_ = 0;
+        block_idx_ = 0;
+        clock_running_ = false;
     }
 
     void Loop() override
     {
-        if (done_)
+        if ((block_idx_ >= block_len_) && !_Refill())
             return;
 
-        unsigned long time_now = micros();
-        if((time_prev_toggle_ == 0) || (time_now >= time_prev_toggle_ + time_interval_))
+        uint32_t time_now = micros();
+        if (!clock_running_)
         {
-            uint8_t sample_val;
-            if( bits_per_sample_ == 8 )
-            {
-                const uint8_t *buf = (uint8_t*)buffer_;
-                sample_val = buf[buffer_pos_];
-            }
-            else
-            {
-                assert( bits_per_sample_ == 16 );
-                const int16_t *buf = (int16_t*)buffer_;
-                int16_t i16_val = buf[buffer_pos_];
-                sample_val = ConvertSampleTo8Bit(i16_val);
-            }
+            clock_.Start(time_now);
+            clock_running_ = true;
+        }
 
-            dacWrite(dac_pin_, sample_val);
-            buffer_pos_++;
-            if(buffer_pos_ >= buffer_len_)
+        unsigned int num_skip;
+        if (clock_.Poll(time_now, &num_skip))
+        {
+            if (num_skip > 0)
             {
-                if( looped_ )
-                {
-                    buffer_pos_ = 0;
-                }
-                else
-                {
-                    done_ = true;
-                    //SerialLog::Log("DAC is done");
-                }
+                _Skip(num_skip);
+                if ((block_idx_ >= block_len_) && !_Refill())
+                    return;
             }
 
-            time_prev_toggle_ = time_now;
+            pin_.Write(block_[block_idx_]);
+            block_idx_++;
 
             // TEST-CODE: report DAC outputs
 #if 0
@@ -260,19 +435,270 @@ public:
 
     // IDac Interface overrides end }
 
+    // Set policy for when ::Loop() has stalled for more than max_lag sample periods
+    // - SampleClock::kDrop (default): skip the missed samples, playback stays in time
+    // - SampleClock::kEmit: play the missed samples as fast as ::Loop() is called until caught up
+    void SetCatchUp(SampleClock::CatchUp catch_up, unsigned int max_lag=8)
+    {
+        clock_.SetCatchUp(catch_up, max_lag);
+    }
+
+protected:
+    DacPolledOut(unsigned int samplerate_Hz, bool looped, const void *buffer, unsigned int buffer_len, unsigned int bits_per_sample, const TPin & pin)
+        : TBase(samplerate_Hz, looped, bits_per_sample)
+        , pin_(pin)
+    {
+        clock_.SetSamplerate(samplerate_Hz);
+
+        if( buffer != nullptr )
+        {
+            assert(buffer_len > 0 );
+
+            this->SetBuffer(buffer, buffer_len, bits_per_sample);
+            Restart();
+        }
+    }
+
 private:
-    uint8_t dac_pin_;
-    unsigned time_interval_;  // interval in micro secs
-    unsigned long time_prev_toggle_;
+    // Refill the output block, conversion & wrap handled once per block
+    // - returns false if there's nothing left to play
+    bool _Refill()
+    {
+        if (this->done_)
+            return false;
+
+        block_len_ = TBase::Render(block_, kBlockLen);
+        block_idx_ = 0;
+        return (block_len_ > 0);
+    }
+
+    // Discard samples dropped by the sample clock
+    void _Skip(unsigned int num_samples)
+    {
+        while (num_samples > 0)
+        {
+            if ((block_idx_ >= block_len_) && !_Refill())
+                return;
+
+            unsigned int n = min(num_samples, block_len_ - block_idx_);
+            block_idx_ += n;
+            num_samples -= n;
+        }
+    }
+
+    static const unsigned int kBlockLen = 32;   // in samples
+
+    TPin pin_;
+    SampleClock clock_;
+    bool clock_running_ = false;
+
+    uint8_t block_[kBlockLen];
+    unsigned int block_len_ = 0;
+    unsigned int block_idx_ = 0;
+};
+
+// Polled 8-bit DAC, runtime-configured
+class Dac : public DacPolledOut<RuntimeDacBase, DacPin>
+{
+public:
+    Dac(unsigned int samplerate_Hz, bool looped=true, const void *buffer=nullptr, unsigned int buffer_len=0, unsigned int bits_per_sample=8, uint8_t dac_pin=DAC1)
+        : DacPolledOut(samplerate_Hz, looped, buffer, buffer_len, bits_per_sample, DacPin(dac_pin))
+    {
+    }
+};
+
+// Polled 8-bit DAC, compile-time specialized, e.g.
+//      StaticDac<uint8_t, Looped::No> dac(8000, buf, buf_len);
+template<typename TSample, Looped LOOPED, uint8_t PIN=DAC1>
+class StaticDac : public DacPolledOut<StaticDacBase<TSample, LOOPED>, StaticDacPin<PIN>>
+{
+    typedef DacPolledOut<StaticDacBase<TSample, LOOPED>, StaticDacPin<PIN>> Super;
+
+public:
+    StaticDac(unsigned int samplerate_Hz, const TSample *buffer=nullptr, unsigned int buffer_len=0)
+        : Super(samplerate_Hz, (LOOPED == Looped::Yes), buffer, buffer_len, Super::kBitsPerSample, StaticDacPin<PIN>())
+    {
+    }
 };
 
+//-----------------------------------------------------------------
 // Timer/Ticker-based 8-bit DAC implementation
 // - ::_Loop() is periodically called automatically via the Ticker/Timer mechanism
 // - ::Loop() is provided as a dummy fcn for IDac API requirements but user doesn't need to call it
-class DacT : public IDac
+// - NOTE: SetBuffer()/Restart() from loop() are not synchronized with ::_Loop(), use the streaming
+// mode (::SetRing()) to hand samples to a playing DacT
+// - see DacT & StaticDacT for the runtime-configured & compile-time specialized forms
+template<typename TBase, typename TPin>
+class DacTickerOut : public TBase
+{
+public:
+    virtual ~DacTickerOut()
+    {
+        m_ticker.detach();
+    }
+
+    // IDac Interface overrides begin {
+
+    // Intended to restart one-shot (ie. non-looped) mode
+    void Restart() override
+    {
+        this->done_ = false;
+        this->buffer_pos_ = 0;
+        block_len_ = 0;
+        block_idx_ = 0;
+    }
+
+    // Dummy implementation to fulfill IDac API requirements.  User doesn't need to call it
+    void Loop() override
+    {
+        return;
+    }
+
+    bool IsPlaying() override
+    {
+        if( ring_ )
+            return (ring_->Available() > 0) || (block_idx_ < block_len_);
+        return TBase::IsPlaying();
+    }
+
+    // IDac Interface overrides end }
+
+    // Streaming mode
+    // - consume samples from the ring rather than from the data buffer, e.g. as they are produced
+    // by TTS, so playback can start before the whole utterance is available
+    // - once streaming, the ring is the only state shared between the producer and ::_Loop()
+    // - on underrun the output holds its last value
+    // - pass nullptr to return to buffer mode
+    void SetRing(SampleRing<uint8_t> *ring)
+    {
+        ring_ = ring;
+    }
+
+    // Number of times the ring ran dry while streaming (includes end of each stream)
+    unsigned int GetNumUnderruns()
+    {
+        return num_underruns_;
+    }
+
+protected:
+    DacTickerOut(unsigned int samplerate_Hz, bool looped, const void *buffer, unsigned int buffer_len, unsigned int bits_per_sample, const TPin & pin)
+        : TBase(samplerate_Hz, looped, bits_per_sample)
+        , pin_(pin)
+    {
+        if( buffer != nullptr )
+        {
+            assert(buffer_len > 0);
+
+            this->SetBuffer(buffer, buffer_len, bits_per_sample);
+            Restart();
+        }
+
+        uint32_t interval_us = 1000000 / samplerate_Hz;
+
+        m_ticker.template attach_us<DacTickerOut *>(interval_us, DacTickerOut::_Loop, this);
+    }
+
+    static void _Loop(DacTickerOut *instance)
+    {
+        if (instance->block_idx_ >= instance->block_len_)
+        {
+            SampleRing<uint8_t> *ring = instance->ring_;
+            if (ring)
+            {
+                // streaming mode: take whatever the producer has queued, up to a block
+                bool was_streaming = (instance->block_len_ > 0);
+                instance->block_len_ = ring->Pop(instance->block_, kBlockLen);
+                instance->block_idx_ = 0;
+                if (instance->block_len_ == 0)
+                {
+                    if (was_streaming)
+                        instance->num_underruns_++;
+                    return;
+                }
+            }
+            else
+            {
+                if (instance->done_)
+                    return;
+
+                // refill the output block, conversion & wrap handled once per block
+                instance->block_len_ = instance->TBase::Render(instance->block_, kBlockLen);
+                instance->block_idx_ = 0;
+                if (instance->block_len_ == 0)
+                    return;
+            }
+        }
+
+        instance->pin_.Write(instance->block_[instance->block_idx_]);
+        instance->block_idx_++;
+    }
+
+private:
+    static const unsigned int kBlockLen = 32;   // in samples
+
+    Ticker m_ticker;
+    TPin pin_;
+
+    uint8_t block_[kBlockLen];
+    unsigned int block_len_ = 0;
+    unsigned int block_idx_ = 0;
+
+    SampleRing<uint8_t> *ring_ = nullptr;
+    unsigned int num_underruns_ = 0;
+};
+
+// Timer/Ticker-based 8-bit DAC, runtime-configured
+class DacT : public DacTickerOut<RuntimeDacBase, DacPin>
 {
 public:
     DacT(unsigned int samplerate_Hz, bool looped=true, const void *buffer=nullptr, unsigned int buffer_len=0, unsigned int bits_per_sample=8, uint8_t dac_pin=DAC1)
+        : DacTickerOut(samplerate_Hz, looped, buffer, buffer_len, bits_per_sample, DacPin(dac_pin))
+    {
+    }
+};
+
+// Timer/Ticker-based 8-bit DAC, compile-time specialized, e.g.
+//      StaticDacT<uint8_t, Looped::No> dac(8000, buf, buf_len);
+template<typename TSample, Looped LOOPED, uint8_t PIN=DAC1>
+class StaticDacT : public DacTickerOut<StaticDacBase<TSample, LOOPED>, StaticDacPin<PIN>>
+{
+    typedef DacTickerOut<StaticDacBase<TSample, LOOPED>, StaticDacPin<PIN>> Super;
+
+public:
+    StaticDacT(unsigned int samplerate_Hz, const TSample *buffer=nullptr, unsigned int buffer_len=0)
+        : Super(samplerate_Hz, (LOOPED == Looped::Yes), buffer, buffer_len, Super::kBitsPerSample, StaticDacPin<PIN>())
+    {
+    }
+};
+
+// Hardware-timer ISR-based 8-bit DAC implementation
+// - variant of DacT where samples are written from a hardware timer interrupt rather than from the
+// esp_timer task, avoiding a task context switch per sample
+//  - (esp_timer ISR dispatch isn't available in this version of the ESP32 Arduino core)
+// - the ISR & everything it calls are IRAM-resident, sample data is read directly from the buffer
+// - timer runs at 40 MHz, e.g. 22050 Hz => 1814 ticks (0.003% fast)
+// - one interrupt per sample, no batching: emitting several samples per interrupt would need
+// waiting out the sub-sample spacing inside the ISR (interrupts masked, up to a sample period per
+// interrupt), and a second alarm per extra sample saves no interrupts
+// - ::GetStats() reports measured ISR cost & arrival jitter, to show the available headroom
+// - only one DacTI at a time (the ISR has no argument)
+// - 16-bit data is always truncated, ::SetConvertMode() isn't applied in the ISR
+// - plays the data buffer only, ::SetSource() isn't supported
+// - NOTE: as the ISR reads sample data, avoid flash writes (e.g. SPIFFS, NVS) while playing
+// - NOTE: as for DacT, SetBuffer()/Restart() are not synchronized with the ISR
+class DacTI : public IDac
+{
+public:
+    struct Stats
+    {
+        uint32_t num_isrs;
+        uint32_t max_cost_cycles;   // ISR entry to exit
+        uint32_t avg_cost_cycles;
+        uint32_t max_jitter_cycles; // deviation of ISR-to-ISR interval from nominal
+        uint32_t period_cycles;     // nominal ISR-to-ISR interval
+    };
+
+    DacTI(unsigned int samplerate_Hz, bool looped=true, const void *buffer=nullptr, unsigned int buffer_len=0, unsigned int bits_per_sample=8, uint8_t dac_pin=DAC1, uint8_t timer_num=0)
     {
         samplerate_ = samplerate_Hz;
         looped_ = looped;
@@ -282,6 +708,10 @@ public:
         // Verify DAC pin was specified
         assert( (dac_pin == DAC1) || (dac_pin == DAC2) );
         dac_pin_ = dac_pin;
+        dacWrite(dac_pin_, 0x80);   // power up the DAC channel, ISR then only updates the value
+
+        sample_cycles_ = getCpuFrequencyMhz() * 1000000 / samplerate_Hz;
+        ResetStats();
 
         if( buffer != nullptr )
         {
@@ -291,14 +721,23 @@ public:
             Restart();
         }
 
-        uint32_t interval_us = 1000000 / samplerate_Hz;
+        assert( _Instance() == nullptr );
+        _Instance() = this;
 
-        m_ticker.attach_us<DacT *>(interval_us, DacT::_Loop, this);
+        const uint32_t kTimerHz = 80000000 / kTimerDivider;
+        uint64_t alarm_ticks = (kTimerHz + samplerate_Hz / 2) / samplerate_Hz;
+        timer_ = timerBegin(timer_num, kTimerDivider, true);
+        timerAttachInterrupt(timer_, &DacTI::_Isr, true);
+        timerAlarmWrite(timer_, alarm_ticks, true);
+        timerAlarmEnable(timer_);
     }
 
-    virtual ~DacT()
+    virtual ~DacTI()
     {
-        m_ticker.detach();
+        timerAlarmDisable(timer_);
+        timerDetachInterrupt(timer_);
+        timerEnd(timer_);
+        _Instance() = nullptr;
     }
 
     // IDac Interface overrides begin {
@@ -311,100 +750,141 @@ public:
     }
 
     // Dummy implementation to fulfill IDac API requirements.  User doesn't need to call it
-    void Loop()
+    void Loop() override
     {
         return;
     }
 
     // IDac Interface overrides end }
 
-private:
-    static void _Loop(DacT *instance)
+    // Consistent snapshot: the ISR updates the stats together under the same lock
+    // - (a bare read of the 64-bit total could tear on the 32-bit core)
+    void GetStats(Stats & stats)
     {
-        if (instance->done_)
-            return;
+        portENTER_CRITICAL(&stats_mux_);
+        uint32_t num_isrs = num_isrs_;
+        uint32_t max_cost_cycles = max_cost_cycles_;
+        uint64_t total_cost_cycles = total_cost_cycles_;
+        uint32_t max_jitter_cycles = max_jitter_cycles_;
+        portEXIT_CRITICAL(&stats_mux_);
+
+        stats.num_isrs = num_isrs;
+        stats.max_cost_cycles = max_cost_cycles;
+        stats.avg_cost_cycles = (num_isrs > 0) ? (uint32_t)(total_cost_cycles / num_isrs) : 0;
+        stats.max_jitter_cycles = max_jitter_cycles;
+        stats.period_cycles = sample_cycles_;
+    }
+
+    void ResetStats()
+    {
+        portENTER_CRITICAL(&stats_mux_);
+        num_isrs_ = 0;
+        max_cost_cycles_ = 0;
+        total_cost_cycles_ = 0;
+        max_jitter_cycles_ = 0;
+        prev_isr_cycles_ = 0;
+        portEXIT_CRITICAL(&stats_mux_);
+    }
 
+protected:
+    // The playing instance, for the ISR
+    // - function-local, so the header can be included by more than one translation unit
+    // - constant-initialized, so no guard on first use & safe to read from the ISR
+    static inline DacTI *& IRAM_ATTR _Instance()
+    {
+        static DacTI *instance = nullptr;
+        return instance;
+    }
+
+    static void IRAM_ATTR _Isr()
+    {
+        DacTI *instance = _Instance();
+        uint32_t start_cycles = ESP.getCycleCount();
+
+        if( !instance->done_ )
+            instance->_EmitSample();
+
+        // stats
+        uint32_t end_cycles = ESP.getCycleCount();
+        uint32_t cost = end_cycles - start_cycles;
+        portENTER_CRITICAL_ISR(&instance->stats_mux_);
+        if( cost > instance->max_cost_cycles_ )
+            instance->max_cost_cycles_ = cost;
+        instance->total_cost_cycles_ += cost;
+        if( instance->prev_isr_cycles_ != 0 )
+        {
+            int32_t interval = (int32_t)(start_cycles - instance->prev_isr_cycles_);
+            int32_t jitter = interval - (int32_t)instance->sample_cycles_;
+            if( jitter < 0 )
+                jitter = -jitter;
+            if( (uint32_t)jitter > instance->max_jitter_cycles_ )
+                instance->max_jitter_cycles_ = jitter;
+        }
+        instance->prev_isr_cycles_ = start_cycles;
+        instance->num_isrs_++;
+        portEXIT_CRITICAL_ISR(&instance->stats_mux_);
+    }
+
+    // Fetch, convert & write one sample, IRAM-safe
+    inline void IRAM_ATTR _EmitSample()
+    {
         uint8_t sample_val;
-        if( instance->bits_per_sample_ == 8 )
+        if( bits_per_sample_ == 8 )
         {
-            const uint8_t *buf = (uint8_t*)instance->buffer_;
-            sample_val = buf[instance->buffer_pos_];
+            sample_val = ((const uint8_t *)buffer_)[buffer_pos_];
         }
         else
         {
-            assert( instance->bits_per_sample_ == 16 );
-            const int16_t *buf = (int16_t*)instance->buffer_;
-            int16_t i16_val = buf[instance->buffer_pos_];
-            sample_val = ConvertSampleTo8Bit(i16_val);
+            sample_val = (uint8_t)((((const int16_t *)buffer_)[buffer_pos_] >> 8) + 128);
         }
-        
-        dacWrite(instance->dac_pin_, sample_val);
-        instance->buffer_pos_++;
-        if(instance->buffer_pos_ >= instance->buffer_len_)
+
+        if( dac_pin_ == DAC1 )
+            SET_PERI_REG_BITS(RTC_IO_PAD_DAC1_REG, RTC_IO_PDAC1_DAC, sample_val, RTC_IO_PDAC1_DAC_S);
+        else
+            SET_PERI_REG_BITS(RTC_IO_PAD_DAC2_REG, RTC_IO_PDAC2_DAC, sample_val, RTC_IO_PDAC2_DAC_S);
+
+        buffer_pos_++;
+        if( buffer_pos_ >= buffer_len_ )
         {
-            if( instance->looped_ )
-            {
-                instance->buffer_pos_ = 0;
-            }
+            if( looped_ )
+                buffer_pos_ = 0;
             else
-            {
-                instance->done_ = true;
-                //SerialLog::Log("DAC is done");
-            }
+                done_ = true;
         }
     }
 
 private:
-    Ticker m_ticker;
+    static const uint16_t kTimerDivider = 2;    // 80 MHz APB / 2 => 40 MHz
+
+    hw_timer_t *timer_;
     uint8_t dac_pin_;
+    uint32_t sample_cycles_;        // CPU cycles per sample, nominal ISR-to-ISR interval
+
+    // stats, written by the ISR, all accessed under stats_mux_
+    portMUX_TYPE stats_mux_ = portMUX_INITIALIZER_UNLOCKED;
+    uint32_t num_isrs_;
+    uint32_t max_cost_cycles_;
+    uint64_t total_cost_cycles_;
+    uint32_t max_jitter_cycles_;
+    uint32_t prev_isr_cycles_;
 };
 
+//-----------------------------------------------------------------
 // Polled Delta-Sigma DAC implementation
 // Based on AudioOutputI2SNoDAC from: https://github.com/earlephilhower/ESP8266Audio
-// TODO:
-// - think can do a Ticker based implementation via additional ::Loop() task that blocks on
-// semaphore that is signaled by Ticker fcn.
-// - this complication needed since the i2s_write() call crashes if called from the Ticker fcn
-// (hence the need to run this polled)
+// - the i2s_write() call crashes if called from a Ticker fcn (hence the need to run this polled)
+// - see DacDSTask for a variant that runs from its own task instead
+// - see DacDS & StaticDacDS for the runtime-configured & compile-time specialized forms
 
 // NOTE: finding that #includes of "../../DAC/include/Dac.h" needs to explicitly do the next include as well!
 // - seems that VSCode or platform.io or Arduino does a limited scan to determine what libs it
 // thinks it needs to incorporate...
 #include <AudioOutputI2SNoDAC.h>
-class DacDS : public IDac
+template<typename TBase>
+class DacDSOut : public TBase
 {
 public:
-    DacDS(unsigned int samplerate_Hz, bool looped=true, const void *buffer=nullptr, unsigned int buffer_len=0, unsigned int bits_per_sample=8)
-    {
-        samplerate_ = samplerate_Hz;
-        looped_ = looped;
-        bits_per_sample_ = bits_per_sample;
-        done_ = true;
-
-        i2s_output_ = new AudioOutputI2SNoDAC();    // TODO: see if compiler supports shared_ptr, I think it does...
-        assert(i2s_output_);
-
-        if( buffer != nullptr )
-        {
-            assert(buffer_len > 0 );
-
-            SetBuffer(buffer, buffer_len, bits_per_sample);
-            Restart();
-        }
-
-#if 0
-        // best to pick outputFreq that divides into 1000 sans remainder
-        // e.g.  8 kHz => 125 us output interval
-        // e.g. 10 kHz => 100 us output interval
-        // e.g. 20 kHz => 50 us output interval
-        // e.g. 25 kHz => 40 us output interval
-        uint32_t interval_us = 1000000 / samplerate_Hz;
-
-//      m_ticker.attach_us<DacDS *>(interval_us, loop, this);
-#endif
-    }
-
-    ~DacDS()
+    ~DacDSOut()
     {
 #if 0
         m_ticker.detach();
@@ -419,15 +899,17 @@ public:
     // IDac Interface overrides begin {
 
     // Intended to restart one-shot (ie. non-looped) mode
-    void Restart()
+    void Restart() override
     {
-        done_ = false;
-        buffer_pos_ = 0;
+        this->done_ = false;
+        this->buffer_pos_ = 0;
+        block_len_ = 0;
+        block_idx_ = 0;
 
         if( i2s_output_ )
         {
             bool ret;
-            ret = i2s_output_->SetRate( samplerate_ );
+            ret = i2s_output_->SetRate( this->samplerate_ );
             assert( ret );
             // 8->16 bit conversion handled in this class, so underlying AudioOutputI2SNoDAC always @ 16 bits
             ret = i2s_output_->SetBitsPerSample( 16 );
@@ -436,40 +918,83 @@ public:
             assert( ret );
             ret = i2s_output_->begin();
             assert( ret );
+            (void)ret;
         }
     }
 
-    void Loop()
+    void Loop() override
     {
 #if 0
         {
             static uint32_t call_count = 0;
 
             call_count++;
-            if( (call_count%(samplerate_)) == 0 )
+            if( (call_count%(this->samplerate_)) == 0 )
             {
                 SerialLog::Log("DacDS::Loop call count: " + String(call_count) );
             }
         }
 #endif
-        if (done_)
-            return;
+        _Output();
+    }
 
-        int16_t sample_pair[2];
-        if( bits_per_sample_ == 16 )
+    // IDac Interface overrides end }
+
+protected:
+    static const unsigned int kBlockLen = 64;   // in samples
+
+    DacDSOut(unsigned int samplerate_Hz, bool looped, const void *buffer, unsigned int buffer_len, unsigned int bits_per_sample)
+        : TBase(samplerate_Hz, looped, bits_per_sample)
+    {
+        i2s_output_ = new AudioOutputI2SNoDAC();    // TODO: see if compiler supports shared_ptr, I think it does...
+        assert(i2s_output_);
+
+        if( buffer != nullptr )
         {
-            int16_t *buf = (int16_t *)buffer_;
-            sample_pair[0] = buf[buffer_pos_];
-            sample_pair[1] = sample_pair[0];
+            assert(buffer_len > 0 );
+
+            this->SetBuffer(buffer, buffer_len, bits_per_sample);
+            Restart();
         }
-        else
+
+#if 0
+        // best to pick outputFreq that divides into 1000 sans remainder
+        // e.g.  8 kHz => 125 us output interval
+        // e.g. 10 kHz => 100 us output interval
+        // e.g. 20 kHz => 50 us output interval
+        // e.g. 25 kHz => 40 us output interval
+        uint32_t interval_us = 1000000 / samplerate_Hz;
+
+//      m_ticker.attach_us<DacDS *>(interval_us, loop, this);
+#endif
+    }
+
+    // Nothing left to output
+    bool _IsIdle()
+    {
+        return this->done_ && (block_idx_ >= block_len_);
+    }
+
+    // Output one sample
+    // - returns false if there was nothing to output or the I2S DMA buffers are full
+    bool _Output()
+    {
+        if (block_idx_ >= block_len_)
         {
-            assert( bits_per_sample_ == 8 );
-            uint8_t *buf = (uint8_t *)buffer_;
-            sample_pair[0] = ((int16_t)buf[buffer_pos_] - 128) * 256;
-            sample_pair[1] = sample_pair[0];
+            if (this->done_)
+                return false;
+
+            // refill the output block, 8->16 bit conversion & wrap handled once per block
+            block_len_ = TBase::Render(block_, kBlockLen);
+            block_idx_ = 0;
+            if (block_len_ == 0)
+                return false;
         }
 
+        int16_t sample_pair[2];
+        sample_pair[0] = block_[block_idx_];
+        sample_pair[1] = sample_pair[0];
+
 #if 0
         // sample value stats gathering
         {
@@ -499,30 +1024,268 @@ public:
 
             if( ret )
             {
-                buffer_pos_++;
-                if(buffer_pos_ >= buffer_len_)
+                block_idx_++;
+                if( this->done_ && (block_idx_ >= block_len_) )
                 {
-                    if( looped_ )
-                    {
-                        buffer_pos_ = 0;
-                    }
-                    else
-                    {
-                        done_ = true;
-                        i2s_output_->stop();
-                        //SerialLog::Log("DAC is done");
-                    }
+                    i2s_output_->stop();
+                    //SerialLog::Log("DAC is done");
                 }
             }
+            return ret;
         }
+        return false;
     }
 
-    // IDac Interface overrides end }
-
-private:
 #if 0
     Ticker m_ticker;
 #endif
     AudioOutputI2SNoDAC *i2s_output_;
+
+    int16_t block_[kBlockLen];
+    unsigned int block_len_ = 0;
+    unsigned int block_idx_ = 0;
+};
+
+// Polled Delta-Sigma DAC, runtime-configured
+class DacDS : public DacDSOut<RuntimeDacBase>
+{
+public:
+    DacDS(unsigned int samplerate_Hz, bool looped=true, const void *buffer=nullptr, unsigned int buffer_len=0, unsigned int bits_per_sample=8)
+        : DacDSOut(samplerate_Hz, looped, buffer, buffer_len, bits_per_sample)
+    {
+    }
+};
+
+// Polled Delta-Sigma DAC, compile-time specialized, e.g.
+//      StaticDacDS<int16_t, Looped::Yes> dac(44100, buf, buf_len);
+template<typename TSample, Looped LOOPED>
+class StaticDacDS : public DacDSOut<StaticDacBase<TSample, LOOPED>>
+{
+    typedef DacDSOut<StaticDacBase<TSample, LOOPED>> Super;
+
+public:
+    StaticDacDS(unsigned int samplerate_Hz, const TSample *buffer=nullptr, unsigned int buffer_len=0)
+        : Super(samplerate_Hz, (LOOPED == Looped::Yes), buffer, buffer_len, Super::kBitsPerSample)
+    {
+    }
+};
+
+// Task-driven Delta-Sigma DAC implementation
+// - DacDS output run from a dedicated FreeRTOS task pinned to a chosen core, so slow work in
+// loop() (MQTT, SAM rendering, serial logging) no longer starves audio
+//  - ::Loop() is a no-op
+//  - the task is a plain task rather than a Ticker callback, so ConsumeSample() is safe to call
+// - task writes samples until the I2S DMA buffers are full, then sleeps for a tick while they
+// drain; once a one-shot buffer is done it blocks until ::Restart()
+// - SetBuffer()/Restart() are serialized with the task via a mutex
+// - default: core 1 (same as loop(), away from the WiFi stack on core 0), priority above loop()
+class DacDSTask : public DacDS
+{
+public:
+    DacDSTask(unsigned int samplerate_Hz, bool looped=true, const void *buffer=nullptr, unsigned int buffer_len=0, unsigned int bits_per_sample=8, BaseType_t core=1, UBaseType_t priority=kDefaultPriority)
+        : DacDS(samplerate_Hz, looped, buffer, buffer_len, bits_per_sample)
+    {
+        mutex_ = xSemaphoreCreateMutex();
+        assert(mutex_);
+
+        BaseType_t ret = xTaskCreatePinnedToCore(&DacDSTask::_Task, "DacDS", kTaskStackSize, this, priority, &task_, core);
+        assert( ret == pdPASS );
+    }
+
+    ~DacDSTask()
+    {
+        // task only touches the I2S output while holding the mutex
+        xSemaphoreTake(mutex_, portMAX_DELAY);
+        vTaskDelete(task_);
+        xSemaphoreGive(mutex_);
+        vSemaphoreDelete(mutex_);
+    }
+
+    using DacDS::SetBuffer;
+
+    // IDac Interface overrides begin {
+
+    void SetBuffer(const void *buffer, unsigned int buffer_len, unsigned int bits_per_sample) override
+    {
+        xSemaphoreTake(mutex_, portMAX_DELAY);
+        DacDS::SetBuffer(buffer, buffer_len, bits_per_sample);
+        xSemaphoreGive(mutex_);
+    }
+
+    void Restart() override
+    {
+        xSemaphoreTake(mutex_, portMAX_DELAY);
+        DacDS::Restart();
+        xSemaphoreGive(mutex_);
+        xTaskNotifyGive(task_);
+    }
+
+    // Output is driven by the task
+    void Loop() override
+    {
+        return;
+    }
+
+    // IDac Interface overrides end }
+
+private:
+    static const UBaseType_t kDefaultPriority = 5;  // loop() runs at 1
+    static const uint32_t kTaskStackSize = 2048;
+
+    static void _Task(void *arg)
+    {
+        DacDSTask *dac = (DacDSTask *)arg;
+        while( true )
+        {
+            // write up to a block per lock, so SetBuffer()/Restart() aren't held off for long
+            xSemaphoreTake(dac->mutex_, portMAX_DELAY);
+            unsigned int num_written = 0;
+            while( (num_written < kBlockLen) && dac->_Output() )
+            {
+                num_written++;
+            }
+            bool idle = dac->_IsIdle();
+            xSemaphoreGive(dac->mutex_);
+
+            if( idle )
+            {
+                // wait for ::Restart()
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            }
+            else if( num_written < kBlockLen )
+            {
+                // DMA buffers full, let them drain
+                vTaskDelay(1);
+            }
+        }
+    }
+
+    TaskHandle_t task_ = nullptr;
+    SemaphoreHandle_t mutex_;
+};
+
+// DMA-driven 8-bit DAC implementation
+// - streams to the built-in DAC ("DAC1" or "DAC2") via the I2S0 peripheral in built-in DAC mode
+// - DMA runs from a pair of descriptors (double-buffered), ::Loop() refills whichever are free in
+// blocks via DmaFiller, so CPU cost is a block render every dma_buf_len samples
+// - user needs to call ::Loop() at least once per DMA buffer duration
+//  - e.g. dma_buf_len=512 @ 44.1 kHz => 11.6 ms per buffer, 23 ms of audio queued when full,
+//  enough to ride out serial prints
+// - GetCurrentPos() leads the audible position by up to the queued DMA buffers
+// - uses I2S0, so can't be used at the same time as DacDS
+class DacDMA : public IDac
+{
+public:
+    DacDMA(unsigned int samplerate_Hz, bool looped=true, const void *buffer=nullptr, unsigned int buffer_len=0, unsigned int bits_per_sample=8, uint8_t dac_pin=DAC1, unsigned int dma_buf_len=512)
+        : filler_(*this, sink_)
+    {
+        samplerate_ = samplerate_Hz;
+        looped_ = looped;
+        bits_per_sample_ = bits_per_sample;
+        done_ = true;
+
+        // Verify DAC pin was specified
+        assert( (dac_pin == DAC1) || (dac_pin == DAC2) );
+        assert( (dma_buf_len >= 8) && (dma_buf_len <= 1024) );    // I2S driver limits
+
+        i2s_config_t i2s_config;
+        memset(&i2s_config, 0, sizeof(i2s_config));
+        i2s_config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX | I2S_MODE_DAC_BUILT_IN);
+        i2s_config.sample_rate = samplerate_Hz;
+        i2s_config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+        i2s_config.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
+        i2s_config.communication_format = I2S_COMM_FORMAT_I2S_MSB;
+        i2s_config.intr_alloc_flags = 0;
+        i2s_config.dma_buf_count = 2;
+        i2s_config.dma_buf_len = dma_buf_len;
+        i2s_config.use_apll = false;
+
+        esp_err_t err;
+        err = i2s_driver_install(I2S_NUM_0, &i2s_config, 0, nullptr);
+        assert( err == ESP_OK );
+        err = i2s_set_pin(I2S_NUM_0, nullptr);     // nullptr => built-in DAC
+        assert( err == ESP_OK );
+        // right channel drives DAC1 (GPIO25), left channel drives DAC2 (GPIO26)
+        err = i2s_set_dac_mode( (dac_pin == DAC1) ? I2S_DAC_CHANNEL_RIGHT_EN : I2S_DAC_CHANNEL_LEFT_EN );
+        assert( err == ESP_OK );
+        (void)err;
+
+        if( buffer != nullptr )
+        {
+            assert(buffer_len > 0);
+
+            SetBuffer(buffer, buffer_len, bits_per_sample);
+            Restart();
+        }
+    }
+
+    virtual ~DacDMA()
+    {
+        i2s_set_dac_mode(I2S_DAC_CHANNEL_DISABLE);
+        i2s_driver_uninstall(I2S_NUM_0);
+    }
+
+    // IDac Interface overrides begin {
+
+    // Intended to restart one-shot (ie. non-looped) mode
+    // - drops the audio still queued in the DMA buffers (the previous clip's), so the restart is
+    // heard at once rather than a buffer or two later, & refills straight away
+    //  - the buffers are overwritten with idle frames at the last output level rather than zeroed
+    //  (i2s_zero_dma_buffer()): a zero frame is DAC level 0, the step from & back to mid-scale clicks
+    void Restart() override
+    {
+        done_ = false;
+        buffer_pos_ = 0;
+        i2s_stop(I2S_NUM_0);
+        _FillDmaBuffers(filler_.GetIdleFrame());
+        filler_.Reset();
+        i2s_start(I2S_NUM_0);
+        filler_.Fill();
+    }
+
+    void Loop() override
+    {
+        filler_.Fill();
+    }
+
+    // IDac Interface overrides end }
+
+private:
+    // Set every frame of the driver's DMA buffers, with the DMA stopped
+    // - walks the descriptor ring from the last descriptor the DMA finished (the driver links its
+    // buffers in a circle), as i2s_zero_dma_buffer() does but with any frame value
+    // - nothing to do before the DMA has finished a buffer, the driver's buffers start zeroed but
+    // the first ::Fill() has queued over them by then
+    static void _FillDmaBuffers(uint32_t frame)
+    {
+        lldesc_t *first = (lldesc_t *)(uintptr_t)I2S0.out_eof_des_addr;
+        if( first == nullptr )
+            return;
+        lldesc_t *desc = first;
+        do
+        {
+            uint32_t *frames = (uint32_t *)desc->buf;
+            for( unsigned int i=0; i<desc->length / 4; i++ )
+            {
+                frames[i] = frame;
+            }
+            desc = (lldesc_t *)desc->qe.stqe_next;
+        } while( (desc != nullptr) && (desc != first) );
+    }
+
+    // DmaFiller sink writing into the I2S driver's DMA buffers without blocking
+    struct I2sSink
+    {
+        size_t Write(const void *data, size_t num_bytes)
+        {
+            size_t bytes_written = 0;
+            i2s_write(I2S_NUM_0, data, num_bytes, &bytes_written, 0);
+            return bytes_written;
+        }
+    };
+
+    I2sSink sink_;
+    DmaFiller<IDac, I2sSink> filler_;
 };
+
 // vim: sw=4:ts=4
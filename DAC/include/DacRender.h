@@ -0,0 +1,175 @@
+// Block render helpers shared by the IDac implementations
+// - renders a block of output samples from a PCM data buffer
+// - format conversion, loop wrap-around and end-of-buffer handling are resolved once per run of
+// contiguous samples rather than once per sample
+// - no Arduino dependencies so it can also be built & benchmarked on the host (see DacBench)
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "SampleConvert.h"
+
+// Convert int16_t sample to uint8_t sample
+// - truncating, i.e. (i16_val >> 8) + 128, which is the high byte with its top bit flipped
+// - for blocks, prefer ConvertRun() or SampleConverter (see SampleConvert.h)
+inline uint8_t ConvertSampleTo8Bit(int16_t i16_val)
+{
+    return (uint8_t)(((uint16_t)i16_val >> 8) ^ 0x80);
+}
+
+// Convert uint8_t sample to int16_t sample
+inline int16_t ConvertSampleTo16Bit(uint8_t u8_val)
+{
+    return ((int16_t)u8_val - 128) * 256;
+}
+
+// Identity conversions, so sample types can be handled generically
+inline uint8_t ConvertSampleTo8Bit(uint8_t u8_val)
+{
+    return u8_val;
+}
+
+inline int16_t ConvertSampleTo16Bit(int16_t i16_val)
+{
+    return i16_val;
+}
+
+// Run converters
+// - convert n contiguous samples from src to dst
+inline void ConvertRun(const uint8_t *src, uint8_t *dst, unsigned int n)
+{
+    memcpy(dst, src, n * sizeof(uint8_t));
+}
+
+// - 16 -> 8 bit: truncating, 4 samples per iteration w/ halfword loads & byte stores
+//  - no per-sample branch or call, and unlike ConvertTruncatePacked() no 32-bit loads of the only
+//  2-byte aligned src, which the ESP32 can't do as single word loads
+inline void ConvertRun(const int16_t *src, uint8_t *dst, unsigned int n)
+{
+    const uint16_t *usrc = (const uint16_t *)src;
+    unsigned int i = 0;
+    for( ; i + 4 <= n; i += 4 )
+    {
+        uint16_t s0 = usrc[i];
+        uint16_t s1 = usrc[i + 1];
+        uint16_t s2 = usrc[i + 2];
+        uint16_t s3 = usrc[i + 3];
+        dst[i]     = (uint8_t)(s0 >> 8) ^ 0x80;
+        dst[i + 1] = (uint8_t)(s1 >> 8) ^ 0x80;
+        dst[i + 2] = (uint8_t)(s2 >> 8) ^ 0x80;
+        dst[i + 3] = (uint8_t)(s3 >> 8) ^ 0x80;
+    }
+    for( ; i < n; i++ )
+    {
+        dst[i] = (uint8_t)(usrc[i] >> 8) ^ 0x80;
+    }
+}
+
+inline void ConvertRun(const uint8_t *src, int16_t *dst, unsigned int n)
+{
+    for( unsigned int i=0; i<n; i++ )
+    {
+        dst[i] = ConvertSampleTo16Bit(src[i]);
+    }
+}
+
+inline void ConvertRun(const int16_t *src, int16_t *dst, unsigned int n)
+{
+    memcpy(dst, src, n * sizeof(int16_t));
+}
+
+// Loop mode as a compile-time parameter
+enum class Looped
+{
+    No,
+    Yes
+};
+
+// Compile-time specialized render
+// - render up to num_samples output samples from buffer into out, starting at buffer_pos
+// - buffer_pos is advanced (and wrapped if looped), done is set when a one-shot buffer is exhausted
+// - returns number of samples rendered, which is less than num_samples only when done
+// - sample format conversion & loop handling are resolved at compile time
+template<typename TSample, Looped LOOPED, typename TOut>
+unsigned int RenderBlockT(const TSample *buffer, unsigned int buffer_len,
+        unsigned int &buffer_pos, bool &done, TOut *out, unsigned int num_samples)
+{
+    if( buffer_len == 0 )
+    {
+        done = true;
+    }
+
+    unsigned int rendered = 0;
+    while( (rendered < num_samples) && !done )
+    {
+        // largest contiguous run we can render before needing to wrap or stop
+        unsigned int run = buffer_len - buffer_pos;
+        if( run > num_samples - rendered )
+            run = num_samples - rendered;
+
+        ConvertRun(buffer + buffer_pos, out + rendered, run);
+        rendered += run;
+        buffer_pos += run;
+
+        if( buffer_pos >= buffer_len )
+        {
+            if( LOOPED == Looped::Yes )
+            {
+                buffer_pos = 0;
+            }
+            else
+            {
+                done = true;
+            }
+        }
+    }
+    return rendered;
+}
+
+// Compile-time specialized single sample fetch
+// - returns the sample at buffer_pos, then advances buffer_pos (and wraps if looped), done is set
+// when a one-shot buffer is exhausted
+// - caller must not call once done
+template<typename TSample, Looped LOOPED>
+inline TSample NextSample(const TSample *buffer, unsigned int buffer_len, unsigned int &buffer_pos, bool &done)
+{
+    TSample sample = buffer[buffer_pos];
+    buffer_pos++;
+    if( buffer_pos >= buffer_len )
+    {
+        if( LOOPED == Looped::Yes )
+        {
+            buffer_pos = 0;
+        }
+        else
+        {
+            done = true;
+        }
+    }
+    return sample;
+}
+
+// Runtime-configured render
+// - as per RenderBlockT(), dispatching on bits_per_sample & looped once per block
+template<typename TOut>
+unsigned int RenderBlock(const void *buffer, unsigned int buffer_len, unsigned int bits_per_sample, bool looped,
+        unsigned int &buffer_pos, bool &done, TOut *out, unsigned int num_samples)
+{
+    if( bits_per_sample == 8 )
+    {
+        const uint8_t *buf = (const uint8_t *)buffer;
+        if( looped )
+            return RenderBlockT<uint8_t, Looped::Yes>(buf, buffer_len, buffer_pos, done, out, num_samples);
+        return RenderBlockT<uint8_t, Looped::No>(buf, buffer_len, buffer_pos, done, out, num_samples);
+    }
+
+    assert( bits_per_sample == 16 );
+    const int16_t *buf = (const int16_t *)buffer;
+    if( looped )
+        return RenderBlockT<int16_t, Looped::Yes>(buf, buffer_len, buffer_pos, done, out, num_samples);
+    return RenderBlockT<int16_t, Looped::No>(buf, buffer_len, buffer_pos, done, out, num_samples);
+}
+
+// vim: sw=4:ts=4
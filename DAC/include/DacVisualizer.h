@@ -3,9 +3,31 @@
 // - visualizes the audio data playing thru a DAC instance
 // - queries the DAC instance to get current play position, calculates a level from a window of
 // samples around the play position
+//  - window & overlap configurable via ::SetWindow(), default 50 ms, 50% overlap
+//  - the window's extrema are tracked incrementally (see SlidingExtrema.h): samples are fed ahead of
+//  the play position, at most kMaxFeedPerLoop per ::Loop(), each sample once, so the cost per
+//  ::Loop() is bounded & small however long the window
+//  - if ::Loop() runs too slowly for that (under about samplerate / kMaxFeedPerLoop), intervals the
+//  play position has already passed are skipped, so the display drops updates rather than lagging
+//  playback
+//  - or, given the clip's precomputed envelope track (see Envelope.h), reads the level from one
+//  byte per interval
+// - or, in VU mode (::SetMode()), an RMS level over the same windows, from a running sum of squares
+// (see VuMeter.h) fed as above, with attack/release ballistics & a dB-scaled bar
+//  - each level step is kVuRange_dB / 5, level 1 at -kVuRange_dB dBFS
+//  - given an envelope track, uses its RMS nibble instead
+// - or, in spectrum mode, a kSpectrumFftLen-point fixed-point FFT (see FixedFft.h) of
+// the samples at the play position each interval, one LED per log-spaced band
+//  - the FFT runs a stage per ::Loop(), so no single ::Loop() holds up a polled DAC for long
+//  - a band lights when its power is within kSpectrumRange_dB of the loudest band, & above a floor
 // - currently configured to output 6 levels [0, 5], intended to drive a 10-element LED bar display
 // symmetrically
 // - drives outputs HIGH to light up output LEDs
+//  - all LED pins in one write-1-to-set & one write-1-to-clear register store (see GpioOut.h), with
+//  the masks per bar level precomputed
+//  - or, with ::SetOutput(VisualizerOutput::Pwm), through LEDC PWM channels (see LedcOut.h): levels
+//  are computed in 1/256 steps & the bar's top LED shows the fraction as brightness, LEDs going
+//  down fade in hardware over most of an interval
 //  - (ESP32 has higher current source capabilities than sink)
 //  - see: https://www.esp32.com/viewtopic.php?t=5840#p71756
 
@@ -38,24 +60,55 @@
 
 #include "../../SerialLog/include/SerialLog.h"
 #include "../../Ticker/include/Ticker.h"
+#include "../../GpioOut/include/GpioOut.h"
+#include "../../GpioOut/include/LedcOut.h"
 #include "Dac.h"
+#include "Envelope.h"
+#include "FixedFft.h"
+#include "SlidingExtrema.h"
+#include "VuMeter.h"
 #include <assert.h>
 #include <Arduino.h>
 
 // Helpers
 
+enum class VisualizerMode
+{
+    Level,          // level bar, window peak
+    Vu,             // level bar, window RMS with ballistics
+    Spectrum,       // a band per LED
+};
+
+enum class VisualizerOutput
+{
+    Gpio,           // LEDs on/off
+    Pwm,            // LEDs dimmed by LEDC
+};
+
 //
 class DacVisualizer
 {
 public:
-#   define WINDOW_DURATION_S (0.05)
-#   define WINDOW_OVERLAP_FRACTION (0.5)
+    static constexpr float kDefaultWindowDuration_s = 0.05f;
+    static constexpr float kDefaultWindowOverlapFraction = 0.5f;
+    static const unsigned int kMaxFeedPerLoop = 16;     // samples
+    static const unsigned int kVuRange_dB = 30;
+    static constexpr float kVuAttack_s = 0.01f;
+    static constexpr float kVuRelease_s = 0.3f;
+    static const unsigned int kSpectrumFftLen = 128;
+    static constexpr float kSpectrumMinFreq_Hz = 100.0f;
+    static constexpr float kSpectrumMaxFreq_Hz = 8000.0f;
+    static const unsigned int kSpectrumRange_dB = 12;
+    // band power floor, ~-40 dB re a full-scale sine in one band (FFT bins are scaled by 1/2N)
+    static const uint32_t kSpectrumFloor = 1u << 11;
+    static const unsigned int kPwmFirstChannel = 0;     // LEDC channels kPwmFirstChannel..+4
 
     DacVisualizer()
     {
-        for(int i=1; i<m_num_levels; i++)
+        leds_.Init(m_output_pins + 1, m_num_levels - 1);
+        for(int i=0; i<m_num_levels; i++)
         {
-            pinMode(m_output_pins[i], OUTPUT);
+            leds_.GetMasks((1u << i) - 1, m_level_set_masks[i], m_level_clear_masks[i]);
         }
         _Visualize(0);
     }
@@ -67,15 +120,72 @@ public:
         dac_instance_ = dac_instance;
     }
 
-    void Reset(IDac *dac_instance)
+    // Takes effect from the next ::Reset()
+    // - overlap_fraction in [0, 1)
+    void SetWindow(float duration_s, float overlap_fraction)
+    {
+        assert( duration_s > 0.0f );
+        assert( (overlap_fraction >= 0.0f) && (overlap_fraction < 1.0f) );
+        window_duration_s_ = duration_s;
+        window_overlap_fraction_ = overlap_fraction;
+    }
+
+    // Takes effect from the next ::Reset()
+    void SetMode(VisualizerMode mode)
+    {
+        mode_ = mode;
+    }
+
+    // Immediate, all LEDs off
+    void SetOutput(VisualizerOutput output)
+    {
+        if( output == output_ )
+            return;
+        output_ = output;
+        if( output_ == VisualizerOutput::Pwm )
+        {
+            if( !pwm_.Init(m_output_pins + 1, m_num_levels - 1, kPwmFirstChannel) )
+            {
+                SerialLog::Log("DacVisualizer: LEDC setup failed, staying on GPIO output");
+                output_ = VisualizerOutput::Gpio;
+                leds_.Init(m_output_pins + 1, m_num_levels - 1);
+            }
+        }
+        else
+        {
+            pwm_.Detach();
+            leds_.Init(m_output_pins + 1, m_num_levels - 1);
+        }
+        _VisualizeQ8(0);
+    }
+
+    // envelope: the playing clip's envelope track, if it has one
+    // - not used by VisualizerMode::Spectrum
+    void Reset(IDac *dac_instance, const EnvelopeTrack *envelope=nullptr)
     {
         assert( dac_instance != nullptr );
         dac_instance_ = dac_instance;
         is_active_ = false;
 
-        window_duration_ = (unsigned int) (WINDOW_DURATION_S * dac_instance_->GetSamplerate());
-        window_overlap_  = (unsigned int) (WINDOW_OVERLAP_FRACTION * window_duration_);
+        window_duration_ = (unsigned int) (window_duration_s_ * dac_instance_->GetSamplerate());
+        if( window_duration_ == 0 )
+            window_duration_ = 1;
+        window_overlap_  = (unsigned int) (window_overlap_fraction_ * window_duration_);
         window_interval_ = window_duration_ - window_overlap_;
+        extrema_.Reset(window_duration_);
+        fed_pos_ = 0;
+        fed_base_ = 0;
+        skipped_ = false;
+
+        // a track built for another samplerate doesn't line up with the intervals, scan instead
+        envelope_ = nullptr;
+        if( (envelope != nullptr) && envelope->IsValid() )
+        {
+            if( (envelope->GetHopLen() == window_interval_) && (envelope->GetWindowLen() == window_duration_) )
+                envelope_ = envelope;
+            else
+                SerialLog::Log("DacVisualizer: envelope track doesn't match the DAC samplerate, ignored");
+        }
 
         m_buffer_len = dac_instance_->GetDataBufferLen();
 
@@ -93,9 +203,24 @@ public:
         }
         assert( m_num_levels > 0 );
         m_iscale = (max_amp / m_num_levels) + (max_amp % m_num_levels != 0);    // ceil (max_amp/#levels)
+        m_vu_scale = 32768 / max_amp;   // to 16-bit scale
+
+        // fades done before the next interval's update
+        m_pwm_fade_ms = (unsigned int)(750ull * window_interval_ / dac_instance_->GetSamplerate());
 
         m_interval_index = 0;
         _UpdateIntervalRange();
+
+        vu_mode_ = (mode_ == VisualizerMode::Vu);
+        if( vu_mode_ )
+        {
+            rms_.Reset(window_duration_);
+            ballistics_.Reset(kVuAttack_s, kVuRelease_s, (float)window_interval_ / dac_instance_->GetSamplerate());
+        }
+        spectrum_mode_ = (mode_ == VisualizerMode::Spectrum);
+        fft_pending_ = false;
+        if( spectrum_mode_ )
+            _SetBandEdges(dac_instance_->GetSamplerate());
     }
 
     ~DacVisualizer() {}
@@ -105,13 +230,17 @@ public:
         if( dac_instance_ )
         {
             unsigned int cur_sample_pos = dac_instance_->GetCurrentPos();
-            if( cur_sample_pos < m_buffer_len )
+            if( spectrum_mode_ )
+                _SpectrumLoop(cur_sample_pos);
+            else if( cur_sample_pos < m_buffer_len )
             {
-                if( (int)cur_sample_pos >= m_interval_progress_point )
+                _SkipMissedIntervals(cur_sample_pos);
+                bool is_fed = (envelope_ != nullptr) || _Feed();
+                if( ((int)cur_sample_pos >= m_interval_progress_point) && is_fed )
                 {
-                    unsigned int value = _CalcValue();
-                    _Visualize(value);
-                    //_DebugVisualize(value);
+                    unsigned int value_q8 = vu_mode_ ? _VuValueQ8() : envelope_ ? _EnvelopeValueQ8() : _CalcValueQ8();
+                    _VisualizeQ8(value_q8);
+                    //_DebugVisualize(value_q8 >> 8);
                     _IncrementInterval();
                     is_active_ = true;
                 }
@@ -120,7 +249,7 @@ public:
             {
                 if( is_active_ )
                 {
-                    _Visualize(0);
+                    _VisualizeQ8(0);
                     is_active_ = false;
                 }
             }
@@ -148,86 +277,248 @@ private:
     void _IncrementInterval()
     {
         m_interval_index++;
+        skipped_ = false;
         _UpdateIntervalRange();
     }
 
-    void _FindExtrema(unsigned int start_idx, unsigned int end_idx, int & max_val, int & min_val)
+    // Skip the intervals the play position has passed, if any
+    // - jumps to the latest interval whose window has started
+    // - the tracker keeps sliding if the new window starts within what's already fed, otherwise it's
+    // reset & fed from the new window's start
+    // - the interval jumped to is shown once fed, even if the play position has passed it by then,
+    // so a very slow ::Loop() still updates the display (late by at most one window's feed) rather
+    // than skipping every interval
+    void _SkipMissedIntervals(unsigned int cur_sample_pos)
     {
-        assert( start_idx >= 0 );
-        assert( start_idx < end_idx );
-        assert( end_idx <= m_buffer_len );
-
-        int min_so_far = 100000;
-        int max_so_far = -100000;
+        if( skipped_ || (cur_sample_pos < m_interval_end) )
+            return;
+        m_interval_index = (cur_sample_pos + window_duration_) / window_interval_ - 1;
+        _UpdateIntervalRange();
+        skipped_ = true;
+        if( (envelope_ == nullptr) && (m_interval_start > (int)fed_pos_) )
+        {
+            fed_pos_ = m_interval_start;
+            fed_base_ = fed_pos_;
+            extrema_.Reset(window_duration_);
+            if( vu_mode_ )
+                rms_.Reset(window_duration_);
+        }
+    }
 
+    // Feed samples up to the current interval's end into the extrema tracker (or the RMS sum in VU
+    // mode), at most kMaxFeedPerLoop
+    // - past the end of the buffer, feeds silence, which doesn't change the level
+    // - returns true once the current interval is all fed
+    bool _Feed()
+    {
         if( dac_instance_->GetBitsPerSample() == 8 )
+            _FeedSamples(reinterpret_cast<const uint8_t*>(dac_instance_->GetDataBuffer()));
+        else
+            _FeedSamples(reinterpret_cast<const int16_t*>(dac_instance_->GetDataBuffer()));
+        return fed_pos_ >= m_interval_end;
+    }
+
+    template<typename TSample>
+    void _FeedSamples(const TSample *p)
+    {
+        unsigned int target = m_interval_end;
+        unsigned int n = kMaxFeedPerLoop;
+        int dc_ofs = m_dc_ofs;
+        if( vu_mode_ )
         {
-            const uint8_t * p8 = reinterpret_cast<const uint8_t*>(dac_instance_->GetDataBuffer());
-            for( auto i=start_idx; i<end_idx; i++ )
+            // the sample leaving the window is still in the buffer, no history needed
+            for( ; (fed_pos_ < target) && (n > 0); fed_pos_++, n-- )
             {
-                if( p8[i] > max_so_far )
-                    max_so_far = p8[i];
-                if( p8[i] < min_so_far )
-                    min_so_far = p8[i];
+                unsigned int out_pos = fed_pos_ - window_duration_;
+                int val = (fed_pos_ < m_buffer_len) ? p[fed_pos_] - dc_ofs : 0;
+                int out_val = ((fed_pos_ >= fed_base_ + window_duration_) && (out_pos < m_buffer_len)) ? p[out_pos] - dc_ofs : 0;
+                rms_.Push(val * m_vu_scale, out_val * m_vu_scale);
             }
         }
         else
         {
-            assert( dac_instance_->GetBitsPerSample() == 16 );
-            const int16_t * p16 = reinterpret_cast<const int16_t*>(dac_instance_->GetDataBuffer()); 
-            for( auto i=start_idx; i<end_idx; i++ )
-            {
-                if( p16[i] > max_so_far )
-                    max_so_far = p16[i];
-                if( p16[i] < min_so_far )
-                    min_so_far = p16[i];
-            }
+            for( ; (fed_pos_ < target) && (n > 0); fed_pos_++, n-- )
+                extrema_.Push( (fed_pos_ < m_buffer_len) ? p[fed_pos_] : dc_ofs );
         }
-        max_val = max_so_far;
-        min_val = min_so_far;
     }
 
-    unsigned int _CalcValue()
+    // Bar level, in 1/256 levels
+    unsigned int _CalcValueQ8()
     {
         unsigned int ret_val = 0;
 
-        unsigned int start_idx = max( 0, m_interval_start );
-        unsigned int end_idx   = min( m_buffer_len, m_interval_end );
-
-        if( end_idx <= start_idx )
-        {
-            // this is possible with progress_point of "start"
-            // e.g. for "gameOverMan.wav"
-            return ret_val;
-        }
-        //SerialLog::Log( "Interval idxs:" + String(start_idx) + ", " + String(end_idx) );
-
-        int max_val;
-        int min_val;
-        _FindExtrema(start_idx, end_idx, max_val, min_val);
-        max_val -= m_dc_ofs;
-        min_val -= m_dc_ofs;
+        // the tracker holds the window ending at m_interval_end, incl. any silence past the buffer,
+        // so an interval starting past the end (possible with progress_point of "start", e.g. for
+        // "gameOverMan.wav") reads as 0
+        int max_val = extrema_.GetMax() - (int)m_dc_ofs;
+        int min_val = extrema_.GetMin() - (int)m_dc_ofs;
         int max_amp = max(max_val, abs(min_val));
         assert( max_amp >= 0 );
-        ret_val = max_amp / m_iscale;
+        ret_val = (unsigned int)max_amp * 256 / m_iscale;
         assert( ret_val >= 0 );
-        assert( ret_val < m_num_levels );
+        assert( ret_val < m_num_levels * 256 );
 
         return ret_val;
     }
 
-    void _Visualize(unsigned int value)
+    // Same scale as _CalcValueQ8(), from the interval's peak nibble
+    unsigned int _EnvelopeValueQ8()
     {
-        assert( value < m_num_levels );
-        int i=1;
-        for(; i<=value; i++)
+        unsigned int ret_val = envelope_->GetPeak(m_interval_index) * m_num_levels * 256 / 16;
+        assert( ret_val < m_num_levels * 256 );
+        return ret_val;
+    }
+
+    // Bar level from the interval's RMS, after ballistics, in 1/256 levels
+    unsigned int _VuValueQ8()
+    {
+        int32_t db_q8;
+        if( envelope_ )
         {
-            digitalWrite(m_output_pins[i], HIGH);
+            // nibble n covers [3(n-16), 3(n-15)) dBFS, take the middle; 0 is below -45 dBFS
+            unsigned int rms = envelope_->GetRms(m_interval_index);
+            db_q8 = (rms == 0) ? kVuMinDbQ8 : ((int32_t)rms * 3 - 48) * 256 + 384;
         }
-        for(; i<m_num_levels; i++)
+        else
+            db_q8 = rms_.GetDbQ8();
+        unsigned int ret_val = VuLevelQ8(ballistics_.Update(db_q8), m_num_levels, kVuRange_dB);
+        assert( ret_val < m_num_levels * 256 );
+        return ret_val;
+    }
+
+    // Lowest bin of each band, & one past the last band's highest
+    // - log-spaced from kSpectrumMinFreq_Hz to kSpectrumMaxFreq_Hz (or Nyquist), at least a bin
+    // each, skipping DC
+    void _SetBandEdges(unsigned int samplerate)
+    {
+        const unsigned int kNumBands = m_num_levels - 1;
+        const unsigned int kMaxBin = kSpectrumFftLen / 2;
+        float bin_hz = (float)samplerate / kSpectrumFftLen;
+        float lo = max(kSpectrumMinFreq_Hz / bin_hz, 1.0f);
+        float hi = min(kSpectrumMaxFreq_Hz / bin_hz, (float)kMaxBin);
+        if( hi < lo * 2.0f )
+            hi = min(lo * 2.0f, (float)kMaxBin);
+        for( unsigned int b=0; b<=kNumBands; b++ )
+        {
+            unsigned int edge = (unsigned int)(lo * powf(hi / lo, (float)b / kNumBands) + 0.5f);
+            unsigned int min_edge = (b == 0) ? 1 : band_edges_[b-1] + 1;
+            unsigned int max_edge = kMaxBin + 1 - (kNumBands - b);
+            band_edges_[b] = (uint8_t)min(max(edge, min_edge), max_edge);
+        }
+    }
+
+    // Spectrum mode ::Loop()
+    // - when an interval is due, loads the FFT with the samples from the play position on (silence
+    // past the end), then a stage per call, then lights the bands
+    void _SpectrumLoop(unsigned int cur_sample_pos)
+    {
+        if( fft_pending_ )
+        {
+            if( fft_.Step() )
+            {
+                _VisualizeMask(_CalcBands());
+                fft_pending_ = false;
+            }
+            return;
+        }
+
+        if( cur_sample_pos >= m_buffer_len )
+        {
+            if( is_active_ )
+            {
+                _VisualizeQ8(0);
+                is_active_ = false;
+            }
+            return;
+        }
+        if( (int)cur_sample_pos < m_interval_progress_point )
+            return;
+
+        int16_t *in = fft_.GetInput();
+        unsigned int n = m_buffer_len - cur_sample_pos;
+        if( n > kSpectrumFftLen )
+            n = kSpectrumFftLen;
+        if( dac_instance_->GetBitsPerSample() == 8 )
+        {
+            const uint8_t * p8 = reinterpret_cast<const uint8_t*>(dac_instance_->GetDataBuffer()) + cur_sample_pos;
+            for( unsigned int i=0; i<n; i++ )
+                in[i] = (int16_t)(((int)p8[i] - 128) << 8);
+        }
+        else
+        {
+            const int16_t * p16 = reinterpret_cast<const int16_t*>(dac_instance_->GetDataBuffer()) + cur_sample_pos;
+            for( unsigned int i=0; i<n; i++ )
+                in[i] = p16[i];
+        }
+        for( unsigned int i=n; i<kSpectrumFftLen; i++ )
+            in[i] = 0;
+        fft_.Start();
+        fft_pending_ = true;
+        is_active_ = true;
+
+        // skip intervals missed while the FFT was busy
+        while( (int)cur_sample_pos >= m_interval_progress_point )
+            _IncrementInterval();
+    }
+
+    // Bit b set: band b lit
+    uint8_t _CalcBands() const
+    {
+        const unsigned int kNumBands = m_num_levels - 1;
+        uint32_t power[kNumBands];
+        uint32_t loudest = 0;
+        for( unsigned int b=0; b<kNumBands; b++ )
+        {
+            power[b] = 0;
+            for( unsigned int k=band_edges_[b]; k<band_edges_[b+1]; k++ )
+            {
+                uint32_t p = fft_.GetPower(k);
+                power[b] = (power[b] + p >= power[b]) ? power[b] + p : UINT32_MAX;
+            }
+            loudest = max(loudest, power[b]);
+        }
+        uint32_t threshold = loudest >> (kSpectrumRange_dB / 3);
+        if( threshold < kSpectrumFloor )
+            threshold = kSpectrumFloor;
+        uint8_t mask = 0;
+        for( unsigned int b=0; b<kNumBands; b++ )
+        {
+            if( power[b] >= threshold )
+                mask |= 1 << b;
+        }
+        return mask;
+    }
+
+    void _VisualizeMask(uint8_t mask)
+    {
+        if( output_ == VisualizerOutput::Pwm )
+        {
+            uint32_t duties[m_num_levels - 1];
+            for( unsigned int i=0; i<m_num_levels - 1; i++ )
+                duties[i] = (mask & (1 << i)) ? kLedcMaxDuty : 0;
+            pwm_.Write(duties, m_pwm_fade_ms);
+        }
+        else
+            leds_.Write(mask);
+    }
+
+    // Level bar, in 1/256 levels: whole levels on the GPIO output, the fraction too on PWM
+    void _VisualizeQ8(unsigned int value_q8)
+    {
+        if( output_ == VisualizerOutput::Pwm )
         {
-            digitalWrite(m_output_pins[i], LOW);
+            uint32_t duties[m_num_levels - 1];
+            LedcBarDuties(value_q8, m_num_levels - 1, duties);
+            pwm_.Write(duties, m_pwm_fade_ms);
         }
+        else
+            _Visualize(value_q8 >> 8);
+    }
+
+    void _Visualize(unsigned int value)
+    {
+        assert( value < m_num_levels );
+        GpioGroup::WriteMasks(m_level_set_masks[value], m_level_clear_masks[value]);
     }
 
     void _DebugVisualize(unsigned int value)
@@ -254,9 +545,18 @@ private:
 
 private:
     IDac *dac_instance_ = nullptr;
+    const EnvelopeTrack *envelope_ = nullptr;
     static const unsigned int m_num_levels = 6;
     uint8_t m_output_pins[m_num_levels] = {0xff, 16, 17, 18, 19, 21};
-
+    GpioGroup leds_;                            // m_output_pins[1..]
+    uint32_t m_level_set_masks[m_num_levels];   // per level, see GpioGroup::WriteMasks()
+    uint32_t m_level_clear_masks[m_num_levels];
+    VisualizerOutput output_ = VisualizerOutput::Gpio;
+    LedcGroup pwm_;
+    unsigned int m_pwm_fade_ms = 0;
+
+    float window_duration_s_ = kDefaultWindowDuration_s;
+    float window_overlap_fraction_ = kDefaultWindowOverlapFraction;
     unsigned int window_duration_;  // in samples
     unsigned int window_overlap_;   // in samples
     unsigned int window_interval_;  // in samples
@@ -271,6 +571,21 @@ private:
     int m_interval_start;
     int m_interval_progress_point;
 
+    SlidingExtrema extrema_;
+    unsigned int fed_pos_ = 0;      // next sample to feed
+    unsigned int fed_base_ = 0;     // first sample fed since the tracker was last reset
+    bool skipped_ = false;          // jumped to the current interval, show it before skipping again
+
+    VisualizerMode mode_ = VisualizerMode::Level;
+    bool vu_mode_ = false;
+    SlidingRms rms_;
+    VuBallistics ballistics_;
+    int m_vu_scale = 1;
+    bool spectrum_mode_ = false;
+    RealFft<kSpectrumFftLen> fft_;
+    bool fft_pending_ = false;      // stages to go
+    uint8_t band_edges_[m_num_levels];  // in bins, see _SetBandEdges()
+
     bool is_active_ = false;
 };
 
@@ -0,0 +1,106 @@
+// DMA fill logic for DacDMA
+// - renders blocks of 8-bit samples from a source and packs them as I2S frames for the built-in DAC
+//  - the built-in DAC takes the high byte of each 16-bit I2S slot, and the sample goes into both
+//  slots of the stereo frame so it plays on whichever DAC channel is enabled
+// - writes to the sink may be partial (DMA buffers full), the unwritten remainder is kept and
+// retried on the next ::Fill()
+// - once the source is done, the last sample value is repeated to keep the DMA fed without popping
+// - templated on source & sink so it can be exercised on the host against a fake DMA sink
+//  - TSource: unsigned int Render(uint8_t *out, unsigned int num_samples), e.g. IDac
+//  - TSink:   size_t Write(const void *data, size_t num_bytes), returns num bytes accepted
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+template<typename TSource, typename TSink, unsigned int BLOCK_LEN=256>
+class DmaFiller
+{
+public:
+    static const unsigned int kBlockLen = BLOCK_LEN;   // in samples/frames
+    static const unsigned int kBytesPerFrame = 4;       // 2 slots x 16 bits
+
+    DmaFiller(TSource & source, TSink & sink)
+        : source_(source)
+        , sink_(sink)
+    {
+        Reset();
+    }
+
+    // Discard any rendered but not yet written frames
+    void Reset()
+    {
+        pending_bytes_ = 0;
+        pending_ofs_ = 0;
+    }
+
+    // Write as much as the sink will accept
+    // - returns number of bytes written
+    size_t Fill()
+    {
+        size_t total_written = 0;
+        while( true )
+        {
+            if( pending_ofs_ >= pending_bytes_ )
+            {
+                _RenderFrames();
+            }
+
+            size_t num_bytes = pending_bytes_ - pending_ofs_;
+            size_t written = sink_.Write((const uint8_t *)frames_ + pending_ofs_, num_bytes);
+            pending_ofs_ += written;
+            total_written += written;
+            if( written < num_bytes )
+            {
+                // sink is full
+                break;
+            }
+        }
+        return total_written;
+    }
+
+    // Frame repeated once the source is done: the last sample value (mid-scale before any)
+    // - e.g. to overwrite queued DMA buffers on a restart, rather than zeroing them, which the
+    // built-in DAC (unsigned, 0x80 mid-scale) would play as level 0
+    uint32_t GetIdleFrame() const
+    {
+        return ((uint32_t)last_sample_ << 24) | ((uint32_t)last_sample_ << 8);
+    }
+
+private:
+    void _RenderFrames()
+    {
+        uint8_t samples[kBlockLen];
+        unsigned int num_samples = source_.Render(samples, kBlockLen);
+        if( num_samples > 0 )
+        {
+            last_sample_ = samples[num_samples - 1];
+        }
+
+        for( unsigned int i=0; i<num_samples; i++ )
+        {
+            frames_[i] = ((uint32_t)samples[i] << 24) | ((uint32_t)samples[i] << 8);
+        }
+        // source done (or short), pad with the last sample value
+        uint32_t idle_frame = GetIdleFrame();
+        for( unsigned int i=num_samples; i<kBlockLen; i++ )
+        {
+            frames_[i] = idle_frame;
+        }
+
+        pending_bytes_ = kBlockLen * kBytesPerFrame;
+        pending_ofs_ = 0;
+    }
+
+    TSource & source_;
+    TSink & sink_;
+
+    uint32_t frames_[kBlockLen];
+    size_t pending_bytes_;
+    size_t pending_ofs_;
+    uint8_t last_sample_ = 0x80;    // mid-scale
+};
+
+// vim: sw=4:ts=4
@@ -0,0 +1,174 @@
+// Precomputed clip envelope tracks
+// - one byte per hop of a static clip: peak level (high nibble) & RMS level (low nibble), so a
+// visualizer reads a byte per interval instead of scanning a window of samples (see DacVisualizer)
+//  - peak: linear, in 16ths of full scale (15 == 15/16 or more)
+//  - RMS: in 3 dB steps, 15 == -3 dBFS or more, 0 == below -45 dBFS
+// - frame i covers the window_len samples ending at (i + 1) * hop_len, clipped to the clip, the same
+// windows DacVisualizer uses (50 ms, 50% overlap)
+// - track data, little-endian:
+//      uint16_t hop_len                in samples
+//      uint16_t window_len             in samples
+//      uint32_t num_frames
+//      uint8_t frames[num_frames]
+// - built by AssetTool build (envelope option), stored next to the clip: <name>.env.dat or a
+// <name>.env bank entry (ClipCodec::Envelope)
+// - EnvelopeBuild() is for host tools & tests
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <vector>
+
+static const unsigned int kEnvelopeHeaderLen = 8;
+
+// Hop & window for a samplerate, as DacVisualizer computes its intervals
+inline unsigned int EnvelopeWindowLen(unsigned int samplerate)
+{
+    return (unsigned int)(0.05 * samplerate);
+}
+
+inline unsigned int EnvelopeHopLen(unsigned int samplerate)
+{
+    unsigned int window_len = EnvelopeWindowLen(samplerate);
+    return window_len - (unsigned int)(0.5 * window_len);
+}
+
+class EnvelopeTrack
+{
+public:
+    EnvelopeTrack(const uint8_t *data=nullptr, uint32_t num_bytes=0)
+    {
+        SetData(data, num_bytes);
+    }
+
+    // Track data as above
+    // - returns false (& the track reads as empty) if it's truncated
+    bool SetData(const uint8_t *data, uint32_t num_bytes)
+    {
+        frames_ = nullptr;
+        num_frames_ = 0;
+        hop_len_ = 0;
+        window_len_ = 0;
+        if( (data == nullptr) || (num_bytes < kEnvelopeHeaderLen) )
+            return false;
+        uint32_t num_frames = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t)data[7] << 24);
+        if( num_frames > num_bytes - kEnvelopeHeaderLen )
+            return false;
+        hop_len_ = data[0] | (data[1] << 8);
+        window_len_ = data[2] | (data[3] << 8);
+        frames_ = data + kEnvelopeHeaderLen;
+        num_frames_ = num_frames;
+        return true;
+    }
+
+    bool IsValid() const
+    {
+        return frames_ != nullptr;
+    }
+
+    unsigned int GetHopLen() const
+    {
+        return hop_len_;
+    }
+
+    unsigned int GetWindowLen() const
+    {
+        return window_len_;
+    }
+
+    uint32_t GetNumFrames() const
+    {
+        return num_frames_;
+    }
+
+    // Frames past the end read as silent
+    uint8_t GetFrame(uint32_t idx) const
+    {
+        return (idx < num_frames_) ? frames_[idx] : 0;
+    }
+
+    // [0, 15]
+    unsigned int GetPeak(uint32_t idx) const
+    {
+        return GetFrame(idx) >> 4;
+    }
+
+    // [0, 15]
+    unsigned int GetRms(uint32_t idx) const
+    {
+        return GetFrame(idx) & 0x0f;
+    }
+
+private:
+    const uint8_t *frames_;
+    uint32_t num_frames_;
+    unsigned int hop_len_;
+    unsigned int window_len_;
+};
+
+//-----------------------------------
+// Builder
+
+inline uint8_t EnvelopeFrame(int peak_amp, double rms_amp)
+{
+    int peak = peak_amp * 16 / 32768;
+    if( peak > 15 )
+        peak = 15;
+    int rms = 0;
+    if( rms_amp > 0.0 )
+    {
+        rms = 16 + (int)floor(20.0 * log10(rms_amp / 32768.0) / 3.0);
+        rms = (rms < 0) ? 0 : (rms > 15) ? 15 : rms;
+    }
+    return (uint8_t)((peak << 4) | rms);
+}
+
+// Build the track for 8-bit unsigned or 16-bit signed PCM
+inline std::vector<uint8_t> EnvelopeBuild(const void *data, uint32_t num_samples, unsigned int bits_per_sample,
+        unsigned int hop_len, unsigned int window_len)
+{
+    assert( (bits_per_sample == 8) || (bits_per_sample == 16) );
+    assert( (hop_len > 0) && (hop_len <= 0xffff) && (window_len <= 0xffff) );
+    auto sample = [&](uint32_t idx) {
+        if( bits_per_sample == 8 )
+            return ((int)((const uint8_t *)data)[idx] - 128) * 256;
+        int16_t val;
+        memcpy(&val, (const uint8_t *)data + idx * 2, sizeof(val));
+        return (int)val;
+    };
+
+    // frames until the window start passes the end of the clip, as the visualizer's intervals
+    std::vector<uint8_t> frames;
+    for( uint64_t end=hop_len; end<(uint64_t)num_samples + window_len; end+=hop_len )
+    {
+        uint32_t start = (end > window_len) ? (uint32_t)(end - window_len) : 0;
+        uint32_t stop = (end < num_samples) ? (uint32_t)end : num_samples;
+        int peak = 0;
+        double sum_sq = 0.0;
+        for( uint32_t i=start; i<stop; i++ )
+        {
+            int val = sample(i);
+            int amp = (val < 0) ? -val : val;
+            peak = (amp > peak) ? amp : peak;
+            sum_sq += (double)val * val;
+        }
+        frames.push_back((stop > start) ? EnvelopeFrame(peak, sqrt(sum_sq / (stop - start))) : 0);
+    }
+
+    std::vector<uint8_t> track;
+    track.push_back((uint8_t)(hop_len & 0xff));
+    track.push_back((uint8_t)(hop_len >> 8));
+    track.push_back((uint8_t)(window_len & 0xff));
+    track.push_back((uint8_t)(window_len >> 8));
+    uint32_t num_frames = frames.size();
+    for( int i=0; i<4; i++ )
+        track.push_back((uint8_t)(num_frames >> (8 * i)));
+    track.insert(track.end(), frames.begin(), frames.end());
+    return track;
+}
+
+// vim: sw=4:ts=4
@@ -0,0 +1,181 @@
+// Fixed-point real FFT
+// - N-point real FFT (N a power of two, 16..1024) as an N/2-point complex radix-2 DIT FFT plus the
+// real-input split, Q15 throughout, 32-bit intermediates
+// - in place, no heap: the N input samples are the N/2 complex points (even samples real, odd
+// imaginary), so the one buffer holds input, work & result
+// - twiddles & the Hann window are Q15 tables built once by the constructor (floating point, not
+// in the sample path)
+// - the window has a peak of 1/2, so complex points stay within int16 whatever their phase, & each
+// stage scales by 1/2: bins come out as X[k] / 2N (X of the Hann-windowed input), nothing overflows
+// - can run all at once (::Compute()), or a stage per call (::Start(), then ::Step() until it
+// returns true) to spread the work, e.g. over DacVisualizer::Loop() calls
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+template<unsigned int N>
+class RealFft
+{
+public:
+    static_assert( (N >= 16) && (N <= 1024) && ((N & (N - 1)) == 0), "RealFft: N must be a power of two, 16..1024" );
+    static const unsigned int kLen = N;
+    static const unsigned int kNumBins = N / 2 + 1;     // DC .. Nyquist
+
+    RealFft()
+    {
+        const double kPi = 3.14159265358979323846;
+        for( unsigned int k=0; k<N/2; k++ )
+        {
+            cos_[k] = _Q15(cos(2.0 * kPi * k / N));
+            sin_[k] = _Q15(-sin(2.0 * kPi * k / N));
+        }
+        for( unsigned int n=0; n<N; n++ )
+            window_[n] = _Q15(0.25 - 0.25 * cos(2.0 * kPi * n / N));
+        num_stages_ = 0;
+        for( unsigned int m=1; m<N/2; m*=2 )
+            num_stages_++;
+        stage_ = num_stages_;
+    }
+
+    // Fill with N samples, then ::Start() or ::Compute()
+    int16_t * GetInput()
+    {
+        return buf_;
+    }
+
+    // Window & reorder the input for the stages
+    void Start()
+    {
+        for( unsigned int n=0; n<N; n++ )
+            buf_[n] = (int16_t)(((int32_t)buf_[n] * window_[n] + (1 << 14)) >> 15);
+
+        // bit-reversal permutation of the complex points
+        const unsigned int M = N / 2;
+        for( unsigned int i=1, j=0; i<M; i++ )
+        {
+            unsigned int bit = M >> 1;
+            for( ; j & bit; bit >>= 1 )
+                j ^= bit;
+            j ^= bit;
+            if( i < j )
+            {
+                int16_t re = buf_[2 * i];
+                int16_t im = buf_[2 * i + 1];
+                buf_[2 * i] = buf_[2 * j];
+                buf_[2 * i + 1] = buf_[2 * j + 1];
+                buf_[2 * j] = re;
+                buf_[2 * j + 1] = im;
+            }
+        }
+        stage_ = 0;
+    }
+
+    // One butterfly stage
+    // - returns true once all stages are done, i.e. the bins are ready
+    bool Step()
+    {
+        if( stage_ >= num_stages_ )
+            return true;
+
+        const unsigned int M = N / 2;
+        const unsigned int half = 1u << stage_;
+        const unsigned int stride = (M / half);     // twiddle index step, in N-point units
+        for( unsigned int group=0; group<M; group+=2*half )
+        {
+            for( unsigned int j=0; j<half; j++ )
+            {
+                int32_t wr = cos_[j * stride];
+                int32_t wi = sin_[j * stride];
+                int16_t *a = buf_ + 2 * (group + j);
+                int16_t *b = a + 2 * half;
+                int32_t tr = (wr * b[0] - wi * b[1] + (1 << 14)) >> 15;
+                int32_t ti = (wr * b[1] + wi * b[0] + (1 << 14)) >> 15;
+                int32_t ar = a[0];
+                int32_t ai = a[1];
+                a[0] = (int16_t)((ar + tr) >> 1);
+                a[1] = (int16_t)((ai + ti) >> 1);
+                b[0] = (int16_t)((ar - tr) >> 1);
+                b[1] = (int16_t)((ai - ti) >> 1);
+            }
+        }
+        stage_++;
+        return stage_ >= num_stages_;
+    }
+
+    bool IsDone() const
+    {
+        return stage_ >= num_stages_;
+    }
+
+    void Compute()
+    {
+        Start();
+        while( !Step() )
+        {
+        }
+    }
+
+    // Bin k in [0, N/2], real & imaginary parts, scaled by 1/2N
+    // - splits the complex result into the real-input spectrum on the fly
+    void GetBin(unsigned int k, int32_t & re, int32_t & im) const
+    {
+        assert( IsDone() );
+        assert( k <= N / 2 );
+        const unsigned int M = N / 2;
+        unsigned int k1 = (k == M) ? 0 : k;
+        unsigned int k2 = (k == 0) ? 0 : M - k;
+        int32_t zr = buf_[2 * k1];
+        int32_t zi = buf_[2 * k1 + 1];
+        int32_t zr2 = buf_[2 * k2];
+        int32_t zi2 = buf_[2 * k2 + 1];
+
+        // even & odd sample spectra, then X[k] = Fe + W^k Fo
+        int32_t fer = zr + zr2;
+        int32_t fei = zi - zi2;
+        int32_t hor = zi + zi2;
+        int32_t hoi = zr2 - zr;
+        int32_t wr;
+        int32_t wi;
+        if( k < M )
+        {
+            wr = cos_[k];
+            wi = sin_[k];
+        }
+        else
+        {
+            wr = -32767;    // W^(N/2) == -1
+            wi = 0;
+        }
+        re = (fer + ((wr * hor - wi * hoi + (1 << 14)) >> 15)) >> 2;
+        im = (fei + ((wr * hoi + wi * hor + (1 << 14)) >> 15)) >> 2;
+    }
+
+    // |X[k]|^2, scaled by 1/4N^2
+    uint32_t GetPower(unsigned int k) const
+    {
+        int32_t re;
+        int32_t im;
+        GetBin(k, re, im);
+        return (uint32_t)(re * re) + (uint32_t)(im * im);
+    }
+
+private:
+    static int16_t _Q15(double val)
+    {
+        long q = lround(val * 32768.0);
+        return (int16_t)((q > 32767) ? 32767 : (q < -32768) ? -32768 : q);
+    }
+
+    int16_t buf_[N];
+    int16_t cos_[N / 2];
+    int16_t sin_[N / 2];
+    int16_t window_[N];
+    unsigned int num_stages_;
+    unsigned int stage_;
+};
+
+// vim: sw=4:ts=4
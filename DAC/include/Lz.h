@@ -0,0 +1,299 @@
+// LZ block compression for PCM clips
+// - lossless, LZ4-style byte-oriented LZ77, so decoding is just literal & match copies
+// - clip data is split into kLzBlockBytes blocks of raw PCM, each compressed independently so the
+// decoder only ever needs one block of RAM (its window):
+//      uint16_t header             payload length, | kLzStoredFlag if stored uncompressed
+//      payload
+//  - every block but the last decodes to kLzBlockBytes, so 16-bit samples never straddle blocks
+// - block payload is a sequence of:
+//      token                       literal count (high nibble), match length - 4 (low nibble)
+//      [255.. n]                   literal count extension, if high nibble == 15
+//      literals
+//      offset                      uint16_t, back from the current position (absent in the last sequence)
+//      [255.. n]                   match length extension, if low nibble == 15
+// - LzSource decodes a block into its window as playback reaches it, see DacBench for the
+// per-block decode latency vs. the sample deadline
+// - LzEncode() is for host tools & tests
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <vector>
+#include "SampleSource.h"
+
+static const unsigned int kLzBlockBytes = 1024;
+static const uint16_t kLzStoredFlag = 0x8000;
+static const unsigned int kLzMinMatch = 4;
+
+// Decode one block's payload
+// - returns number of bytes decoded, or -1 if the payload is corrupt or won't fit in dst_len
+inline int LzDecodeBlock(const uint8_t *src, unsigned int src_len, uint8_t *dst, unsigned int dst_len)
+{
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + src_len;
+    unsigned int op = 0;
+    while( ip < iend )
+    {
+        uint8_t token = *ip++;
+
+        unsigned int num_literals = token >> 4;
+        if( num_literals == 15 )
+        {
+            uint8_t b;
+            do
+            {
+                if( ip >= iend )
+                    return -1;
+                b = *ip++;
+                num_literals += b;
+            } while( b == 255 );
+        }
+        if( (num_literals > (unsigned int)(iend - ip)) || (num_literals > dst_len - op) )
+            return -1;
+        memcpy(dst + op, ip, num_literals);
+        ip += num_literals;
+        op += num_literals;
+        if( ip >= iend )
+            break;  // last sequence, literals only
+
+        if( iend - ip < 2 )
+            return -1;
+        unsigned int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        unsigned int match_len = (token & 0x0f) + kLzMinMatch;
+        if( (token & 0x0f) == 15 )
+        {
+            uint8_t b;
+            do
+            {
+                if( ip >= iend )
+                    return -1;
+                b = *ip++;
+                match_len += b;
+            } while( b == 255 );
+        }
+        if( (offset == 0) || (offset > op) || (match_len > dst_len - op) )
+            return -1;
+
+        const uint8_t *match = dst + op - offset;
+        if( offset >= match_len )
+        {
+            memcpy(dst + op, match, match_len);
+        }
+        else
+        {
+            // overlapping, e.g. a run, must copy forwards byte by byte
+            for( unsigned int i=0; i<match_len; i++ )
+                dst[op + i] = match[i];
+        }
+        op += match_len;
+    }
+    return (int)op;
+}
+
+//-----------------------------------
+// Encoder
+
+inline void _LzPutLength(std::vector<uint8_t> & out, unsigned int len)
+{
+    while( len >= 255 )
+    {
+        out.push_back(255);
+        len -= 255;
+    }
+    out.push_back((uint8_t)len);
+}
+
+inline void _LzPutSequence(std::vector<uint8_t> & out, const uint8_t *literals, unsigned int num_literals,
+        unsigned int offset, unsigned int match_len)
+{
+    unsigned int lit_nibble = (num_literals < 15) ? num_literals : 15;
+    unsigned int match_nibble = 0;
+    if( match_len > 0 )
+        match_nibble = (match_len - kLzMinMatch < 15) ? match_len - kLzMinMatch : 15;
+    out.push_back((uint8_t)((lit_nibble << 4) | match_nibble));
+    if( lit_nibble == 15 )
+        _LzPutLength(out, num_literals - 15);
+    out.insert(out.end(), literals, literals + num_literals);
+    if( match_len > 0 )
+    {
+        out.push_back((uint8_t)(offset & 0xff));
+        out.push_back((uint8_t)(offset >> 8));
+        if( match_nibble == 15 )
+            _LzPutLength(out, match_len - kLzMinMatch - 15);
+    }
+}
+
+inline uint32_t _LzHash(const uint8_t *p)
+{
+    uint32_t val;
+    memcpy(&val, p, sizeof(val));
+    return (val * 2654435761u) >> (32 - 12);
+}
+
+// Compress one block's payload, greedy matching w/ a hash table of the last position seen
+inline std::vector<uint8_t> LzEncodeBlock(const uint8_t *src, unsigned int len)
+{
+    std::vector<uint8_t> out;
+    std::vector<int> head(1 << 12, -1);
+    unsigned int anchor = 0;
+    unsigned int pos = 0;
+    while( pos + kLzMinMatch <= len )
+    {
+        uint32_t hash = _LzHash(src + pos);
+        int candidate = head[hash];
+        head[hash] = (int)pos;
+        if( (candidate >= 0) && (memcmp(src + candidate, src + pos, kLzMinMatch) == 0) )
+        {
+            unsigned int match_len = kLzMinMatch;
+            while( (pos + match_len < len) && (src[candidate + match_len] == src[pos + match_len]) )
+                match_len++;
+            _LzPutSequence(out, src + anchor, pos - anchor, pos - candidate, match_len);
+            for( unsigned int i=pos + 1; (i < pos + match_len) && (i + kLzMinMatch <= len); i++ )
+                head[_LzHash(src + i)] = (int)i;
+            pos += match_len;
+            anchor = pos;
+        }
+        else
+        {
+            pos++;
+        }
+    }
+    _LzPutSequence(out, src + anchor, len - anchor, 0, 0);
+    return out;
+}
+
+// Compress raw PCM clip data into the block format above
+inline std::vector<uint8_t> LzEncode(const void *data, uint32_t num_bytes)
+{
+    const uint8_t *src = (const uint8_t *)data;
+    std::vector<uint8_t> out;
+    for( uint32_t pos=0; pos<num_bytes; pos+=kLzBlockBytes )
+    {
+        unsigned int len = (num_bytes - pos < kLzBlockBytes) ? num_bytes - pos : kLzBlockBytes;
+        std::vector<uint8_t> payload = LzEncodeBlock(src + pos, len);
+        uint16_t header = (uint16_t)payload.size();
+        if( payload.size() >= len )
+        {
+            // incompressible, store as is
+            payload.assign(src + pos, src + pos + len);
+            header = (uint16_t)len | kLzStoredFlag;
+        }
+        out.push_back((uint8_t)(header & 0xff));
+        out.push_back((uint8_t)(header >> 8));
+        out.insert(out.end(), payload.begin(), payload.end());
+    }
+    return out;
+}
+
+//-----------------------------------
+// Streaming decoder
+// - decodes a block into the window as playback reaches it, then serves samples from the window
+class LzSource : public ISampleSource
+{
+public:
+    LzSource(const void *data=nullptr, uint32_t num_bytes=0, uint32_t num_samples=0, unsigned int bits_per_sample=8)
+    {
+        SetData(data, num_bytes, num_samples, bits_per_sample);
+    }
+
+    void SetData(const void *data, uint32_t num_bytes, uint32_t num_samples, unsigned int bits_per_sample)
+    {
+        assert( (bits_per_sample == 8) || (bits_per_sample == 16) );
+        data_ = (const uint8_t *)data;
+        num_bytes_ = num_bytes;
+        bytes_per_sample_ = bits_per_sample / 8;
+        raw_len_ = num_samples * bytes_per_sample_;
+        assert( (data_ != nullptr) || (num_samples == 0) );
+        Restart();
+    }
+
+    // ISampleSource Interface overrides begin {
+
+    unsigned int Read(int16_t *out, unsigned int num_samples) override
+    {
+        unsigned int produced = 0;
+        while( produced < num_samples )
+        {
+            if( (window_pos_ >= window_len_) && !_DecodeNextBlock() )
+                break;
+
+            unsigned int n = (window_len_ - window_pos_) / bytes_per_sample_;
+            if( n > num_samples - produced )
+                n = num_samples - produced;
+            if( bytes_per_sample_ == 1 )
+                ConvertRun(window_ + window_pos_, out + produced, n);
+            else
+                memcpy(out + produced, window_ + window_pos_, n * sizeof(int16_t));
+            produced += n;
+            window_pos_ += n * bytes_per_sample_;
+        }
+        return produced;
+    }
+
+    void Restart() override
+    {
+        src_pos_ = 0;
+        decoded_ = 0;
+        window_len_ = 0;
+        window_pos_ = 0;
+    }
+
+    // ISampleSource Interface overrides end }
+
+private:
+    // Decode the next block into the window
+    // - returns false at the end of the clip, or on a corrupt block
+    bool _DecodeNextBlock()
+    {
+        if( (decoded_ >= raw_len_) || (src_pos_ + 2 > num_bytes_) )
+            return false;
+
+        unsigned int expected = (raw_len_ - decoded_ < kLzBlockBytes) ? raw_len_ - decoded_ : kLzBlockBytes;
+        uint16_t header = data_[src_pos_] | (data_[src_pos_ + 1] << 8);
+        unsigned int payload_len = header & ~kLzStoredFlag;
+        src_pos_ += 2;
+        if( src_pos_ + payload_len > num_bytes_ )
+            return false;
+
+        int len;
+        if( header & kLzStoredFlag )
+        {
+            len = (payload_len <= kLzBlockBytes) ? (int)payload_len : -1;
+            if( len > 0 )
+                memcpy(window_, data_ + src_pos_, len);
+        }
+        else
+        {
+            len = LzDecodeBlock(data_ + src_pos_, payload_len, window_, kLzBlockBytes);
+        }
+        src_pos_ += payload_len;
+        if( len != (int)expected )
+        {
+            assert(false);  // corrupt clip data
+            decoded_ = raw_len_;
+            return false;
+        }
+
+        decoded_ += len;
+        window_len_ = len;
+        window_pos_ = 0;
+        return true;
+    }
+
+    const uint8_t *data_;
+    uint32_t num_bytes_;
+    uint32_t raw_len_;              // decoded clip size, in bytes
+    unsigned int bytes_per_sample_;
+
+    uint32_t src_pos_;              // next block header
+    uint32_t decoded_;              // bytes decoded so far
+    uint8_t window_[kLzBlockBytes];
+    unsigned int window_len_;
+    unsigned int window_pos_;
+};
+
+// vim: sw=4:ts=4
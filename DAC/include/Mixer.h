@@ -0,0 +1,232 @@
+// Multi-voice mixer
+// - mixes up to NUM_VOICES sample sources into one stream, e.g. overlapping sound effects plus
+// speech through a single DAC (IDac::SetSource())
+// - each voice has its own source, gain, loop flag and done-callback
+// - voices are rendered & summed in blocks, 32-bit accumulate, saturated to 16-bit once per
+// output sample
+// - never runs out: when no voice is playing the output is silence, so the DAC keeps running
+// - ::Play()/::Stop()/::SetGain() & ::Loop() are called from loop(), ::Read() from wherever the
+// DAC renders (e.g. the DacT timer task)
+//  - voice ownership is handed over via a per-voice atomic state, a voice's source is only
+//  touched by ::Read() while the voice is playing
+//  - done-callbacks are deferred to ::Loop(), so they never run in the render context
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <atomic>
+#include "SampleSource.h"
+
+template<unsigned int NUM_VOICES=4>
+class Mixer : public ISampleSource
+{
+public:
+    static const unsigned int kNumVoices = NUM_VOICES;
+    static const int16_t kUnityGain = 0x7fff;    // Q15, ~1.0
+    static const unsigned int kBlockLen = 64;    // in samples
+
+    // Called from ::Loop() once a voice has finished (or been stopped)
+    typedef void (*DoneCallback)(int voice, void *arg);
+
+    Mixer()
+    {
+        for( Voice & voice : voices_ )
+        {
+            voice.state.store(kFree, std::memory_order_relaxed);
+        }
+    }
+
+    // Start playing source on a free voice
+    // - source is restarted first
+    // - returns the voice index, or -1 if all voices are busy or source is already playing on one
+    //  - a source has a single read position, so it can't play on two voices at once (restarting
+    //  it would also restart the other voice, from under ::Read()); play a separate source per
+    //  voice, or ::Stop() the other one & wait for its done-callback
+    int Play(ISampleSource *source, int16_t gain=kUnityGain, bool looped=false, DoneCallback done_cb=nullptr, void *done_arg=nullptr)
+    {
+        assert(source);
+        for( unsigned int i=0; i<kNumVoices; i++ )
+        {
+            if( IsPlaying(i) && (voices_[i].source == source) )
+                return -1;
+        }
+        for( unsigned int i=0; i<kNumVoices; i++ )
+        {
+            Voice & voice = voices_[i];
+            if( voice.state.load(std::memory_order_acquire) != kFree )
+                continue;
+
+            source->Restart();
+            voice.source = source;
+            voice.gain = gain;
+            voice.looped = looped;
+            voice.done_cb = done_cb;
+            voice.done_arg = done_arg;
+            voice.state.store(kPlaying, std::memory_order_release);
+            return (int)i;
+        }
+        return -1;
+    }
+
+    // Stop a voice, its done-callback is still called from ::Loop()
+    void Stop(int voice_idx)
+    {
+        assert( (voice_idx >= 0) && (voice_idx < (int)kNumVoices) );
+        uint8_t expected = kPlaying;
+        voices_[voice_idx].state.compare_exchange_strong(expected, kStopping, std::memory_order_acq_rel);
+    }
+
+    void StopAll()
+    {
+        for( unsigned int i=0; i<kNumVoices; i++ )
+        {
+            Stop(i);
+        }
+    }
+
+    void SetGain(int voice_idx, int16_t gain)
+    {
+        assert( (voice_idx >= 0) && (voice_idx < (int)kNumVoices) );
+        voices_[voice_idx].gain = gain;
+    }
+
+    bool IsPlaying(int voice_idx)
+    {
+        assert( (voice_idx >= 0) && (voice_idx < (int)kNumVoices) );
+        uint8_t state = voices_[voice_idx].state.load(std::memory_order_acquire);
+        return (state == kPlaying) || (state == kStopping);
+    }
+
+    unsigned int GetNumPlaying()
+    {
+        unsigned int num_playing = 0;
+        for( unsigned int i=0; i<kNumVoices; i++ )
+        {
+            num_playing += IsPlaying(i) ? 1 : 0;
+        }
+        return num_playing;
+    }
+
+    // Frees finished voices & calls their done-callbacks
+    // - call regularly from loop()
+    void Loop()
+    {
+        for( unsigned int i=0; i<kNumVoices; i++ )
+        {
+            Voice & voice = voices_[i];
+            if( voice.state.load(std::memory_order_acquire) != kDone )
+                continue;
+
+            DoneCallback done_cb = voice.done_cb;
+            void *done_arg = voice.done_arg;
+            voice.state.store(kFree, std::memory_order_release);
+            if( done_cb )
+            {
+                done_cb((int)i, done_arg);
+            }
+        }
+    }
+
+    // ISampleSource Interface overrides begin {
+
+    unsigned int Read(int16_t *out, unsigned int num_samples) override
+    {
+        unsigned int pos = 0;
+        while( pos < num_samples )
+        {
+            unsigned int n = num_samples - pos;
+            if( n > kBlockLen )
+                n = kBlockLen;
+            _MixBlock(out + pos, n);
+            pos += n;
+        }
+        return num_samples;
+    }
+
+    // Stops all voices
+    void Restart() override
+    {
+        StopAll();
+    }
+
+    // ISampleSource Interface overrides end }
+
+private:
+    enum State : uint8_t
+    {
+        kFree,      // owned by loop(), available to ::Play()
+        kPlaying,   // owned by ::Read()
+        kStopping,  // stop requested, ::Read() will retire it
+        kDone,      // finished, waiting for ::Loop() to free it
+    };
+
+    struct Voice
+    {
+        std::atomic<uint8_t> state;
+        ISampleSource *source;
+        volatile int16_t gain;
+        bool looped;
+        DoneCallback done_cb;
+        void *done_arg;
+    };
+
+    void _MixBlock(int16_t *out, unsigned int n)
+    {
+        int32_t acc[kBlockLen];
+        memset(acc, 0, n * sizeof(int32_t));
+
+        for( Voice & voice : voices_ )
+        {
+            uint8_t state = voice.state.load(std::memory_order_acquire);
+            if( state == kStopping )
+            {
+                voice.state.store(kDone, std::memory_order_release);
+                continue;
+            }
+            if( state != kPlaying )
+                continue;
+
+            int32_t gain = voice.gain;
+            unsigned int filled = 0;
+            bool restarted = false;
+            while( filled < n )
+            {
+                int16_t samples[kBlockLen];
+                unsigned int got = voice.source->Read(samples, n - filled);
+                for( unsigned int i=0; i<got; i++ )
+                {
+                    acc[filled + i] += ((int32_t)samples[i] * gain) >> 15;
+                }
+                filled += got;
+                if( filled < n )
+                {
+                    // finished, or a looped source that is empty (don't spin on it)
+                    if( !voice.looped || (restarted && (got == 0)) )
+                    {
+                        voice.state.store(kDone, std::memory_order_release);
+                        break;
+                    }
+                    voice.source->Restart();
+                    restarted = true;
+                }
+            }
+        }
+
+        for( unsigned int i=0; i<n; i++ )
+        {
+            int32_t val = acc[i];
+            if( val > 32767 )
+                val = 32767;
+            else if( val < -32768 )
+                val = -32768;
+            out[i] = (int16_t)val;
+        }
+    }
+
+    Voice voices_[kNumVoices];
+};
+
+// vim: sw=4:ts=4
@@ -0,0 +1,261 @@
+// Streaming sample-rate converter
+// - polyphase FIR interpolator, converts a source at any rate to any output rate, e.g. SAM's
+// 22050 Hz to what the chosen DAC backend sustains, or one stored clip to every rate
+// - quality:
+//  - Linear: 2 taps, cheapest, audible imaging/aliasing
+//  - Taps8:  8-tap windowed sinc (times the decimation factor when downsampling, see below)
+//  - Taps16: 16-tap windowed sinc (ditto)
+// - fixed-point: Q15 coefficients, 32-bit accumulate, saturated output
+//  - coefficient table is built once per ::Configure() (floating point, not in the sample path),
+//  with up to kNumPhases sub-sample phases
+//  - when downsampling, the filter cutoff is lowered to the output Nyquist, so the same table
+//  also does the anti-aliasing
+//  - the windowed-sinc filters also get ceil(source/output) times longer when downsampling (up to
+//  kMaxDecimation), so their transition band stays the same fraction of the output band; a fixed
+//  length leaves a transition band wider than the whole output band (e.g. 44.1 kHz to 8 kHz)
+//  - longer filters use fewer phases (down to kMinPhases); the signal is oversampled by the same
+//  factor, so the phase resolution per output band is kept
+//  - Taps16 table size: 8 KB up to 4x decimation, then growing with the filter length to 16 KB
+//  at kMaxDecimation, e.g. 12 KB for 44.1 kHz to 8 kHz (Taps8: half that)
+// - read position is a 32.32 fixed-point phase accumulator, no drift over long streams
+// - output is aligned with the source (sample 0 in => sample 0 out), and the tail of the filter
+// is flushed once the source is exhausted
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "SampleSource.h"
+
+enum class ResampleQuality
+{
+    Linear,
+    Taps8,
+    Taps16,
+};
+
+class Resampler : public ISampleSource
+{
+public:
+    static const unsigned int kNumPhases = 256;
+    static const unsigned int kMinPhases = 64;
+    static const unsigned int kMaxDecimation = 8;   // filter length multiplier, at most
+    static const unsigned int kMaxTaps = 16 * kMaxDecimation;
+
+    Resampler(ISampleSource *source=nullptr, unsigned int source_rate_Hz=22050, unsigned int output_rate_Hz=22050, ResampleQuality quality=ResampleQuality::Taps8)
+    {
+        Configure(source, source_rate_Hz, output_rate_Hz, quality);
+    }
+
+    ~Resampler()
+    {
+        free(coefs_);
+    }
+
+    Resampler(Resampler const&)         = delete;
+    void operator=(Resampler const&)    = delete;
+
+    void Configure(ISampleSource *source, unsigned int source_rate_Hz, unsigned int output_rate_Hz, ResampleQuality quality)
+    {
+        assert( source_rate_Hz > 0 );
+        assert( output_rate_Hz > 0 );
+        source_ = source;
+
+        uint64_t step = ((uint64_t)source_rate_Hz << 32) / output_rate_Hz;
+        step_int_ = (uint32_t)(step >> 32);
+        step_frac_ = (uint32_t)step;
+
+        num_taps_ = (quality == ResampleQuality::Linear) ? 2 : (quality == ResampleQuality::Taps8) ? 8 : 16;
+        phase_bits_ = kPhaseBits;
+        if( (num_taps_ > 2) && (output_rate_Hz < source_rate_Hz) )
+        {
+            unsigned int decimation = (source_rate_Hz + output_rate_Hz - 1) / output_rate_Hz;
+            if( decimation > kMaxDecimation )
+                decimation = kMaxDecimation;
+            num_taps_ *= decimation;
+            for( unsigned int d=1; (d < decimation) && ((1u << phase_bits_) > kMinPhases); d*=2 )
+                phase_bits_--;
+        }
+        free(coefs_);
+        coefs_ = (int16_t *)malloc((1u << phase_bits_) * num_taps_ * sizeof(int16_t));
+        assert(coefs_);
+        _BuildTable(source_rate_Hz, output_rate_Hz);
+
+        _Reset();
+    }
+
+    // ISampleSource Interface overrides begin {
+
+    unsigned int Read(int16_t *out, unsigned int num_samples) override
+    {
+        unsigned int produced = 0;
+        while( produced < num_samples )
+        {
+            if( pos_ + num_taps_ > hist_len_ )
+            {
+                if( !_Refill() )
+                    break;  // source & filter tail exhausted
+                continue;
+            }
+
+            const int16_t *hist = hist_ + pos_;
+            const int16_t *coefs = coefs_ + (frac_ >> (32 - phase_bits_)) * num_taps_;
+            int32_t acc = 1 << 14;  // rounding
+            for( unsigned int k=0; k<num_taps_; k++ )
+            {
+                acc += (int32_t)hist[k] * coefs[k];
+            }
+            acc >>= 15;
+            if( acc > 32767 )
+                acc = 32767;
+            else if( acc < -32768 )
+                acc = -32768;
+            out[produced++] = (int16_t)acc;
+
+            uint32_t prev_frac = frac_;
+            frac_ += step_frac_;
+            pos_ += step_int_ + (frac_ < prev_frac ? 1 : 0);
+        }
+        return produced;
+    }
+
+    void Restart() override
+    {
+        if( source_ )
+            source_->Restart();
+        _Reset();
+    }
+
+    // ISampleSource Interface overrides end }
+
+private:
+    static const unsigned int kPhaseBits = 8;   // log2(kNumPhases)
+    static const unsigned int kChunkLen = 64;   // source samples read per refill
+    static const unsigned int kHistLen = kMaxTaps + kChunkLen;
+
+    // Windowed-sinc table, one row of num_taps_ Q15 coefficients per phase
+    // - tap k of phase p weights source sample (center + k - (num_taps_/2 - 1)) for an output
+    // p/num_phases of a sample past center
+    void _BuildTable(unsigned int source_rate_Hz, unsigned int output_rate_Hz)
+    {
+        // cutoff relative to source Nyquist, lowered to output Nyquist when downsampling
+        float cutoff = (output_rate_Hz < source_rate_Hz) ? (float)output_rate_Hz / source_rate_Hz : 1.0f;
+        if( num_taps_ > 2 )
+            cutoff *= 0.9f;     // leave room for the transition band
+
+        const float kPi = 3.14159265f;
+        const int center = (int)num_taps_ / 2 - 1;
+        const unsigned int num_phases = 1u << phase_bits_;
+        for( unsigned int p=0; p<num_phases; p++ )
+        {
+            float frac = (float)p / num_phases;
+            float taps[kMaxTaps];
+            float sum = 0.0f;
+            for( unsigned int k=0; k<num_taps_; k++ )
+            {
+                float t = (float)((int)k - center) - frac;
+                if( num_taps_ == 2 )
+                {
+                    taps[k] = 1.0f - fabsf(t);  // linear
+                }
+                else
+                {
+                    float x = kPi * cutoff * t;
+                    float sinc = (fabsf(x) < 1e-6f) ? 1.0f : sinf(x) / x;
+                    // Blackman window spanning the taps
+                    float w = (t + center + 1) / num_taps_;
+                    float window = 0.42f - 0.5f * cosf(2.0f * kPi * w) + 0.08f * cosf(4.0f * kPi * w);
+                    taps[k] = sinc * window;
+                }
+                sum += taps[k];
+            }
+
+            // normalize each phase to unity DC gain, so no phase-dependent ripple on DC
+            int16_t *row = coefs_ + p * num_taps_;
+            for( unsigned int k=0; k<num_taps_; k++ )
+            {
+                row[k] = (int16_t)lrintf(taps[k] / sum * 32767.0f);
+            }
+        }
+    }
+
+    void _Reset()
+    {
+        // pre-roll so the first output is centered on source sample 0
+        hist_len_ = num_taps_ / 2 - 1;
+        memset(hist_, 0, hist_len_ * sizeof(int16_t));
+        pos_ = 0;
+        frac_ = 0;
+        source_done_ = (source_ == nullptr);
+        tail_left_ = num_taps_ / 2;
+    }
+
+    // Top up the history from the source, or with the zero tail once the source is done
+    // - returns false once there is nothing left to add
+    bool _Refill()
+    {
+        // discard consumed samples
+        if( pos_ >= hist_len_ )
+        {
+            // skipping beyond what's buffered (downsampling by more than the history), drop from source
+            pos_ -= hist_len_;
+            hist_len_ = 0;
+            while( (pos_ > 0) && !source_done_ )
+            {
+                int16_t discard[kChunkLen];
+                unsigned int n = (pos_ < kChunkLen) ? pos_ : kChunkLen;
+                unsigned int got = source_->Read(discard, n);
+                pos_ -= got;
+                if( got < n )
+                    source_done_ = true;
+            }
+            if( pos_ > 0 )
+                return false;
+        }
+        else
+        {
+            memmove(hist_, hist_ + pos_, (hist_len_ - pos_) * sizeof(int16_t));
+            hist_len_ -= pos_;
+            pos_ = 0;
+        }
+
+        unsigned int space = kHistLen - hist_len_;
+        if( !source_done_ )
+        {
+            unsigned int got = source_->Read(hist_ + hist_len_, space);
+            hist_len_ += got;
+            if( got < space )
+                source_done_ = true;
+            return true;
+        }
+
+        if( tail_left_ == 0 )
+            return false;
+        unsigned int n = (tail_left_ < space) ? tail_left_ : space;
+        memset(hist_ + hist_len_, 0, n * sizeof(int16_t));
+        hist_len_ += n;
+        tail_left_ -= n;
+        return true;
+    }
+
+    ISampleSource *source_;
+    unsigned int num_taps_;
+    unsigned int phase_bits_;       // log2(phases in the table)
+    int16_t *coefs_ = nullptr;      // (1 << phase_bits_) x num_taps_
+
+    uint32_t step_int_;             // source samples per output sample, integer part
+    uint32_t step_frac_;            // fractional part, 0.32 fixed point
+    uint32_t frac_;                 // read phase, 0.32 fixed point
+
+    int16_t hist_[kHistLen];        // source history, taps start at pos_
+    unsigned int hist_len_;
+    unsigned int pos_;
+    bool source_done_;
+    unsigned int tail_left_;        // zeros still to append after the source is done
+};
+
+// vim: sw=4:ts=4
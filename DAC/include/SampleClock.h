@@ -0,0 +1,109 @@
+// Sample clock for polled DAC implementations
+// - phase accumulator: sample period kept as whole micro secs plus a fractional remainder (in
+// units of 1/samplerate us), so e.g. 22050 Hz averages 45.351 us rather than truncating to 45 us
+// - schedule is absolute, the next due time advances by exactly one period per sample rather than
+// being reset to whenever the poll happened to run
+// - wrap-safe, times are compared via signed difference so micros() roll-over (~70 mins) is harmless
+// - time is passed in, so it can be driven by a simulated clock on the host
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+
+class SampleClock
+{
+public:
+    // What to do when the poller has fallen behind by more than max_lag samples
+    enum CatchUp
+    {
+        kEmit,  // emit the missed samples, one per poll, until caught up (keeps every sample, pitch recovers)
+        kDrop,  // skip the missed samples and resync (keeps timing, loses audio)
+    };
+
+    SampleClock(unsigned int samplerate_Hz=8000, CatchUp catch_up=kDrop, unsigned int max_lag=8)
+    {
+        SetSamplerate(samplerate_Hz);
+        catch_up_ = catch_up;
+        max_lag_ = max_lag;
+    }
+
+    void SetSamplerate(unsigned int samplerate_Hz)
+    {
+        assert( samplerate_Hz > 0 );
+        samplerate_ = samplerate_Hz;
+        period_us_ = 1000000 / samplerate_Hz;
+        period_rem_ = 1000000 % samplerate_Hz;
+    }
+
+    void SetCatchUp(CatchUp catch_up, unsigned int max_lag)
+    {
+        catch_up_ = catch_up;
+        max_lag_ = max_lag;
+    }
+
+    // (Re)start the schedule, first sample is due at now_us
+    void Start(uint32_t now_us)
+    {
+        due_us_ = now_us;
+        frac_ = 0;
+        num_dropped_ = 0;
+    }
+
+    // Poll the clock
+    // - returns number of samples to emit now: 0 (not yet due) or 1
+    // - with kDrop, *skip is set to the number of samples to skip before the one emitted
+    unsigned int Poll(uint32_t now_us, unsigned int *skip=nullptr)
+    {
+        if( skip )
+            *skip = 0;
+
+        int32_t lag_us = (int32_t)(now_us - due_us_);
+        if( lag_us < 0 )
+            return 0;
+
+        if( (catch_up_ == kDrop) && (lag_us > (int32_t)(max_lag_ * period_us_)) )
+        {
+            // resync: skip all samples that are already overdue, keep phase
+            unsigned int num_late = (unsigned int)((uint64_t)lag_us * samplerate_ / 1000000);
+            for( unsigned int i=0; i<num_late; i++ )
+                _Advance();
+            num_dropped_ += num_late;
+            if( skip )
+                *skip = num_late;
+        }
+
+        _Advance();
+        return 1;
+    }
+
+    // Number of samples skipped by kDrop since Start()
+    unsigned int GetNumDropped() const
+    {
+        return num_dropped_;
+    }
+
+private:
+    void _Advance()
+    {
+        due_us_ += period_us_;
+        frac_ += period_rem_;
+        if( frac_ >= samplerate_ )
+        {
+            frac_ -= samplerate_;
+            due_us_++;
+        }
+    }
+
+    unsigned int samplerate_;
+    uint32_t period_us_;        // whole micro secs per sample
+    uint32_t period_rem_;       // fractional micro secs per sample, in 1/samplerate us
+    uint32_t due_us_ = 0;       // time the next sample is due
+    uint32_t frac_ = 0;         // accumulated fractional micro secs, in 1/samplerate us
+    CatchUp catch_up_;
+    unsigned int max_lag_;      // in samples
+    unsigned int num_dropped_ = 0;
+};
+
+// vim: sw=4:ts=4
@@ -0,0 +1,148 @@
+// 16-bit to 8-bit sample conversion kernels
+// - truncate: packed kernel, 4 samples per pair of 32-bit loads & one 32-bit store
+//  - for int16_t s, (s >> 8) + 128 is just the high byte with its top bit flipped, so the high
+//  bytes are gathered with shifts/masks and all 4 flipped with a single xor
+// - dither: TPDF dither (+/- 1 LSB of 8-bit, triangular) then rounding, decorrelates the
+// quantization error from the signal (no distortion products, slightly higher noise floor)
+// - noise shaped: TPDF dither plus error feedback, moves quantization & dither noise up towards fs/2
+//  - 1st order: NTF (1 - z^-1), 2nd order: NTF (1 - z^-1)^2
+//  - lowers the in-band noise for audio well below fs/2, at the cost of more noise overall
+// - dither/noise shaping are stateful (RNG & error history), see SampleConverter
+// - intended to be used in blocks, or ahead of time to convert a 16-bit buffer to 8-bit once
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#   error "SampleConvert.h packed kernels assume little-endian"
+#endif
+
+enum class ConvertMode
+{
+    Truncate,
+    Dither,
+    NoiseShape1,
+    NoiseShape2,
+};
+
+// Truncating conversion of n samples
+// - 4 samples per iteration, remainder done one at a time
+// - src & dst need not be aligned (memcpy loads/stores compile to word accesses where possible)
+inline void ConvertTruncatePacked(const int16_t *src, uint8_t *dst, unsigned int n)
+{
+    unsigned int i = 0;
+    for( ; i + 4 <= n; i += 4 )
+    {
+        uint32_t w0, w1;
+        memcpy(&w0, src + i, sizeof(w0));      // s0 (low half), s1 (high half)
+        memcpy(&w1, src + i + 2, sizeof(w1));  // s2, s3
+
+        uint32_t packed = ((w0 >> 8) & 0x000000ff)   // s0 high byte
+                        | ((w0 >> 16) & 0x0000ff00)  // s1 high byte
+                        | ((w1 << 8) & 0x00ff0000)   // s2 high byte
+                        | (w1 & 0xff000000);         // s3 high byte
+        packed ^= 0x80808080;                        // signed -> offset binary
+        memcpy(dst + i, &packed, sizeof(packed));
+    }
+    for( ; i < n; i++ )
+    {
+        dst[i] = (uint8_t)(((uint16_t)src[i] >> 8) ^ 0x80);
+    }
+}
+
+// Stateful 16-bit to 8-bit converter
+// - ::Convert() may be called block by block, dither & error history carry over between calls
+class SampleConverter
+{
+public:
+    SampleConverter(ConvertMode mode=ConvertMode::Truncate)
+    {
+        SetMode(mode);
+    }
+
+    void SetMode(ConvertMode mode)
+    {
+        mode_ = mode;
+        Reset();
+    }
+
+    ConvertMode GetMode() const
+    {
+        return mode_;
+    }
+
+    // Clear the error history, e.g. on restart
+    void Reset()
+    {
+        err1_ = 0;
+        err2_ = 0;
+    }
+
+    void Convert(const int16_t *src, uint8_t *dst, unsigned int n)
+    {
+        switch( mode_ )
+        {
+        case ConvertMode::Truncate:
+            ConvertTruncatePacked(src, dst, n);
+            break;
+        case ConvertMode::Dither:
+            for( unsigned int i=0; i<n; i++ )
+            {
+                dst[i] = _Quantize(src[i], _Tpdf(), nullptr);
+            }
+            break;
+        case ConvertMode::NoiseShape1:
+            for( unsigned int i=0; i<n; i++ )
+            {
+                int32_t shaped = (int32_t)src[i] - err1_;
+                dst[i] = _Quantize(shaped, _Tpdf(), &err1_);
+            }
+            break;
+        case ConvertMode::NoiseShape2:
+            for( unsigned int i=0; i<n; i++ )
+            {
+                int32_t shaped = (int32_t)src[i] - 2 * err1_ + err2_;
+                err2_ = err1_;
+                dst[i] = _Quantize(shaped, _Tpdf(), &err1_);
+            }
+            break;
+        }
+    }
+
+private:
+    // Triangular PDF dither in [-255, 255] (i.e. +/- 1 LSB of 8-bit), sum of two uniforms
+    int32_t _Tpdf()
+    {
+        // xorshift32, one draw gives both uniforms
+        rng_ ^= rng_ << 13;
+        rng_ ^= rng_ >> 17;
+        rng_ ^= rng_ << 5;
+        return (int32_t)(rng_ & 0xff) - (int32_t)((rng_ >> 8) & 0xff);
+    }
+
+    // Add dither & round to 8-bit, clamped
+    // - *err (if given) receives the total error (quantized - undithered input, in 16-bit units),
+    // so the dither is shaped along with the rounding error
+    //  - excludes any clamping so the feedback stays bounded at full scale
+    static uint8_t _Quantize(int32_t val, int32_t dither, int32_t *err)
+    {
+        int32_t q = (val + dither + 128) >> 8;    // [-128, 127] in range
+        if( err )
+            *err = q * 256 - val;
+        if( q < -128 )
+            q = -128;
+        else if( q > 127 )
+            q = 127;
+        return (uint8_t)(q + 128);
+    }
+
+    ConvertMode mode_;
+    uint32_t rng_ = 0x12345678;
+    int32_t err1_ = 0;     // e[n-1]
+    int32_t err2_ = 0;     // e[n-2]
+};
+
+// vim: sw=4:ts=4
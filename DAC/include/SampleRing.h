@@ -0,0 +1,151 @@
+// Sample ring buffer
+// - wait-free single-producer/single-consumer queue of samples
+//  - e.g. producer: TTS/decoder running from loop(), consumer: DacT timer callback
+// - capacity must be a power of two, indices free-run and are masked on access
+// - the producer only writes head_, the consumer only writes tail_
+//  - each side publishes its index with release ordering and reads the other side's index with
+//  acquire ordering, so sample data written before a publish is visible after the matching read
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <atomic>
+
+template<typename T>
+class SampleRing
+{
+public:
+    SampleRing(unsigned int capacity)
+    {
+        assert( capacity > 0 );
+        assert( (capacity & (capacity - 1)) == 0 );    // power of two
+        capacity_ = capacity;
+        mask_ = capacity - 1;
+        buffer_ = (T*)malloc(sizeof(T) * capacity_);
+        assert(buffer_);
+    }
+
+    ~SampleRing()
+    {
+        free(buffer_);
+    }
+
+    SampleRing(SampleRing const&)       = delete;
+    void operator=(SampleRing const&)   = delete;
+
+    unsigned int Capacity() const
+    {
+        return capacity_;
+    }
+
+    // Producer side {
+
+    // Number of samples that can currently be pushed
+    unsigned int Space() const
+    {
+        unsigned int head = head_.load(std::memory_order_relaxed);
+        unsigned int tail = tail_.load(std::memory_order_acquire);
+        return capacity_ - (head - tail);
+    }
+
+    // Push up to n samples, returns the number actually pushed
+    unsigned int Push(const T *samples, unsigned int n)
+    {
+        unsigned int head = head_.load(std::memory_order_relaxed);
+        unsigned int tail = tail_.load(std::memory_order_acquire);
+        unsigned int space = capacity_ - (head - tail);
+        if( n > space )
+            n = space;
+
+        // at most two contiguous segments: up to the end of storage, then from the start
+        unsigned int idx = head & mask_;
+        unsigned int first = capacity_ - idx;
+        if( first > n )
+            first = n;
+        memcpy(buffer_ + idx, samples, first * sizeof(T));
+        memcpy(buffer_, samples + first, (n - first) * sizeof(T));
+
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    bool Push(T sample)
+    {
+        unsigned int head = head_.load(std::memory_order_relaxed);
+        unsigned int tail = tail_.load(std::memory_order_acquire);
+        if( head - tail == capacity_ )
+            return false;
+
+        buffer_[head & mask_] = sample;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer side }
+
+    // Consumer side {
+
+    // Number of samples that can currently be popped
+    unsigned int Available() const
+    {
+        unsigned int tail = tail_.load(std::memory_order_relaxed);
+        unsigned int head = head_.load(std::memory_order_acquire);
+        return head - tail;
+    }
+
+    // Pop up to n samples, returns the number actually popped
+    unsigned int Pop(T *samples, unsigned int n)
+    {
+        unsigned int tail = tail_.load(std::memory_order_relaxed);
+        unsigned int head = head_.load(std::memory_order_acquire);
+        unsigned int avail = head - tail;
+        if( n > avail )
+            n = avail;
+
+        unsigned int idx = tail & mask_;
+        unsigned int first = capacity_ - idx;
+        if( first > n )
+            first = n;
+        memcpy(samples, buffer_ + idx, first * sizeof(T));
+        memcpy(samples + first, buffer_, (n - first) * sizeof(T));
+
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    bool Pop(T & sample)
+    {
+        unsigned int tail = tail_.load(std::memory_order_relaxed);
+        unsigned int head = head_.load(std::memory_order_acquire);
+        if( head == tail )
+            return false;
+
+        sample = buffer_[tail & mask_];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side }
+
+    // Discard contents
+    // - only safe while neither producer nor consumer is active
+    void Reset()
+    {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    T *buffer_;
+    unsigned int capacity_;
+    unsigned int mask_;
+
+    std::atomic<unsigned int> head_{0};   // next slot to write, owned by producer
+    std::atomic<unsigned int> tail_{0};   // next slot to read, owned by consumer
+};
+
+// vim: sw=4:ts=4
@@ -0,0 +1,95 @@
+// Sample sources
+// - pull-model interface for anything that produces a stream of 16-bit mono samples, e.g. a PCM
+// data buffer, or a processing stage (Resampler) wrapping another source
+// - IDac::SetSource() plays from a source instead of a data buffer
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+#include "DacRender.h"
+#include "ClipView.h"
+
+class ISampleSource
+{
+public:
+    virtual ~ISampleSource() {}
+
+    // Read up to num_samples samples into out
+    // - returns number of samples read, less than num_samples only once the source is exhausted
+    virtual unsigned int Read(int16_t *out, unsigned int num_samples) = 0;
+
+    // Rewind to the start
+    virtual void Restart() = 0;
+};
+
+// PCM data buffer source
+// - 8 or 16 bit data, optionally looped
+class BufferSource : public ISampleSource
+{
+public:
+    BufferSource(const void *buffer=nullptr, unsigned int buffer_len=0, unsigned int bits_per_sample=8, bool looped=false)
+    {
+        looped_ = looped;
+        buffer_ = nullptr;
+        buffer_len_ = 0;
+        bits_per_sample_ = bits_per_sample;
+        if( buffer != nullptr )
+        {
+            SetBuffer(buffer, buffer_len, bits_per_sample);
+        }
+        Restart();
+    }
+
+    BufferSource(const ClipView & clip, bool looped=false)
+        : BufferSource(clip.GetData(), clip.GetLen(), clip.GetBitsPerSample(), looped)
+    {
+    }
+
+    void SetBuffer(const void *buffer, unsigned int buffer_len, unsigned int bits_per_sample)
+    {
+        assert(buffer);
+        buffer_ = buffer;
+        buffer_len_ = buffer_len;
+        bits_per_sample_ = bits_per_sample;
+        Restart();
+    }
+
+    void SetLooped(bool looped)
+    {
+        looped_ = looped;
+    }
+
+    unsigned int GetPos() const
+    {
+        return buffer_pos_;
+    }
+
+    // ISampleSource Interface overrides begin {
+
+    unsigned int Read(int16_t *out, unsigned int num_samples) override
+    {
+        if( buffer_ == nullptr )
+            return 0;
+        return RenderBlock(buffer_, buffer_len_, bits_per_sample_, looped_, buffer_pos_, done_, out, num_samples);
+    }
+
+    void Restart() override
+    {
+        buffer_pos_ = 0;
+        done_ = false;
+    }
+
+    // ISampleSource Interface overrides end }
+
+private:
+    const void *buffer_;
+    unsigned int buffer_len_;
+    unsigned int bits_per_sample_;
+    bool looped_;
+    unsigned int buffer_pos_;
+    bool done_;
+};
+
+// vim: sw=4:ts=4
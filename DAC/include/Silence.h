@@ -0,0 +1,265 @@
+// Silence trimming & run-length silence encoding for PCM clips
+// - leading & trailing silence is dropped, so the clip is shorter & audible from its first sample
+// - internal silent runs of kSilenceMinRun or more samples become (value, count) records
+// - silence == every sample within threshold of the mid level, runs play back as their mean value,
+// so the encoding is lossy only within threshold
+//  - threshold is a level in dBFS, the same whatever the bit depth (default: kSilence_dBFS), so
+//  reverb & fade-out tails are kept; 8-bit data is compared as 16-bit values, so at -60 dBFS (below
+//  one 8-bit LSB, -42 dBFS) only exact mid-level 8-bit samples are silent
+// - record stream, little-endian:
+//      uint16_t header             sample count, | kSilenceRunFlag for a run
+//      literal: count samples      as stored, 8-bit unsigned or 16-bit signed
+//      run: one sample             the run value, same format
+// - SilenceSource fills runs straight into the render block, without touching the clip data
+// - SilenceEncode() is for host tools & tests
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <vector>
+#include "SampleSource.h"
+
+static const uint16_t kSilenceRunFlag = 0x8000;
+static const uint32_t kSilenceMaxRecord = 0x7fff;          // samples per record
+static const unsigned int kSilenceMinRun = 64;              // shorter silences stay literal
+static const double kSilence_dBFS = -60.0;                  // default threshold
+
+// Threshold level in dBFS as a 16-bit sample magnitude, e.g. -60 dBFS => 32
+inline int SilenceThreshold(double dBFS)
+{
+    return (int)(32768.0 * pow(10.0, dBFS / 20.0));
+}
+
+//-----------------------------------
+// Encoder
+
+struct SilenceEncoded
+{
+    std::vector<uint8_t> data;
+    uint32_t num_samples;       // decoded length, i.e. after trimming
+    uint32_t lead_trimmed;      // samples
+    uint32_t tail_trimmed;      // samples
+    uint32_t num_runs;
+    uint32_t run_samples;       // samples in runs
+};
+
+inline int16_t _SilenceSample16(const uint8_t *data, unsigned int bits_per_sample, uint32_t idx)
+{
+    if( bits_per_sample == 8 )
+        return ConvertSampleTo16Bit(data[idx]);
+    int16_t val;
+    memcpy(&val, data + idx * 2, sizeof(val));
+    return val;
+}
+
+inline void _SilencePutHeader(std::vector<uint8_t> & out, uint16_t header)
+{
+    out.push_back((uint8_t)(header & 0xff));
+    out.push_back((uint8_t)(header >> 8));
+}
+
+// Encode 8-bit unsigned or 16-bit signed PCM
+inline SilenceEncoded SilenceEncode(const void *data, uint32_t num_samples, unsigned int bits_per_sample,
+        double threshold_dBFS=kSilence_dBFS)
+{
+    assert( (bits_per_sample == 8) || (bits_per_sample == 16) );
+    const int threshold = SilenceThreshold(threshold_dBFS);
+    const uint8_t *src = (const uint8_t *)data;
+    const unsigned int bytes_per_sample = bits_per_sample / 8;
+    auto is_silent = [&](uint32_t idx) {
+        int val = _SilenceSample16(src, bits_per_sample, idx);
+        return (val >= -threshold) && (val <= threshold);
+    };
+
+    SilenceEncoded result;
+    result.num_runs = 0;
+    result.run_samples = 0;
+
+    uint32_t start = 0;
+    while( (start < num_samples) && is_silent(start) )
+        start++;
+    uint32_t end = num_samples;
+    while( (end > start) && is_silent(end - 1) )
+        end--;
+    result.lead_trimmed = start;
+    result.tail_trimmed = num_samples - end;
+    result.num_samples = end - start;
+
+    uint32_t literal_start = start;
+    auto flush_literals = [&](uint32_t literal_end) {
+        while( literal_start < literal_end )
+        {
+            uint32_t n = literal_end - literal_start;
+            if( n > kSilenceMaxRecord )
+                n = kSilenceMaxRecord;
+            _SilencePutHeader(result.data, (uint16_t)n);
+            result.data.insert(result.data.end(), src + literal_start * bytes_per_sample,
+                    src + (literal_start + n) * bytes_per_sample);
+            literal_start += n;
+        }
+    };
+
+    uint32_t pos = start;
+    while( pos < end )
+    {
+        if( !is_silent(pos) )
+        {
+            pos++;
+            continue;
+        }
+        uint32_t run_end = pos;
+        int64_t sum = 0;
+        while( (run_end < end) && is_silent(run_end) )
+            sum += _SilenceSample16(src, bits_per_sample, run_end++);
+        if( run_end - pos < kSilenceMinRun )
+        {
+            pos = run_end;
+            continue;
+        }
+
+        flush_literals(pos);
+        int16_t mean = (int16_t)(sum / (int64_t)(run_end - pos));
+        for( uint32_t run_pos=pos; run_pos<run_end; )
+        {
+            uint32_t n = run_end - run_pos;
+            if( n > kSilenceMaxRecord )
+                n = kSilenceMaxRecord;
+            _SilencePutHeader(result.data, (uint16_t)n | kSilenceRunFlag);
+            if( bits_per_sample == 8 )
+            {
+                result.data.push_back(ConvertSampleTo8Bit(mean));
+            }
+            else
+            {
+                result.data.push_back((uint8_t)(mean & 0xff));
+                result.data.push_back((uint8_t)((uint16_t)mean >> 8));
+            }
+            run_pos += n;
+            result.num_runs++;
+        }
+        result.run_samples += run_end - pos;
+        pos = run_end;
+        literal_start = pos;
+    }
+    flush_literals(end);
+    return result;
+}
+
+//-----------------------------------
+// Decoder
+class SilenceSource : public ISampleSource
+{
+public:
+    SilenceSource(const void *data=nullptr, uint32_t num_bytes=0, uint32_t num_samples=0, unsigned int bits_per_sample=8)
+    {
+        SetData(data, num_bytes, num_samples, bits_per_sample);
+    }
+
+    void SetData(const void *data, uint32_t num_bytes, uint32_t num_samples, unsigned int bits_per_sample)
+    {
+        assert( (bits_per_sample == 8) || (bits_per_sample == 16) );
+        data_ = (const uint8_t *)data;
+        num_bytes_ = num_bytes;
+        num_samples_ = num_samples;
+        bytes_per_sample_ = bits_per_sample / 8;
+        assert( (data_ != nullptr) || (num_samples_ == 0) );
+        Restart();
+    }
+
+    // ISampleSource Interface overrides begin {
+
+    unsigned int Read(int16_t *out, unsigned int num_samples) override
+    {
+        unsigned int produced = 0;
+        while( (produced < num_samples) && (pos_ < num_samples_) )
+        {
+            if( (record_left_ == 0) && !_NextRecord() )
+                break;
+
+            unsigned int n = record_left_;
+            if( n > num_samples - produced )
+                n = num_samples - produced;
+            if( run_ )
+            {
+                for( unsigned int i=0; i<n; i++ )
+                    out[produced + i] = run_value_;
+            }
+            else if( bytes_per_sample_ == 1 )
+            {
+                ConvertRun(data_ + src_pos_, out + produced, n);
+                src_pos_ += n;
+            }
+            else
+            {
+                memcpy(out + produced, data_ + src_pos_, n * sizeof(int16_t));
+                src_pos_ += n * sizeof(int16_t);
+            }
+            produced += n;
+            pos_ += n;
+            record_left_ -= n;
+        }
+        return produced;
+    }
+
+    void Restart() override
+    {
+        src_pos_ = 0;
+        pos_ = 0;
+        record_left_ = 0;
+        run_ = false;
+    }
+
+    // ISampleSource Interface overrides end }
+
+    uint32_t GetPos() const
+    {
+        return pos_;
+    }
+
+private:
+    // Read the next record header (& run value)
+    // - returns false at the end of the data, or on a corrupt record
+    bool _NextRecord()
+    {
+        if( src_pos_ + 2 > num_bytes_ )
+            return false;
+        uint16_t header = data_[src_pos_] | (data_[src_pos_ + 1] << 8);
+        src_pos_ += 2;
+        uint32_t count = header & ~kSilenceRunFlag;
+        run_ = (header & kSilenceRunFlag) != 0;
+        uint32_t payload_len = (run_ ? 1 : count) * bytes_per_sample_;
+        if( (count == 0) || (src_pos_ + payload_len > num_bytes_) )
+        {
+            assert(false);  // corrupt clip data
+            src_pos_ = num_bytes_;
+            return false;
+        }
+        if( run_ )
+        {
+            if( bytes_per_sample_ == 1 )
+                run_value_ = ConvertSampleTo16Bit(data_[src_pos_]);
+            else
+                memcpy(&run_value_, data_ + src_pos_, sizeof(run_value_));
+            src_pos_ += bytes_per_sample_;
+        }
+        record_left_ = count;
+        return true;
+    }
+
+    const uint8_t *data_;
+    uint32_t num_bytes_;
+    uint32_t num_samples_;
+    unsigned int bytes_per_sample_;
+
+    uint32_t src_pos_;          // next record, or within a literal
+    uint32_t pos_;              // next sample
+    uint32_t record_left_;      // samples left in the current record
+    bool run_;
+    int16_t run_value_;
+};
+
+// vim: sw=4:ts=4
@@ -0,0 +1,119 @@
+// Sliding-window min/max
+// - max & min of the last window_len samples pushed, each sample pushed once, O(1) amortized per
+// push (at most one deque insert & removal per sample, per deque)
+// - monotonic deques of (index, value): the max deque holds decreasing values, the min deque
+// increasing ones, so the front is always the window's extreme
+// - storage is allocated by ::Reset() only, at most window_len entries per deque
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+#include <vector>
+
+class SlidingExtrema
+{
+public:
+    SlidingExtrema(unsigned int window_len=1)
+    {
+        Reset(window_len);
+    }
+
+    // Empty the window, & set its length
+    void Reset(unsigned int window_len)
+    {
+        assert( window_len > 0 );
+        window_len_ = window_len;
+        max_.Reset(window_len);
+        min_.Reset(window_len);
+        count_ = 0;
+    }
+
+    void Push(int val)
+    {
+        max_.Push(count_, val, window_len_, [](int a, int b) { return a <= b; });
+        min_.Push(count_, val, window_len_, [](int a, int b) { return a >= b; });
+        count_++;
+    }
+
+    // Over the last window_len samples pushed (fewer at the start), must not be empty
+    int GetMax() const
+    {
+        assert( count_ > 0 );
+        return max_.Front();
+    }
+
+    int GetMin() const
+    {
+        assert( count_ > 0 );
+        return min_.Front();
+    }
+
+    // Samples pushed since ::Reset()
+    uint32_t GetCount() const
+    {
+        return count_;
+    }
+
+private:
+    // Ring buffer deque of (index, value)
+    class Deque
+    {
+    public:
+        void Reset(unsigned int capacity)
+        {
+            entries_.resize(capacity);
+            head_ = 0;
+            size_ = 0;
+        }
+
+        // Drop back entries dominated by val, push it, then expire the front
+        template<typename TDominated>
+        void Push(uint32_t idx, int val, unsigned int window_len, TDominated dominated)
+        {
+            unsigned int capacity = entries_.size();
+            while( (size_ > 0) && dominated(entries_[_Pos(size_ - 1, capacity)].val, val) )
+                size_--;
+            if( (size_ > 0) && (idx - entries_[head_].idx >= window_len) )
+            {
+                head_ = _Pos(1, capacity);
+                size_--;
+            }
+            assert( size_ < capacity );
+            Entry & entry = entries_[_Pos(size_, capacity)];
+            entry.idx = idx;
+            entry.val = val;
+            size_++;
+        }
+
+        int Front() const
+        {
+            return entries_[head_].val;
+        }
+
+    private:
+        struct Entry
+        {
+            uint32_t idx;
+            int val;
+        };
+
+        unsigned int _Pos(unsigned int offset, unsigned int capacity) const
+        {
+            unsigned int pos = head_ + offset;
+            return (pos >= capacity) ? pos - capacity : pos;
+        }
+
+        std::vector<Entry> entries_;
+        unsigned int head_;
+        unsigned int size_;
+    };
+
+    unsigned int window_len_;
+    Deque max_;
+    Deque min_;
+    uint32_t count_;
+};
+
+// vim: sw=4:ts=4
@@ -0,0 +1,164 @@
+// VU meter building blocks
+// - SlidingRms: mean square of the last window_len samples, from an exact running sum of squares,
+// O(1) per sample, no rescans
+// - VuDbQ8(): mean square to dBFS, fixed point (1/256 dB), no floating point
+// - VuBallistics: one-pole attack/release smoothing of a dB level, fixed point, once per update
+// (e.g. per visualizer interval)
+// - levels are dBFS re a full-scale square wave (RMS 32768), as Envelope.h's RMS nibble, so a
+// full-scale sine reads -3 dB
+// - no Arduino dependencies
+
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+static const int32_t kVuMinDbQ8 = -96 * 256;        // silence reads as this
+
+// 10 log10(mean_square / 32768^2), in 1/256 dB, kVuMinDbQ8 at most
+// - log2 from the leading bit & a 16-segment table, linearly interpolated (error < 0.01 dB)
+inline int32_t VuDbQ8(uint64_t mean_square)
+{
+    // log2(1 + i/16), Q16
+    static const int32_t kLog2Table[17] = {
+        0, 5732, 11136, 16248, 21098, 25711, 30109, 34312, 38336,
+        42196, 45904, 49472, 52911, 56229, 59434, 62534, 65536
+    };
+    static const int64_t kDbPerOctaveQ16 = 197283;  // 10 log10(2)
+
+    if( mean_square == 0 )
+        return kVuMinDbQ8;
+    int msb = 63 - __builtin_clzll(mean_square);
+    uint32_t mant = (msb >= 16) ? (uint32_t)(mean_square >> (msb - 16)) : (uint32_t)(mean_square << (16 - msb));
+    unsigned int seg = (mant >> 12) & 15;
+    int32_t frac = mant & 0xfff;
+    int32_t log2_q16 = (msb << 16) + kLog2Table[seg] + (((kLog2Table[seg + 1] - kLog2Table[seg]) * frac) >> 12);
+
+    // 32768^2 == 2^30
+    int32_t db_q8 = (int32_t)(((int64_t)(log2_q16 - (30 << 16)) * kDbPerOctaveQ16) >> 24);
+    return (db_q8 < kVuMinDbQ8) ? kVuMinDbQ8 : db_q8;
+}
+
+class SlidingRms
+{
+public:
+    SlidingRms(unsigned int window_len=1)
+    {
+        Reset(window_len);
+    }
+
+    // Empty (silent) window, & set its length
+    void Reset(unsigned int window_len)
+    {
+        assert( window_len > 0 );
+        window_len_ = window_len;
+        sum_sq_ = 0;
+    }
+
+    // val: the new sample, out_val: the one leaving the window (window_len samples ago, 0 if none)
+    // - samples are signed 16-bit scale
+    void Push(int val, int out_val)
+    {
+        sum_sq_ += (uint64_t)((int64_t)val * val);
+        uint64_t out_sq = (uint64_t)((int64_t)out_val * out_val);
+        assert( out_sq <= sum_sq_ );
+        sum_sq_ -= out_sq;
+    }
+
+    uint64_t GetSumSquares() const
+    {
+        return sum_sq_;
+    }
+
+    // Over the whole window, samples before the first pushed count as silence
+    uint64_t GetMeanSquare() const
+    {
+        return sum_sq_ / window_len_;
+    }
+
+    int32_t GetDbQ8() const
+    {
+        return VuDbQ8(GetMeanSquare());
+    }
+
+private:
+    unsigned int window_len_;
+    uint64_t sum_sq_;
+};
+
+class VuBallistics
+{
+public:
+    VuBallistics()
+    {
+        Reset(0.01f, 0.3f, 0.025f);
+    }
+
+    // Time constants & the interval between ::Update() calls, in seconds
+    // - the level rises towards louder input with the attack time constant, falls with the release
+    void Reset(float attack_s, float release_s, float update_period_s)
+    {
+        assert( (attack_s >= 0.0f) && (release_s >= 0.0f) && (update_period_s > 0.0f) );
+        attack_coeff_ = _Coeff(attack_s, update_period_s);
+        release_coeff_ = _Coeff(release_s, update_period_s);
+        level_ = kVuMinDbQ8;
+    }
+
+    // Returns the smoothed level, 1/256 dB
+    int32_t Update(int32_t db_q8)
+    {
+        int32_t coeff = (db_q8 > level_) ? attack_coeff_ : release_coeff_;
+        level_ += (int32_t)(((int64_t)(db_q8 - level_) * coeff) >> 15);
+        return level_;
+    }
+
+    int32_t GetLevel() const
+    {
+        return level_;
+    }
+
+    // Q15 step fractions, for reference models
+    int32_t GetAttackCoeff() const
+    {
+        return attack_coeff_;
+    }
+
+    int32_t GetReleaseCoeff() const
+    {
+        return release_coeff_;
+    }
+
+private:
+    // 1 - e^(-T/tau), Q15
+    static int32_t _Coeff(float tau_s, float update_period_s)
+    {
+        if( tau_s <= 0.0f )
+            return 1 << 15;
+        return (int32_t)((1.0f - expf(-update_period_s / tau_s)) * 32768.0f + 0.5f);
+    }
+
+    int32_t attack_coeff_;
+    int32_t release_coeff_;
+    int32_t level_;
+};
+
+// Bar level in [0, num_levels-1] for a dB level, in 1/256 levels
+// - level 1 at -range_dB, then equal dB steps up to num_levels-1 at -range_dB/(num_levels-1) & above
+inline unsigned int VuLevelQ8(int32_t db_q8, unsigned int num_levels, unsigned int range_dB)
+{
+    assert( num_levels > 1 );
+    int32_t above = db_q8 + (int32_t)range_dB * 256;
+    if( above < 0 )
+        return 0;
+    unsigned int step_q8 = range_dB * 256 / (num_levels - 1);
+    unsigned int level_q8 = 256 + (unsigned int)above * 256 / step_q8;
+    return (level_q8 < (num_levels - 1) * 256) ? level_q8 : (num_levels - 1) * 256;
+}
+
+inline unsigned int VuLevel(int32_t db_q8, unsigned int num_levels, unsigned int range_dB)
+{
+    return VuLevelQ8(db_q8, num_levels, range_dB) >> 8;
+}
+
+// vim: sw=4:ts=4
@@ -35,10 +35,16 @@ SPKR   ▽     │      ┌───║BYPASS        IN-║
              │      │   ║        ◯        ║            ▽
              ▽      ▽   ╚═════════════════╝        
 
-- Two options:
+- Four options:
+    DacDMA - I2S DMA-based driver (need to call ::loop() at least once per DMA buffer)
+        - built-in DAC fed via the I2S peripheral, CPU only involved for block refills
     DacT - timer-based driver
         - good up to about 16 kHz (w/ either 8/16 bit data buffer)
             - beyond that, playback seems slowed down, guessing it's a limitation of the timer rate
+                - Ticker dispatches via the esp_timer task, so each sample costs a context switch
+    DacTI - hardware timer ISR-based driver
+        - same as DacT but samples written directly from an IRAM-resident ISR
+        - intended to reach 32-44.1 kHz, use ::GetStats() to check ISR cost & jitter headroom
     Dac  - polling-based driver (need to regularly call ::loop())
         - good up to about 22 kHz (w/ 8 bit data buffer) before hear slow down
             - hear pops at all rates though -- seems to be caused by serial prints
@@ -66,16 +72,17 @@ See: https://github.com/earlephilhower/ESP8266Audio/#software-i2s-delta-sigma-da
         I2SOut ────────R─────────┘     │      SPKR 
   (from ESP DevKit)    1k            5V,VIN            
 
-- One option:
+- Two options:
     DacDS  - polling-based driver (need to regularly call ::loop())
         - good all the way up to 44.1 kHz (w/ 8 bit data buffer)
         - good all the way up to 44.1 kHz (w/ 16 bit data buffer)
             - lower samplerates sound both noisy and distorted in the high freqs
             - starts to sound decent @ 24 kHz, but even so the steps to 32 kHz and then 44.1 kHz both easy to discern improved sound quality
+    DacDSTask - task-based driver (no need to call ::loop())
+        - same output as DacDS, driven from its own FreeRTOS task pinned to a core
+        - slow work in loop() no longer starves audio
 
 - TODO: characterize sound-quality 8-bit vs 16-bit
-- TODO: implement ticker-based implementation
-    - based on experience with Dac & DacT, seems like ticker won't be able to support higher samplerates
 
 */
 
@@ -85,6 +92,7 @@ See: https://github.com/earlephilhower/ESP8266Audio/#software-i2s-delta-sigma-da
 #include "../../SerialLog/include/SerialLog.h"
 #include "../../LoopTimer/include/LoopTimer.h"
 #include "../../Switch/include/Switch.h"
+#include <type_traits>
 
 
 // Test function for:
@@ -143,13 +151,26 @@ void DacRamp()
 // TODO: create this test mode also
 //#define TEST_MODE_CYCLE_BITDEPTHS
 
+// Samplerate variants for the TEST_MODE_CYCLE_*_SAMPRATES modes
+// - 0: stored .dat variants, one per samplerate & bit depth (14 copies of the same recording)
+// - 1: one 44.1 kHz/16-bit master, the requested samplerate & bit depth generated on each button
+// press by the Resampler (16-tap, scaled up by the decimation factor when downsampling, so the
+// lower rates are filtered rather than aliased) and SampleConverter (TPDF dither to 8-bit)
+//  - rendered into a reusable work buffer, which the DAC then plays as usual (visualized)
+//  - if the variant won't fit in the heap, it's streamed instead: the DAC plays straight from
+//  the Resampler (not visualized, and not for DacTI, which plays data buffers only)
+#define GENERATE_VARIANTS (1)
+
 
 // Pick DAC variant to use
 // - only define one
-// - use of Dac or DacT will default to DAC1 pin output
+// - use of Dac, DacDMA, DacT or DacTI will default to DAC1 pin output
 
 //#define DAC DacDS
+//#define DAC DacDSTask
+//#define DAC DacDMA
 //#define DAC DacT
+//#define DAC DacTI
 #define DAC Dac
 
 
@@ -165,6 +186,11 @@ void DacRamp()
 const uint16_t viola4416Buf[] = {
 #  include "data/viola.44.16.dat"
 };
+
+#if GENERATE_VARIANTS
+const unsigned int kMasterSamplerate = 44100;
+const unsigned int kMasterLen = sizeof(viola4416Buf)/2;
+#else
 const uint8_t viola4408Buf[] = {
 #  include "data/viola.44.08.dat"
 };
@@ -251,6 +277,7 @@ const int buf_lens_16[] = {
     sizeof(viola3216Buf)/2,
     sizeof(viola4416Buf)/2
 };
+#endif
 
 const unsigned int samplerates[] = {
      8000,
@@ -263,11 +290,13 @@ const unsigned int samplerates[] = {
 };
 
 #define NUM_SAMPRATES (sizeof(samplerates)/sizeof(samplerates[0])) 
+#if !GENERATE_VARIANTS
 #define NUM_BUFS08    (sizeof(samplerate_bufs_08)/sizeof(samplerate_bufs_08[0]))
 #define NUM_BUFS16    (sizeof(samplerate_bufs_16)/sizeof(samplerate_bufs_16[0]))
 
 static_assert( NUM_SAMPRATES == NUM_BUFS08, "Number of items should match" );
 static_assert( NUM_SAMPRATES == NUM_BUFS16, "Number of items should match" );
+#endif
 
 
 LoopTimer loop_timer;
@@ -281,7 +310,148 @@ void setup()
     SerialLog::Log(__FILE__);
 }
 
-#if defined TEST_MODE_CYCLE_8B_SAMPRATES || defined TEST_MODE_CYCLE_16B_SAMPRATES 
+#if GENERATE_VARIANTS
+//-----------------------------------
+// Variant generation from the master
+// - master -> Resampler -> (8-bit: dithered to 8-bit & back), as a sample source, so the same
+// chain either fills the work buffer or is played directly
+
+class VariantSource : public ISampleSource
+{
+public:
+    VariantSource()
+        : master_(viola4416Buf, kMasterLen, 16)
+        , converter_(ConvertMode::Dither)
+    {
+    }
+
+    void Configure(unsigned int samplerate, unsigned int bit_depth)
+    {
+        bit_depth_ = bit_depth;
+        master_.Restart();
+        resampler_.Configure(&master_, kMasterSamplerate, samplerate, ResampleQuality::Taps16);
+        converter_.Reset();
+    }
+
+    // Variant length, allowing for the filter tail
+    // - the Resampler stops at the last source sample's position, so that's 1 more than the scaled
+    // length whatever the filter length; the rest is margin
+    static unsigned int GetMaxLen(unsigned int samplerate)
+    {
+        return (unsigned int)((uint64_t)kMasterLen * samplerate / kMasterSamplerate) + 16;
+    }
+
+    // ISampleSource Interface overrides begin {
+
+    unsigned int Read(int16_t *out, unsigned int num_samples) override
+    {
+        unsigned int n = resampler_.Read(out, num_samples);
+        if( bit_depth_ == 8 )
+        {
+            // quantize in chunks, as IDac::Render() does
+            for( unsigned int pos=0; pos<n; pos+=kChunkLen )
+            {
+                uint8_t chunk[kChunkLen];
+                unsigned int len = (n - pos < kChunkLen) ? n - pos : kChunkLen;
+                converter_.Convert(out + pos, chunk, len);
+                ConvertRun(chunk, out + pos, len);
+            }
+        }
+        return n;
+    }
+
+    void Restart() override
+    {
+        resampler_.Restart();
+        converter_.Reset();
+    }
+
+    // ISampleSource Interface overrides end }
+
+private:
+    static const unsigned int kChunkLen = 64;
+
+    BufferSource master_;
+    Resampler resampler_;
+    SampleConverter converter_;
+    unsigned int bit_depth_ = 16;
+};
+
+VariantSource variant_source;
+void *work_buf = nullptr;
+size_t work_buf_size = 0;
+const bool kDacPlaysSources = !std::is_same<DAC, DacTI>::value;
+
+// Generate the variant into the work buffer
+// - returns nullptr if the work buffer can't be grown to fit
+const void * RenderVariant( unsigned int samplerate, unsigned int bit_depth, unsigned int &buf_len )
+{
+    size_t size = VariantSource::GetMaxLen(samplerate) * (bit_depth / 8);
+    if( size > work_buf_size )
+    {
+        // free first, so the old buffer doesn't fragment the heap for the new one
+        free(work_buf);
+        work_buf = malloc(size);
+        work_buf_size = (work_buf != nullptr) ? size : 0;
+        if( work_buf == nullptr )
+            return nullptr;
+    }
+
+    variant_source.Configure(samplerate, bit_depth);
+    unsigned int max_len = work_buf_size / (bit_depth / 8);
+    buf_len = 0;
+    uint32_t start_ms = millis();
+    while( buf_len < max_len )
+    {
+        int16_t chunk[64];
+        unsigned int n = (max_len - buf_len < 64) ? max_len - buf_len : 64;
+        n = variant_source.Read(chunk, n);
+        if( n == 0 )
+            break;
+        if( bit_depth == 16 )
+            memcpy((int16_t *)work_buf + buf_len, chunk, n * sizeof(int16_t));
+        else
+            ConvertRun(chunk, (uint8_t *)work_buf + buf_len, n);  // exact, already quantized to 8-bit
+        buf_len += n;
+    }
+    SerialLog::Log( "generated variant in " + String(millis() - start_ms) + " ms" );
+    return work_buf;
+}
+
+// Variant for the next button press
+// - returns nullptr if the variant is to be streamed from variant_source instead
+const void * GetBufParams( unsigned int &samplerate, unsigned int &bit_depth, unsigned int &buf_len )
+{
+    static int index = 9999;    // definitely more than the real number of buffers 
+                                // - so after first increment we'll start at 0
+
+    index++;
+    if( index >= NUM_SAMPRATES )
+        index = 0;
+
+    samplerate = samplerates[index];
+#  if defined TEST_MODE_CYCLE_8B_SAMPRATES
+    bit_depth = 8;
+#  elif defined TEST_MODE_CYCLE_16B_SAMPRATES
+    bit_depth = 16;
+#  endif
+
+    if( (samplerate == kMasterSamplerate) && (bit_depth == 16) )
+    {
+        buf_len = kMasterLen;
+        return viola4416Buf;    // the master itself
+    }
+
+    const void *buf = RenderVariant(samplerate, bit_depth, buf_len);
+    if( buf == nullptr )
+    {
+        SerialLog::Log( "variant too large for the work buffer, streaming" );
+        variant_source.Configure(samplerate, bit_depth);
+        buf_len = 0;
+    }
+    return buf;
+}
+#elif defined TEST_MODE_CYCLE_8B_SAMPRATES || defined TEST_MODE_CYCLE_16B_SAMPRATES 
 const void * GetBufParams( unsigned int &samplerate, unsigned int &bit_depth, unsigned int &buf_len )
 {
     static int index = 9999;    // definitely more than the real number of buffers 
@@ -336,6 +506,7 @@ void loop()
 
     static DAC *dac = nullptr;
     static bool was_high = false;
+    static bool streaming = false;  // playing from a source rather than a data buffer, not visualized
 
     if(button_switch.IsHigh())
     {
@@ -358,12 +529,31 @@ void loop()
             unsigned int buf_len;
             const void *buf = GetBufParams( samplerate, bit_depth, buf_len );  // implementation depends on TEST_MODE_*
             SerialLog::Log( "buf_len: " + String(buf_len) );
-            assert(buf_len > 1000);  // in case the above sizeof isn't doing what I hoped...
 
             // create new dac instance to play the buffer
             assert( dac == nullptr );
-            dac = GetDac(samplerate, kLooped, buf, buf_len, bit_depth);  // implementation depends on USE_DAC*
-            viz.Reset(dac);
+#if GENERATE_VARIANTS
+            streaming = (buf == nullptr);
+            if( streaming )
+            {
+                if( kDacPlaysSources )
+                {
+                    dac = GetDac(samplerate, kLooped, nullptr, 0, bit_depth);
+                    dac->SetSource(&variant_source);
+                    dac->Restart();
+                }
+                else
+                {
+                    SerialLog::Log( "DAC can't stream, skipped" );
+                }
+            }
+            else
+#endif
+            {
+                assert(buf_len > 1000);  // in case the above sizeof isn't doing what I hoped...
+                dac = GetDac(samplerate, kLooped, buf, buf_len, bit_depth);  // implementation depends on USE_DAC*
+                viz.Reset(dac);
+            }
             SerialLog::Log( "Set samplerate/bit_depth: " + String(samplerate) + "/" + String(bit_depth));
 
             was_high = false;
@@ -372,7 +562,8 @@ void loop()
         if( dac )
         {
             dac->Loop();
-            viz.Loop();
+            if( !streaming )
+                viz.Loop();
         }
     }
 
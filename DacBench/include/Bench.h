@@ -0,0 +1,84 @@
+// Benchmark helpers
+// - thin portability layer so the same benchmarks run on target (esp32) and on the host (native)
+// - on target, also reports CPU cycles per sample
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#ifdef ARDUINO
+#   include <Arduino.h>
+#   include "../../SerialLog/include/SerialLog.h"
+#else
+#   include <chrono>
+#endif
+
+// Elapsed time in micro secs
+inline uint32_t BenchMicros()
+{
+#ifdef ARDUINO
+    return micros();
+#else
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// CPU cycle counter
+// - only meaningful on target, wraps every ~18 s @ 240 MHz so keep runs short
+inline uint32_t BenchCycles()
+{
+#ifdef ARDUINO
+    return ESP.getCycleCount();
+#else
+    return 0;
+#endif
+}
+
+inline void BenchLog(const char *format, ...)
+{
+    char msg[160];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(msg, sizeof(msg), format, args);
+    va_end(args);
+#ifdef ARDUINO
+    SerialLog::Log(msg);
+#else
+    printf("%s\n", msg);
+#endif
+}
+
+// Stores to here keep the optimizer from discarding benchmarked work
+volatile uint32_t bench_sink;
+
+// Time reps calls of fn, each of which processes samples_per_call samples
+// - returns ns per sample
+template<typename TFn>
+double BenchRun(const char *name, unsigned int reps, unsigned int samples_per_call, TFn fn)
+{
+    fn();   // warm-up, e.g. flash cache
+
+    uint32_t start_cycles = BenchCycles();
+    uint32_t start_us = BenchMicros();
+    for( unsigned int i=0; i<reps; i++ )
+    {
+        fn();
+    }
+    uint32_t elapsed_us = BenchMicros() - start_us;
+    uint32_t elapsed_cycles = BenchCycles() - start_cycles;
+
+    double num_samples = (double)reps * samples_per_call;
+    double ns_per_sample = elapsed_us * 1000.0 / num_samples;
+#ifdef ARDUINO
+    BenchLog("%-36s %8.1f ns/sample %8.1f cycles/sample", name, ns_per_sample, elapsed_cycles / num_samples);
+#else
+    (void)elapsed_cycles;
+    BenchLog("%-36s %8.1f ns/sample %8.2f Msamples/s", name, ns_per_sample, 1000.0 / ns_per_sample);
+#endif
+    return ns_per_sample;
+}
+
+// vim: sw=4:ts=4
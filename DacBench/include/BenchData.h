@@ -0,0 +1,62 @@
+// Audio data used by the benchmarks
+// - the viola clip & a couple of speech clips, straight from the sketch data files
+
+#pragma once
+
+#include <stdint.h>
+
+const uint16_t viola4416Buf[] = {
+#   include "../../DAC/src/data/viola.44.16.dat"
+};
+const uint8_t viola4408Buf[] = {
+#   include "../../DAC/src/data/viola.44.08.dat"
+};
+
+const unsigned int kViola44Len16 = sizeof(viola4416Buf)/2;
+const unsigned int kViola44Len08 = sizeof(viola4408Buf)/1;
+
+// 16-bit reference rates, for resampler quality comparison
+const uint16_t viola3216Buf[] = {
+#   include "../../DAC/src/data/viola.32.16.dat"
+};
+const uint16_t viola2416Buf[] = {
+#   include "../../DAC/src/data/viola.24.16.dat"
+};
+const uint16_t viola2216Buf[] = {
+#   include "../../DAC/src/data/viola.22.16.dat"
+};
+const uint16_t viola1616Buf[] = {
+#   include "../../DAC/src/data/viola.16.16.dat"
+};
+const uint16_t viola1216Buf[] = {
+#   include "../../DAC/src/data/viola.12.16.dat"
+};
+const uint16_t viola0816Buf[] = {
+#   include "../../DAC/src/data/viola.08.16.dat"
+};
+
+struct ViolaRef
+{
+    unsigned int samplerate;
+    const uint16_t *buffer;
+    unsigned int len;
+};
+const ViolaRef kViolaRefs[] = {
+    { 32000, viola3216Buf, sizeof(viola3216Buf)/2 },
+    { 24000, viola2416Buf, sizeof(viola2416Buf)/2 },
+    { 22050, viola2216Buf, sizeof(viola2216Buf)/2 },
+    { 16000, viola1616Buf, sizeof(viola1616Buf)/2 },
+    { 12000, viola1216Buf, sizeof(viola1216Buf)/2 },
+    {  8000, viola0816Buf, sizeof(viola0816Buf)/2 },
+};
+
+// 8 kHz 8-bit speech clips, from the Player sketch
+// - long near-silent stretches, for the lossless compression benchmarks
+const uint8_t gameOverManBuf[] = {
+#   include "../../Player/src/data/gameOverMan.dat"
+};
+const uint8_t surelyShirleyBuf[] = {
+#   include "../../Player/src/data/surelyShirley.dat"
+};
+
+// vim: sw=4:ts=4
@@ -0,0 +1,2240 @@
+// DacBench
+// - benchmarks for the DAC audio-path building blocks
+// - runs once from setup(), results are logged
+// - builds for target (esp32) and for the host (native), see platformio.ini
+//  - only the Arduino-independent DAC headers can be benchmarked on the host
+
+#include "Bench.h"
+#include "BenchData.h"
+#include "../../DAC/include/DacRender.h"
+#include "../../DAC/include/SampleRing.h"
+#include "../../DAC/include/DmaFiller.h"
+#include "../../DAC/include/SampleClock.h"
+#include "../../DAC/include/SampleConvert.h"
+#include "../../DAC/include/Resampler.h"
+#include "../../DAC/include/Mixer.h"
+#include "../../DAC/include/AssetBank.h"
+#include "../../DAC/include/AssetBankWriter.h"
+#include "../../DAC/include/Adpcm.h"
+#include "../../DAC/include/Companding.h"
+#include "../../DAC/include/Lz.h"
+#include "../../DAC/include/Silence.h"
+#include "../../DAC/include/ClipSource.h"
+#include "../../DAC/include/ClipView.h"
+#include "../../DAC/include/ClipCache.h"
+#include "../../DAC/include/Envelope.h"
+#include "../../DAC/include/SlidingExtrema.h"
+#include "../../DAC/include/VuMeter.h"
+#include "../../DAC/include/FixedFft.h"
+#include "../../GpioOut/include/GpioOut.h"
+#include "../../GpioOut/include/LedcOut.h"
+#include <thread>
+#include <type_traits>
+#include <math.h>
+
+#ifdef ARDUINO
+// NOTE: next include needed for Dac.h, see note in DAC/include/Dac.h
+#   include <AudioOutputI2SNoDAC.h>
+#   include "../../DAC/include/Dac.h"
+#endif
+
+// ClipView: const arrays only, non-const arrays (DRAM) & bare pointers must not compile
+static_assert( std::is_constructible<ClipView, const uint8_t (&)[16], unsigned int>::value, "ClipView from const 8-bit array" );
+static_assert( std::is_constructible<ClipView, const uint16_t (&)[16], unsigned int>::value, "ClipView from const 16-bit array" );
+static_assert( !std::is_constructible<ClipView, uint8_t (&)[16], unsigned int>::value, "ClipView from non-const array" );
+static_assert( !std::is_constructible<ClipView, int16_t (&)[16], unsigned int>::value, "ClipView from non-const array" );
+static_assert( !std::is_constructible<ClipView, const uint8_t *, unsigned int>::value, "ClipView from pointer" );
+
+//-----------------------------------------------------------------
+// Per-sample vs. block render path
+
+// Reference per-sample path, as previously used by Dac::Loop() & DacT::_Loop() (minus the dacWrite)
+// - fetches, converts and wraps one sample per call
+struct PerSampleRender
+{
+    const void *buffer;
+    unsigned int buffer_len;
+    unsigned int bits_per_sample;
+    bool looped;
+    unsigned int buffer_pos;
+    bool done;
+
+    uint8_t Next()
+    {
+        uint8_t sample_val;
+        if( bits_per_sample == 8 )
+        {
+            const uint8_t *buf = (const uint8_t*)buffer;
+            sample_val = buf[buffer_pos];
+        }
+        else
+        {
+            const int16_t *buf = (const int16_t*)buffer;
+            sample_val = ConvertSampleTo8Bit(buf[buffer_pos]);
+        }
+        buffer_pos++;
+        if( buffer_pos >= buffer_len )
+        {
+            if( looped )
+                buffer_pos = 0;
+            else
+                done = true;
+        }
+        return sample_val;
+    }
+};
+
+void BenchBlockRender()
+{
+    BenchLog("--- Per-sample vs. block render (8-bit output) ---");
+
+    const unsigned int kSamplesPerCall = 4096;
+    const unsigned int kReps = 256;
+    const unsigned int kBlockLen = 32;  // as used by Dac & DacT
+
+    struct Source
+    {
+        const char *name;
+        const void *buffer;
+        unsigned int buffer_len;
+        unsigned int bits_per_sample;
+    };
+    const Source sources[] = {
+        { "8-bit",  viola4408Buf, kViola44Len08, 8 },
+        { "16-bit", viola4416Buf, kViola44Len16, 16 },
+    };
+
+    for( const Source & src : sources )
+    {
+        char name[48];
+
+        PerSampleRender ref = { src.buffer, src.buffer_len, src.bits_per_sample, true, 0, false };
+        snprintf(name, sizeof(name), "per-sample %s", src.name);
+        BenchRun(name, kReps, kSamplesPerCall, [&]()
+        {
+            for( unsigned int i=0; i<kSamplesPerCall; i++ )
+            {
+                bench_sink = ref.Next();
+            }
+        });
+
+        unsigned int pos = 0;
+        bool done = false;
+        snprintf(name, sizeof(name), "block(%u) %s", kBlockLen, src.name);
+        BenchRun(name, kReps, kSamplesPerCall, [&]()
+        {
+            uint8_t block[kBlockLen];
+            for( unsigned int i=0; i<kSamplesPerCall; i+=kBlockLen )
+            {
+                unsigned int n = RenderBlock(src.buffer, src.buffer_len, src.bits_per_sample, true, pos, done, block, kBlockLen);
+                for( unsigned int j=0; j<n; j++ )
+                {
+                    bench_sink = block[j];
+                }
+            }
+        });
+    }
+}
+
+//-----------------------------------------------------------------
+// Runtime-configured vs. compile-time specialized per-sample path
+
+#ifdef ARDUINO
+// Expose the timer callbacks so they can be called directly
+// - very low samplerate so the real Ticker callbacks stay out of the way
+struct BenchDacT : public DacT
+{
+    BenchDacT(const void *buffer, unsigned int buffer_len, unsigned int bits_per_sample)
+        : DacT(1, true, buffer, buffer_len, bits_per_sample) {}
+    void Tick() { _Loop(this); }
+};
+
+template<typename TSample>
+struct BenchStaticDacT : public StaticDacT<TSample, Looped::Yes>
+{
+    BenchStaticDacT(const TSample *buffer, unsigned int buffer_len)
+        : StaticDacT<TSample, Looped::Yes>(1, buffer, buffer_len) {}
+    void Tick() { StaticDacT<TSample, Looped::Yes>::_Loop(this); }
+};
+#endif
+
+void BenchStaticDac()
+{
+    BenchLog("--- Runtime vs. compile-time specialized, per sample ---");
+
+    const unsigned int kSamplesPerCall = 4096;
+    const unsigned int kReps = 256;
+    const int16_t *viola16 = (const int16_t *)viola4416Buf;
+
+    // sample fetch & conversion only (host & target)
+    PerSampleRender ref08 = { viola4408Buf, kViola44Len08, 8, true, 0, false };
+    BenchRun("fetch runtime 8-bit", kReps, kSamplesPerCall, [&]()
+    {
+        for( unsigned int i=0; i<kSamplesPerCall; i++ )
+            bench_sink = ref08.Next();
+    });
+    unsigned int pos = 0;
+    bool done = false;
+    BenchRun("fetch static<uint8_t, Looped::Yes>", kReps, kSamplesPerCall, [&]()
+    {
+        for( unsigned int i=0; i<kSamplesPerCall; i++ )
+            bench_sink = ConvertSampleTo8Bit(NextSample<uint8_t, Looped::Yes>(viola4408Buf, kViola44Len08, pos, done));
+    });
+
+    PerSampleRender ref16 = { viola4416Buf, kViola44Len16, 16, true, 0, false };
+    BenchRun("fetch runtime 16-bit", kReps, kSamplesPerCall, [&]()
+    {
+        for( unsigned int i=0; i<kSamplesPerCall; i++ )
+            bench_sink = ref16.Next();
+    });
+    pos = 0;
+    BenchRun("fetch static<int16_t, Looped::Yes>", kReps, kSamplesPerCall, [&]()
+    {
+        for( unsigned int i=0; i<kSamplesPerCall; i++ )
+            bench_sink = ConvertSampleTo8Bit(NextSample<int16_t, Looped::Yes>(viola16, kViola44Len16, pos, done));
+    });
+
+#ifdef ARDUINO
+    // whole timer callback, including the DAC write (target only)
+    {
+        BenchDacT dac(viola4408Buf, kViola44Len08, 8);
+        BenchRun("DacT::_Loop 8-bit", kReps, kSamplesPerCall, [&]()
+        {
+            for( unsigned int i=0; i<kSamplesPerCall; i++ )
+                dac.Tick();
+        });
+    }
+    {
+        BenchStaticDacT<uint8_t> dac(viola4408Buf, kViola44Len08);
+        BenchRun("StaticDacT<uint8_t>::_Loop", kReps, kSamplesPerCall, [&]()
+        {
+            for( unsigned int i=0; i<kSamplesPerCall; i++ )
+                dac.Tick();
+        });
+    }
+    {
+        BenchDacT dac(viola4416Buf, kViola44Len16, 16);
+        BenchRun("DacT::_Loop 16-bit", kReps, kSamplesPerCall, [&]()
+        {
+            for( unsigned int i=0; i<kSamplesPerCall; i++ )
+                dac.Tick();
+        });
+    }
+    {
+        BenchStaticDacT<int16_t> dac(viola16, kViola44Len16);
+        BenchRun("StaticDacT<int16_t>::_Loop", kReps, kSamplesPerCall, [&]()
+        {
+            for( unsigned int i=0; i<kSamplesPerCall; i++ )
+                dac.Tick();
+        });
+    }
+#endif
+}
+
+//-----------------------------------------------------------------
+// SampleRing throughput & producer/consumer stress
+
+void BenchSampleRing()
+{
+    BenchLog("--- SampleRing ---");
+
+    const unsigned int kSamplesPerCall = 4096;
+    const unsigned int kReps = 256;
+
+    // single thread, bulk push/pop throughput for several chunk sizes
+    SampleRing<uint8_t> ring(1024);
+    const unsigned int chunk_lens[] = { 1, 32, 256 };
+    for( unsigned int chunk_len : chunk_lens )
+    {
+        char name[48];
+        snprintf(name, sizeof(name), "push+pop chunk=%u", chunk_len);
+        BenchRun(name, kReps, kSamplesPerCall, [&]()
+        {
+            uint8_t chunk[256] = {0};
+            for( unsigned int i=0; i<kSamplesPerCall; i+=chunk_len )
+            {
+                if( chunk_len == 1 )
+                {
+                    ring.Push(chunk[0]);
+                    ring.Pop(chunk[0]);
+                }
+                else
+                {
+                    ring.Push(chunk, chunk_len);
+                    ring.Pop(chunk, chunk_len);
+                }
+            }
+            bench_sink = chunk[0];
+        });
+    }
+
+    // producer & consumer threads
+    // - producer pushes an incrementing sequence in varying chunk lengths, consumer pops in
+    // different varying chunk lengths and checks the sequence is intact
+    const uint32_t kStressSamples = 1000000;
+    SampleRing<uint32_t> stress_ring(256);
+    unsigned int num_errors = 0;
+
+    uint32_t start_us = BenchMicros();
+    std::thread producer([&]()
+    {
+        uint32_t chunk[64];
+        uint32_t next = 0;
+        unsigned int chunk_len = 1;
+        while( next < kStressSamples )
+        {
+            unsigned int n = chunk_len;
+            if( n > kStressSamples - next )
+                n = kStressSamples - next;
+            for( unsigned int i=0; i<n; i++ )
+                chunk[i] = next + i;
+            unsigned int pushed = stress_ring.Push(chunk, n);
+            if( pushed == 0 )
+                std::this_thread::yield();
+            next += pushed;
+            chunk_len = (chunk_len % 63) + 1;
+        }
+    });
+    std::thread consumer([&]()
+    {
+        uint32_t chunk[64];
+        uint32_t expected = 0;
+        unsigned int chunk_len = 64;
+        while( expected < kStressSamples )
+        {
+            unsigned int popped = stress_ring.Pop(chunk, chunk_len);
+            if( popped == 0 )
+                std::this_thread::yield();
+            for( unsigned int i=0; i<popped; i++ )
+            {
+                if( chunk[i] != expected )
+                    num_errors++;
+                expected++;
+            }
+            chunk_len = (chunk_len == 1) ? 64 : chunk_len - 1;
+        }
+    });
+    producer.join();
+    consumer.join();
+    uint32_t elapsed_us = BenchMicros() - start_us;
+
+    BenchLog("2-thread stress: %u samples, %u sequence errors, %.2f Msamples/s",
+            (unsigned int)kStressSamples, num_errors, (double)kStressSamples / elapsed_us);
+}
+
+//-----------------------------------------------------------------
+// DmaFiller against a fake DMA sink
+
+// Minimal render source over a PCM buffer, as IDac::Render() does
+struct DmaBufferSource
+{
+    const void *buffer;
+    unsigned int buffer_len;
+    unsigned int bits_per_sample;
+    bool looped;
+    unsigned int buffer_pos;
+    bool done;
+
+    unsigned int Render(uint8_t *out, unsigned int num_samples)
+    {
+        return RenderBlock(buffer, buffer_len, bits_per_sample, looped, buffer_pos, done, out, num_samples);
+    }
+};
+
+// Stand-in for the I2S driver
+// - room for two DMA buffers, the "DMA" drains drain_bytes between fills
+// - checks every frame written carries the expected sample in both slots
+struct FakeDmaSink
+{
+    static const size_t kDmaBufLen = 512;
+    static const size_t kCapacity = 2 * kDmaBufLen * 4;
+
+    size_t queued = 0;
+    DmaBufferSource expected;
+    uint8_t frame[4];
+    unsigned int frame_idx = 0;
+    unsigned int num_frames = 0;
+    unsigned int num_errors = 0;
+
+    size_t Write(const void *data, size_t num_bytes)
+    {
+        size_t n = kCapacity - queued;
+        if( n > num_bytes )
+            n = num_bytes;
+        n &= ~(size_t)3;    // the driver accepts whole frames
+
+        const uint8_t *p = (const uint8_t *)data;
+        for( size_t i=0; i<n; i++ )
+        {
+            frame[frame_idx++] = p[i];
+            if( frame_idx == 4 )
+            {
+                uint8_t sample;
+                if( expected.Render(&sample, 1) == 0 )
+                    sample = ((const uint8_t *)expected.buffer)[expected.buffer_len - 1];
+                if( (frame[1] != sample) || (frame[3] != sample) || (frame[0] != 0) || (frame[2] != 0) )
+                    num_errors++;
+                num_frames++;
+                frame_idx = 0;
+            }
+        }
+        queued += n;
+        return n;
+    }
+
+    void Drain(size_t drain_bytes)
+    {
+        queued = (drain_bytes > queued) ? 0 : queued - drain_bytes;
+    }
+};
+
+void BenchDmaFiller()
+{
+    BenchLog("--- DmaFiller (fake DMA sink) ---");
+
+    DmaBufferSource source = { viola4408Buf, kViola44Len08, 8, false, 0, false };
+    FakeDmaSink sink;
+    sink.expected = source;
+    DmaFiller<DmaBufferSource, FakeDmaSink> filler(source, sink);
+
+    // drain in awkward amounts so fills are partial and straddle blocks
+    const size_t drain_amounts[] = { 4 * 37, 4 * 512, 4 * 1000, 4 * 3 };
+    const unsigned int kReps = 2000;
+    unsigned int drain_idx = 0;
+    size_t total_bytes = 0;
+
+    uint32_t start_us = BenchMicros();
+    for( unsigned int i=0; i<kReps; i++ )
+    {
+        sink.Drain(drain_amounts[drain_idx]);
+        drain_idx = (drain_idx + 1) % (sizeof(drain_amounts)/sizeof(drain_amounts[0]));
+        total_bytes += filler.Fill();
+    }
+    uint32_t elapsed_us = BenchMicros() - start_us;
+
+    unsigned int num_samples = total_bytes / 4;
+    BenchLog("fill: %u frames, %u frame errors, %.1f ns/sample",
+            sink.num_frames, sink.num_errors, elapsed_us * 1000.0 / num_samples);
+}
+
+//-----------------------------------------------------------------
+// SampleClock pitch accuracy against a simulated clock
+
+// Previous polled Dac scheduling, for comparison
+// - truncated interval, phase reset to the poll time, not roll-over safe
+struct LegacyClock
+{
+    uint32_t interval_us;
+    uint32_t prev_us;
+
+    unsigned int Poll(uint32_t now_us)
+    {
+        if( (prev_us == 0) || (now_us >= prev_us + interval_us) )
+        {
+            prev_us = now_us;
+            return 1;
+        }
+        return 0;
+    }
+};
+
+void BenchSampleClock()
+{
+    BenchLog("--- Sample clock, 10 s simulated w/ poll jitter & stalls ---");
+
+    const unsigned int kSimSeconds = 10;
+    const unsigned int samplerates[] = { 8000, 22050, 44100 };
+    // start near the micros() roll-over, so it happens during the simulation
+    const uint32_t kStartUs = 0xffffffffu - 3000000u;
+
+    for( unsigned int samplerate : samplerates )
+    {
+        LegacyClock legacy = { 1000000 / samplerate, 0 };
+        SampleClock emit_clock(samplerate, SampleClock::kEmit, 8);
+        SampleClock drop_clock(samplerate, SampleClock::kDrop, 8);
+        emit_clock.Start(kStartUs);
+        drop_clock.Start(kStartUs);
+
+        uint64_t legacy_count = 0;
+        uint64_t emit_count = 0;
+        uint64_t drop_count = 0;   // emitted + skipped, i.e. position in the buffer
+
+        uint32_t rand_state = 12345;
+        uint64_t elapsed_us = 0;
+        uint64_t next_stall_us = 50000;
+        while( elapsed_us < kSimSeconds * 1000000ull )
+        {
+            // poll every 2..9 us, with a 2 ms stall (e.g. serial print) every 50 ms
+            rand_state = rand_state * 1664525u + 1013904223u;
+            elapsed_us += 2 + (rand_state >> 29);
+            if( elapsed_us >= next_stall_us )
+            {
+                elapsed_us += 2000;
+                next_stall_us += 50000;
+            }
+            uint32_t now_us = kStartUs + (uint32_t)elapsed_us;
+
+            legacy_count += legacy.Poll(now_us);
+            emit_count += emit_clock.Poll(now_us);
+            unsigned int num_skip;
+            drop_count += drop_clock.Poll(now_us, &num_skip);
+            drop_count += num_skip;
+        }
+
+        double expected = (double)samplerate * elapsed_us / 1000000.0;
+        BenchLog("%5u Hz: rate error legacy %+7.3f%%, kEmit %+7.3f%%, kDrop %+7.3f%% (%u dropped)",
+                samplerate,
+                100.0 * (legacy_count - expected) / expected,
+                100.0 * (emit_count - expected) / expected,
+                100.0 * (drop_count - expected) / expected,
+                drop_clock.GetNumDropped());
+    }
+}
+
+//-----------------------------------------------------------------
+// 16->8 bit conversion kernels: throughput & SNR
+
+// Reference per-sample truncation, as previously used by ConvertSampleTo8Bit()
+static void ConvertPerSample(const int16_t *src, uint8_t *dst, unsigned int n)
+{
+    for( unsigned int i=0; i<n; i++ )
+    {
+        int16_t val = src[i] >> 8;
+        val += 128;
+        dst[i] = (uint8_t)val;
+    }
+}
+
+// Signal power over noise power in dB, noise being the 8-bit result (scaled back up) minus the
+// 16-bit source
+// - fc_Hz > 0: noise is first low-pass filtered (windowed-sinc FIR), i.e. only the noise that
+// noise shaping is meant to keep out of the audio band is counted
+static double MeasureSnr(const int16_t *src, const uint8_t *dst, unsigned int n, double fc_Hz, double fs_Hz)
+{
+    const int kNumTaps = 255;
+    double taps[kNumTaps];
+    for( int k=0; k<kNumTaps; k++ )
+    {
+        int m = k - kNumTaps / 2;
+        double sinc = (m == 0) ? 2.0 * fc_Hz / fs_Hz : sin(2.0 * M_PI * fc_Hz / fs_Hz * m) / (M_PI * m);
+        double blackman = 0.42 - 0.5 * cos(2.0 * M_PI * k / (kNumTaps - 1)) + 0.08 * cos(4.0 * M_PI * k / (kNumTaps - 1));
+        taps[k] = sinc * blackman;
+    }
+
+    double history[kNumTaps] = { 0.0 };
+    unsigned int history_idx = 0;
+    double signal_power = 0.0;
+    double noise_power = 0.0;
+    for( unsigned int i=0; i<n; i++ )
+    {
+        double err = ((int)dst[i] - 128) * 256.0 - src[i];
+        if( fc_Hz > 0.0 )
+        {
+            history[history_idx] = err;
+            err = 0.0;
+            for( int k=0; k<kNumTaps; k++ )
+            {
+                err += taps[k] * history[(history_idx + kNumTaps - k) % kNumTaps];
+            }
+            history_idx = (history_idx + 1) % kNumTaps;
+        }
+        signal_power += (double)src[i] * src[i];
+        noise_power += err * err;
+    }
+    return 10.0 * log10(signal_power / noise_power);
+}
+
+void BenchSampleConvert()
+{
+    BenchLog("--- 16->8 bit conversion ---");
+
+    const unsigned int kBlockLen = 4096;
+    const unsigned int kReps = 256;
+    const int16_t *viola = (const int16_t *)viola4416Buf;
+    static uint8_t out[kBlockLen];
+
+    struct Mode
+    {
+        const char *name;
+        ConvertMode mode;
+    };
+    const Mode modes[] = {
+        { "truncate (packed)",  ConvertMode::Truncate },
+        { "TPDF dither",        ConvertMode::Dither },
+        { "noise shape 1st",    ConvertMode::NoiseShape1 },
+        { "noise shape 2nd",    ConvertMode::NoiseShape2 },
+    };
+
+    // throughput
+    // - NOTE: host compilers vectorize both truncate loops, the packed kernel is aimed at the
+    // esp32 (no SIMD), so compare on target
+    BenchRun("truncate (per-sample)", kReps, kBlockLen, [&]() {
+        ConvertPerSample(viola, out, kBlockLen);
+        bench_sink = out[kBlockLen - 1];
+    });
+    for( const Mode & mode : modes )
+    {
+        SampleConverter converter(mode.mode);
+        BenchRun(mode.name, kReps, kBlockLen, [&]() {
+            converter.Convert(viola, out, kBlockLen);
+            bench_sink = out[kBlockLen - 1];
+        });
+    }
+
+    // packed kernel must match per-sample truncation exactly, incl. odd lengths & alignment
+    {
+        static uint8_t ref[kBlockLen];
+        unsigned int num_errors = 0;
+        for( unsigned int ofs=0; ofs<4; ofs++ )
+        {
+            unsigned int n = kBlockLen - 8 + ofs;
+            ConvertPerSample(viola + ofs, ref, n);
+            ConvertTruncatePacked(viola + ofs, out + ofs, n);
+            num_errors += (memcmp(ref, out + ofs, n) != 0);
+        }
+        BenchLog("packed vs. per-sample: %u mismatches", num_errors);
+    }
+
+    // SNR, for the viola clip and a 1 kHz sine @ -6 dBFS
+    // - full band, and in band (noise below 4 kHz)
+    const double kFs = 44100.0;
+    const unsigned int kSineLen = 44100;
+    static int16_t sine[kSineLen];
+    for( unsigned int i=0; i<kSineLen; i++ )
+    {
+        sine[i] = (int16_t)lround(16384.0 * sin(2.0 * M_PI * 1000.0 * i / kFs));
+    }
+
+    struct Signal
+    {
+        const char *name;
+        const int16_t *data;
+        unsigned int len;
+    };
+    const Signal signals[] = {
+        { "viola",  viola,  kViola44Len16 },
+        { "sine",   sine,   kSineLen },
+    };
+
+    uint8_t *converted = (uint8_t *)malloc(kViola44Len16 > kSineLen ? kViola44Len16 : kSineLen);
+    assert(converted);
+    for( const Signal & signal : signals )
+    {
+        for( const Mode & mode : modes )
+        {
+            SampleConverter converter(mode.mode);
+            // convert in blocks, as the DACs do
+            for( unsigned int pos=0; pos<signal.len; pos+=64 )
+            {
+                unsigned int n = (signal.len - pos < 64) ? signal.len - pos : 64;
+                converter.Convert(signal.data + pos, converted + pos, n);
+            }
+            BenchLog("%-6s %-20s SNR %5.1f dB full band, %5.1f dB < 4 kHz", signal.name, mode.name,
+                    MeasureSnr(signal.data, converted, signal.len, 0.0, kFs),
+                    MeasureSnr(signal.data, converted, signal.len, 4000.0, kFs));
+        }
+    }
+    free(converted);
+}
+
+//-----------------------------------------------------------------
+// Resampler: throughput & quality
+
+// SNR of out vs. ref in dB, at the best alignment within +/- max_lag samples
+// - the stored reference rates were made with an external tool, so allow for a small delay offset
+static double AlignedSnr(const int16_t *ref, unsigned int ref_len, const int16_t *out, unsigned int out_len, int max_lag, int *best_lag)
+{
+    double best_snr = -1000.0;
+    unsigned int n = (ref_len < out_len) ? ref_len : out_len;
+    for( int lag=-max_lag; lag<=max_lag; lag++ )
+    {
+        double signal_power = 0.0;
+        double noise_power = 0.0;
+        for( unsigned int i=max_lag; i+max_lag<n; i++ )
+        {
+            double r = ref[i];
+            double err = out[i + lag] - r;
+            signal_power += r * r;
+            noise_power += err * err;
+        }
+        double snr = 10.0 * log10(signal_power / noise_power);
+        if( snr > best_snr )
+        {
+            best_snr = snr;
+            *best_lag = lag;
+        }
+    }
+    return best_snr;
+}
+
+void BenchResampler()
+{
+    BenchLog("--- Resampler ---");
+
+    struct Quality
+    {
+        const char *name;
+        ResampleQuality quality;
+    };
+    const Quality qualities[] = {
+        { "linear", ResampleQuality::Linear },
+        { "8-tap",  ResampleQuality::Taps8 },
+        { "16-tap", ResampleQuality::Taps16 },
+    };
+    const int16_t *viola = (const int16_t *)viola4416Buf;
+
+    // throughput, e.g. SAM's 22050 Hz to 16 kHz, and the viola clip from 44.1 kHz
+    {
+        const unsigned int kBlockLen = 256;
+        const unsigned int kReps = 1024;
+        static int16_t out[kBlockLen];
+        struct Conversion
+        {
+            unsigned int from;
+            unsigned int to;
+        };
+        const Conversion conversions[] = { { 22050, 16000 }, { 44100, 22050 }, { 8000, 44100 } };
+        for( const Conversion & conv : conversions )
+        {
+            for( const Quality & q : qualities )
+            {
+                BufferSource source(viola, kViola44Len16, 16, true /* looped */);
+                Resampler resampler(&source, conv.from, conv.to, q.quality);
+                char name[48];
+                snprintf(name, sizeof(name), "%5u->%5u Hz %s", conv.from, conv.to, q.name);
+                BenchRun(name, kReps, kBlockLen, [&]() {
+                    resampler.Read(out, kBlockLen);
+                    bench_sink = out[kBlockLen - 1];
+                });
+            }
+        }
+    }
+
+    // quality: viola @ 44.1 kHz resampled to each of the stored reference rates
+    // - measures closeness to the stored data, which includes their own filtering; see the sine
+    // measurements below for passband & stopband
+    // - plus the DAC sketch's GENERATE_VARIANTS 8-bit chain, against the same 16-bit references
+    {
+        int16_t *out = (int16_t *)malloc(kViola44Len16 * sizeof(int16_t));
+        assert(out);
+        for( const ViolaRef & ref : kViolaRefs )
+        {
+            char line[192];
+            int len = snprintf(line, sizeof(line), "vs. stored %5u Hz:", ref.samplerate);
+            for( const Quality & q : qualities )
+            {
+                BufferSource source(viola, kViola44Len16, 16);
+                Resampler resampler(&source, 44100, ref.samplerate, q.quality);
+                unsigned int out_len = resampler.Read(out, kViola44Len16);
+                int lag = 0;
+                double snr = AlignedSnr((const int16_t *)ref.buffer, ref.len, out, out_len, 8, &lag);
+                len += snprintf(line + len, sizeof(line) - len, "  %s %5.1f dB (lag %+d)", q.name, snr, lag);
+            }
+
+            // the DAC sketch's 8-bit variant: 16-tap, then dithered to 8-bit & back
+            {
+                BufferSource source(viola, kViola44Len16, 16);
+                Resampler resampler(&source, 44100, ref.samplerate, ResampleQuality::Taps16);
+                unsigned int out_len = resampler.Read(out, kViola44Len16);
+                SampleConverter converter(ConvertMode::Dither);
+                for( unsigned int pos=0; pos<out_len; pos+=64 )
+                {
+                    uint8_t chunk[64];
+                    unsigned int n = (out_len - pos < 64) ? out_len - pos : 64;
+                    converter.Convert(out + pos, chunk, n);
+                    ConvertRun(chunk, out + pos, n);
+                }
+                int lag = 0;
+                double snr = AlignedSnr((const int16_t *)ref.buffer, ref.len, out, out_len, 8, &lag);
+                len += snprintf(line + len, sizeof(line) - len, "  16-tap 8-bit %5.1f dB", snr);
+            }
+            BenchLog("%s", line);
+        }
+        free(out);
+    }
+
+    // quality: SAM's 22050 Hz to 16 kHz, against ideal sines
+    // - 1 kHz: in band, SNR vs. the ideal output
+    // - 10 kHz: above the 8 kHz output Nyquist, should be filtered rather than alias to 6 kHz
+    {
+        const double kFrom = 22050.0;
+        const double kTo = 16000.0;
+        const unsigned int kInLen = 22050;
+        const unsigned int kOutLen = 16000;
+        int16_t *in = (int16_t *)malloc(kInLen * sizeof(int16_t));
+        int16_t *out = (int16_t *)malloc(kOutLen * sizeof(int16_t));
+        assert(in && out);
+        const double freqs[] = { 1000.0, 10000.0 };
+        for( double freq : freqs )
+        {
+            for( unsigned int i=0; i<kInLen; i++ )
+            {
+                in[i] = (int16_t)lround(16384.0 * sin(2.0 * M_PI * freq * i / kFrom));
+            }
+
+            char line[160];
+            int len = snprintf(line, sizeof(line), "sine %5.0f Hz, 22050->16000:", freq);
+            for( const Quality & q : qualities )
+            {
+                BufferSource source(in, kInLen, 16);
+                Resampler resampler(&source, (unsigned int)kFrom, (unsigned int)kTo, q.quality);
+                unsigned int out_len = resampler.Read(out, kOutLen);
+
+                // skip the edges, where the source starts/stops abruptly
+                double signal_power = 0.0;
+                double noise_power = 0.0;
+                for( unsigned int i=64; i+64<out_len; i++ )
+                {
+                    double ideal = (freq < kTo / 2) ? 16384.0 * sin(2.0 * M_PI * freq * i / kTo) : 0.0;
+                    double err = out[i] - ideal;
+                    signal_power += 16384.0 * 16384.0 / 2;
+                    noise_power += err * err;
+                }
+                len += snprintf(line + len, sizeof(line) - len, "  %s %5.1f dB", q.name, 10.0 * log10(signal_power / noise_power));
+            }
+            BenchLog("%s", line);
+        }
+        free(in);
+        free(out);
+    }
+
+    // quality: viola's 44.1 kHz to 8 kHz, gain of sines
+    // - 3 kHz: passband, should be ~0 dB (no droop)
+    // - 5 & 6 kHz: above the 4 kHz output Nyquist, would alias to 3 & 2 kHz, should be well down
+    {
+        const unsigned int kFrom = 44100;
+        const unsigned int kTo = 8000;
+        int16_t *in = (int16_t *)malloc(kFrom * sizeof(int16_t));
+        int16_t *out = (int16_t *)malloc(kTo * sizeof(int16_t));
+        assert(in && out);
+        const double freqs[] = { 3000.0, 5000.0, 6000.0 };
+        for( double freq : freqs )
+        {
+            for( unsigned int i=0; i<kFrom; i++ )
+            {
+                in[i] = (int16_t)lround(16384.0 * sin(2.0 * M_PI * freq * i / kFrom));
+            }
+
+            char line[160];
+            int len = snprintf(line, sizeof(line), "sine %5.0f Hz, 44100->8000 gain:", freq);
+            for( const Quality & q : qualities )
+            {
+                BufferSource source(in, kFrom, 16);
+                Resampler resampler(&source, kFrom, kTo, q.quality);
+                unsigned int out_len = resampler.Read(out, kTo);
+
+                // skip the edges, where the source starts/stops abruptly
+                double power = 0.0;
+                unsigned int count = 0;
+                for( unsigned int i=128; i+128<out_len; i++ )
+                {
+                    power += (double)out[i] * out[i];
+                    count++;
+                }
+                double gain = 10.0 * log10(power / count / (16384.0 * 16384.0 / 2));
+                len += snprintf(line + len, sizeof(line) - len, "  %s %6.1f dB", q.name, gain);
+            }
+            BenchLog("%s", line);
+        }
+        free(in);
+        free(out);
+    }
+}
+
+//-----------------------------------------------------------------
+// Mixer: cost vs. voice count
+
+// Constant-valued source, for checking the mix arithmetic
+struct ConstSource : public ISampleSource
+{
+    int16_t value;
+    unsigned int len;
+    unsigned int pos;
+
+    ConstSource(int16_t value_, unsigned int len_) : value(value_), len(len_), pos(0) {}
+
+    unsigned int Read(int16_t *out, unsigned int num_samples) override
+    {
+        unsigned int n = (len - pos < num_samples) ? len - pos : num_samples;
+        for( unsigned int i=0; i<n; i++ )
+            out[i] = value;
+        pos += n;
+        return n;
+    }
+
+    void Restart() override
+    {
+        pos = 0;
+    }
+};
+
+static void OnBenchVoiceDone(int /* voice */, void *arg)
+{
+    (*(unsigned int *)arg)++;
+}
+
+void BenchMixer()
+{
+    BenchLog("--- Mixer ---");
+
+    const unsigned int kBlockLen = 256;
+    const unsigned int kReps = 1024;
+    static int16_t out[kBlockLen];
+    const int16_t *viola = (const int16_t *)viola4416Buf;
+
+    // cost per output sample, looped 16-bit & 8-bit clips on every voice
+    const unsigned int voice_counts[] = { 0, 1, 2, 4, 8 };
+    for( unsigned int num_voices : voice_counts )
+    {
+        Mixer<8> mixer;
+        BufferSource *sources[8];
+        for( unsigned int v=0; v<num_voices; v++ )
+        {
+            if( v & 1 )
+                sources[v] = new BufferSource(viola4408Buf, kViola44Len08, 8);
+            else
+                sources[v] = new BufferSource(viola + v * 1000, kViola44Len16 - v * 1000, 16);
+            mixer.Play(sources[v], Mixer<8>::kUnityGain / 4, true /* looped */);
+        }
+
+        char name[48];
+        snprintf(name, sizeof(name), "%u voice(s)", num_voices);
+        BenchRun(name, kReps, kBlockLen, [&]() {
+            mixer.Read(out, kBlockLen);
+            bench_sink = out[kBlockLen - 1];
+        });
+
+        for( unsigned int v=0; v<num_voices; v++ )
+            delete sources[v];
+    }
+
+    // arithmetic: saturation, one-shot completion & deferred done-callbacks
+    {
+        Mixer<4> mixer;
+        ConstSource loud_a(30000, 1000);
+        ConstSource loud_b(30000, 1000);
+        ConstSource quiet(-1000, 300);
+        unsigned int num_done = 0;
+        mixer.Play(&loud_a, Mixer<4>::kUnityGain, false, OnBenchVoiceDone, &num_done);
+        mixer.Play(&loud_b, Mixer<4>::kUnityGain, false, OnBenchVoiceDone, &num_done);
+        mixer.Play(&quiet, Mixer<4>::kUnityGain / 2, false, OnBenchVoiceDone, &num_done);
+        bool dup_rejected = (mixer.Play(&quiet, Mixer<4>::kUnityGain, false) < 0);   // already playing
+
+        unsigned int num_errors = 0;
+        unsigned int num_early = 0;    // callbacks from ::Read() rather than ::Loop()
+        for( unsigned int pos=0; pos<1200; pos+=kBlockLen / 4 )
+        {
+            int16_t block[kBlockLen / 4];
+            unsigned int num_done_before = num_done;
+            mixer.Read(block, kBlockLen / 4);
+            num_early += num_done - num_done_before;
+            for( unsigned int i=0; i<kBlockLen / 4; i++ )
+            {
+                unsigned int idx = pos + i;
+                int32_t expected = 0;
+                if( idx < 1000 )
+                    expected += 2 * ((30000 * (int32_t)Mixer<4>::kUnityGain) >> 15);
+                if( idx < 300 )
+                    expected += (-1000 * (int32_t)(Mixer<4>::kUnityGain / 2)) >> 15;
+                if( expected > 32767 )
+                    expected = 32767;
+                num_errors += (block[i] != expected);
+            }
+            mixer.Loop();
+        }
+        BenchLog("mix check: %u sample errors, %u/3 done-callbacks (%u early), %u voices playing, playing source %s",
+                num_errors, num_done, num_early, mixer.GetNumPlaying(), dup_rejected ? "rejected" : "NOT rejected");
+    }
+}
+
+//-----------------------------------------------------------------
+// AssetBank: lookup cost & validation
+
+void BenchAssetBank()
+{
+    BenchLog("--- AssetBank ---");
+
+    // bank of small synthetic clips, so it fits in RAM on target too
+    const unsigned int kNumClips = 256;
+    const unsigned int kClipLen = 200;
+    AssetBankWriter writer;
+    char names[kNumClips][kAssetNameLen];
+    for( unsigned int i=0; i<kNumClips; i++ )
+    {
+        uint8_t data[kClipLen + 1];
+        unsigned int len = kClipLen + (i & 1);  // odd lengths exercise payload alignment
+        for( unsigned int j=0; j<len; j++ )
+            data[j] = (uint8_t)(i + j);
+        snprintf(names[i], kAssetNameLen, "clip_%03u", i);
+        writer.Add(names[i], data, len, len, 8000 + i, 8);
+    }
+    std::vector<uint8_t> image = writer.Build();
+
+    AssetBank bank;
+    bool opened = bank.Open(&image[0], image.size());
+#ifndef ARDUINO
+    // same image through the file mmap path
+    const char *kPath = "/tmp/DacBench.bank";
+    bool written = writer.Write(kPath);
+    AssetBank file_bank;
+    bool file_opened = written && file_bank.OpenFile(kPath);
+    BenchLog("file mmap: %s", file_opened ? "ok" : "FAILED");
+#endif
+
+    // check every clip by name & id
+    unsigned int num_errors = opened ? 0 : 1;
+    for( unsigned int i=0; opened && (i<kNumClips); i++ )
+    {
+        const AssetClipEntry *clip = bank.Find(names[i]);
+        if( (clip == nullptr) || (bank.GetId(clip) != i) || (bank.Get(i) != clip) )
+        {
+            num_errors++;
+            continue;
+        }
+        const uint8_t *data = (const uint8_t *)bank.GetData(clip);
+        unsigned int len = kClipLen + (i & 1);
+        num_errors += (clip->num_samples != len) || (clip->samplerate != 8000 + i);
+        num_errors += (((uintptr_t)data - (uintptr_t)&image[0]) % kAssetAlign) != 0;
+        for( unsigned int j=0; j<len; j++ )
+            num_errors += (data[j] != (uint8_t)(i + j));
+    }
+    num_errors += (bank.Find("no_such_clip") != nullptr);
+    num_errors += (bank.Get(kNumClips) != nullptr);
+    BenchLog("%u clips, %u bytes: %u lookup/data errors", kNumClips, (unsigned int)image.size(), num_errors);
+
+    // lookup cost
+    unsigned int name_idx = 0;
+    BenchRun("Find(name), per lookup", 64, kNumClips, [&]() {
+        for( unsigned int i=0; i<kNumClips; i++ )
+        {
+            bench_sink = bank.Find(names[name_idx])->num_bytes;
+            name_idx = (name_idx + 97) % kNumClips;
+        }
+    });
+    BenchRun("Get(id), per lookup", 64, kNumClips, [&]() {
+        for( unsigned int i=0; i<kNumClips; i++ )
+            bench_sink = bank.Get(i)->num_bytes;
+    });
+
+    // corrupt images must be rejected
+    unsigned int num_accepted = 0;
+    {
+        std::vector<uint8_t> bad = image;
+        bad[0] ^= 0xff;     // magic
+        num_accepted += bank.Open(&bad[0], bad.size());
+    }
+    num_accepted += bank.Open(&image[0], image.size() - 1);    // truncated
+    {
+        std::vector<uint8_t> bad = image;
+        AssetBankHeader *header = (AssetBankHeader *)&bad[0];
+        AssetClipEntry *index = (AssetClipEntry *)&bad[header->index_offset];
+        index[3].num_bytes = 0x7fffffff;    // clip runs off the end
+        num_accepted += bank.Open(&bad[0], bad.size());
+    }
+    {
+        std::vector<uint8_t> bad = image;
+        AssetBankHeader *header = (AssetBankHeader *)&bad[0];
+        uint16_t *hash = (uint16_t *)&bad[header->hash_offset];
+        for( unsigned int i=0; i<header->hash_size; i++ )
+            hash[i] = 1;    // no empty slot, ::Find() of a missing name would never terminate
+        num_accepted += bank.Open(&bad[0], bad.size());
+    }
+    BenchLog("corrupt images accepted: %u/4", num_accepted);
+}
+
+//-----------------------------------------------------------------
+// IMA-ADPCM: size, decode cost & round-trip quality
+
+void BenchAdpcm()
+{
+    BenchLog("--- IMA-ADPCM ---");
+
+    const int16_t *viola = (const int16_t *)viola4416Buf;
+    const unsigned int len = kViola44Len16;
+    std::vector<uint8_t> encoded = AdpcmEncode(viola, len);
+    BenchLog("viola 44.1k: %u samples, %u bytes ADPCM vs %u bytes 16-bit (%.2fx), %u bytes 8-bit (%.2fx)",
+            len, (unsigned int)encoded.size(), len * 2, len * 2.0 / encoded.size(), len, (double)len / encoded.size());
+
+    // round trip, in DAC-sized reads
+    std::vector<int16_t> decoded(len);
+    AdpcmSource source(&encoded[0], encoded.size(), len);
+    unsigned int num_decoded = 0;
+    unsigned int n;
+    while( (n = source.Read(&decoded[num_decoded], (len - num_decoded < 64) ? len - num_decoded : 64)) > 0 )
+        num_decoded += n;
+    int lag;
+    BenchLog("round trip: %u/%u samples, SNR %5.1f dB", num_decoded, len,
+            AlignedSnr(viola, len, &decoded[0], len, 0, &lag));
+
+    // for comparison, the stored 8-bit version
+    {
+        std::vector<int16_t> viola8(kViola44Len08);
+        ConvertRun(viola4408Buf, &viola8[0], kViola44Len08);
+        BenchLog("8-bit PCM, for comparison:  SNR %5.1f dB",
+                AlignedSnr(viola, len, &viola8[0], kViola44Len08, 0, &lag));
+    }
+
+    // odd read sizes (straddling block boundaries) must decode the same
+    {
+        std::vector<int16_t> odd(len);
+        source.Restart();
+        num_decoded = 0;
+        unsigned int read_len = 1;
+        while( (n = source.Read(&odd[num_decoded], (len - num_decoded < read_len) ? len - num_decoded : read_len)) > 0 )
+        {
+            num_decoded += n;
+            read_len = (read_len * 7 + 3) % 1021 + 1;
+        }
+        unsigned int num_errors = (num_decoded != len);
+        for( unsigned int i=0; i<len; i++ )
+            num_errors += (odd[i] != decoded[i]);
+        BenchLog("odd-sized reads: %u sample errors", num_errors);
+    }
+
+    // through a bank & ClipSource, as the sketches play it, looped
+    {
+        AssetBankWriter writer;
+        writer.Add("viola", &encoded[0], encoded.size(), len, 44100, 16, ClipCodec::ImaAdpcm);
+        std::vector<uint8_t> image = writer.Build();
+        AssetBank bank;
+        ClipSource clip_source;
+        bool ok = bank.Open(&image[0], image.size()) &&
+            clip_source.SetClip(bank.Find("viola"), bank.GetData(bank.Find("viola")), true);
+        unsigned int num_errors = ok ? 0 : 1;
+        int16_t block[64];
+        for( unsigned int pos=0; ok && (pos<2 * len); pos+=64 )
+        {
+            num_errors += (clip_source.Read(block, 64) != 64);
+            for( unsigned int i=0; i<64; i++ )
+                num_errors += (block[i] != decoded[(pos + i) % len]);
+        }
+        BenchLog("ClipSource from bank, looped twice: %u sample errors", num_errors);
+    }
+
+    // pure tone, where ADPCM does best
+    {
+        const unsigned int kToneLen = 8192;
+        std::vector<int16_t> tone(kToneLen);
+        for( unsigned int i=0; i<kToneLen; i++ )
+            tone[i] = (int16_t)(16000.0 * sin(2.0 * M_PI * 1000.0 * i / 44100.0));
+        std::vector<uint8_t> tone_encoded = AdpcmEncode(&tone[0], kToneLen);
+        std::vector<int16_t> tone_decoded(kToneLen);
+        AdpcmSource tone_source(&tone_encoded[0], tone_encoded.size(), kToneLen);
+        tone_source.Read(&tone_decoded[0], kToneLen);
+        BenchLog("1 kHz sine round trip: SNR %5.1f dB", AlignedSnr(&tone[0], kToneLen, &tone_decoded[0], kToneLen, 0, &lag));
+    }
+
+    // decode cost, per 64-sample read as the DACs pull it
+    const unsigned int kReadLen = 64;
+    int16_t out[kReadLen];
+    BenchRun("AdpcmSource::Read()", 4, len, [&]() {
+        source.Restart();
+        while( source.Read(out, kReadLen) == kReadLen )
+            bench_sink = out[0];
+    });
+    BufferSource pcm_source(viola, len, 16);
+    BenchRun("BufferSource::Read() 16-bit (cf.)", 4, len, [&]() {
+        pcm_source.Restart();
+        while( pcm_source.Read(out, kReadLen) == kReadLen )
+            bench_sink = out[0];
+    });
+    BenchRun("AdpcmEncode()", 2, len, [&]() {
+        bench_sink = AdpcmEncode(viola, len)[0];
+    });
+}
+
+//-----------------------------------------------------------------
+// µ-law/A-law: table exactness, decode cost & quality
+
+// G.711 reference decoders (Sun g711.c), to check the constexpr tables against
+static int16_t RefMuLawDecode(uint8_t u_val)
+{
+    u_val = ~u_val;
+    int t = ((u_val & 0x0f) << 3) + 0x84;
+    t <<= (u_val & 0x70) >> 4;
+    return (int16_t)((u_val & 0x80) ? (0x84 - t) : (t - 0x84));
+}
+
+static int16_t RefALawDecode(uint8_t a_val)
+{
+    a_val ^= 0x55;
+    int t = (a_val & 0x0f) << 4;
+    int seg = (a_val & 0x70) >> 4;
+    switch( seg )
+    {
+    case 0:
+        t += 8;
+        break;
+    case 1:
+        t += 0x108;
+        break;
+    default:
+        t += 0x108;
+        t <<= seg - 1;
+    }
+    return (int16_t)((a_val & 0x80) ? t : -t);
+}
+
+void BenchCompanding()
+{
+    BenchLog("--- mu-law/A-law ---");
+
+    // tables vs. reference, and encoder vs. tables, all 256 codes
+    unsigned int table_errors = 0;
+    unsigned int encode_errors = 0;
+    for( unsigned int code=0; code<256; code++ )
+    {
+        table_errors += (kMuLawTable.val[code] != RefMuLawDecode(code));
+        table_errors += (kALawTable.val[code] != RefALawDecode(code));
+        // code 0x7f is mu-law's "negative zero", it encodes back as 0xff
+        encode_errors += (MuLawEncode(kMuLawTable.val[code]) != ((code == 0x7f) ? 0xff : code));
+        encode_errors += (ALawEncode(kALawTable.val[code]) != code);
+    }
+    BenchLog("tables vs. G.711 reference: %u errors, encode(decode(code)) != code: %u", table_errors, encode_errors);
+
+    // quality, full-scale & quiet (-24 dB) viola, vs. 8-bit linear
+    const int16_t *viola = (const int16_t *)viola4416Buf;
+    const unsigned int len = kViola44Len16;
+    std::vector<int16_t> src(len);
+    std::vector<int16_t> out(len);
+    std::vector<uint8_t> linear8(len);
+    int lag;
+    for( int shift=0; shift<=4; shift+=4 )
+    {
+        for( unsigned int i=0; i<len; i++ )
+            src[i] = viola[i] >> shift;
+
+        ConvertRun(&src[0], &linear8[0], len);
+        ConvertRun(&linear8[0], &out[0], len);
+        double snr_linear = AlignedSnr(&src[0], len, &out[0], len, 0, &lag);
+        for( unsigned int i=0; i<len; i++ )
+            out[i] = kMuLawTable.val[MuLawEncode(src[i])];
+        double snr_mulaw = AlignedSnr(&src[0], len, &out[0], len, 0, &lag);
+        for( unsigned int i=0; i<len; i++ )
+            out[i] = kALawTable.val[ALawEncode(src[i])];
+        double snr_alaw = AlignedSnr(&src[0], len, &out[0], len, 0, &lag);
+        BenchLog("viola %3d dB: SNR 8-bit linear %5.1f dB, mu-law %5.1f dB, A-law %5.1f dB",
+                -6 * shift, snr_linear, snr_mulaw, snr_alaw);
+    }
+
+    // decode cost, per 64-sample read as the DACs pull it
+    std::vector<uint8_t> encoded(len);
+    for( unsigned int i=0; i<len; i++ )
+        encoded[i] = MuLawEncode(viola[i]);
+    const unsigned int kReadLen = 64;
+    int16_t block[kReadLen];
+    CompandedSource source(kMuLawTable, &encoded[0], len);
+    BenchRun("CompandedSource::Read()", 4, len, [&]() {
+        source.Restart();
+        while( source.Read(block, kReadLen) == kReadLen )
+            bench_sink = block[0];
+    });
+    BufferSource pcm_source(viola4408Buf, kViola44Len08, 8);
+    BenchRun("BufferSource::Read() 8-bit (cf.)", 4, kViola44Len08, [&]() {
+        pcm_source.Restart();
+        while( pcm_source.Read(block, kReadLen) == kReadLen )
+            bench_sink = block[0];
+    });
+}
+
+//-----------------------------------------------------------------
+// LZ: ratio, throughput & worst-case block latency
+
+void BenchLz()
+{
+    BenchLog("--- LZ ---");
+
+    struct Clip
+    {
+        const char *name;
+        const void *data;
+        unsigned int num_samples;
+        unsigned int bits_per_sample;
+        unsigned int samplerate;
+    };
+    const Clip clips[] = {
+        { "gameOverMan 8k/8",   gameOverManBuf, sizeof(gameOverManBuf), 8, 8000 },
+        { "surelyShirley 8k/8", surelyShirleyBuf, sizeof(surelyShirleyBuf), 8, 8000 },
+        { "viola 44k/8",        viola4408Buf, kViola44Len08, 8, 44100 },
+        { "viola 44k/16",       viola4416Buf, kViola44Len16, 16, 44100 },
+    };
+
+    const unsigned int kReadLen = 64;
+    for( const Clip & clip : clips )
+    {
+        unsigned int num_bytes = clip.num_samples * clip.bits_per_sample / 8;
+        std::vector<uint8_t> encoded = LzEncode(clip.data, num_bytes);
+
+        // lossless check, in DAC-sized reads
+        LzSource source(&encoded[0], encoded.size(), clip.num_samples, clip.bits_per_sample);
+        BufferSource ref_source(clip.data, clip.num_samples, clip.bits_per_sample);
+        int16_t block[kReadLen];
+        int16_t ref_block[kReadLen];
+        unsigned int num_errors = 0;
+        unsigned int num_read = 0;
+        unsigned int n;
+        while( (n = source.Read(block, kReadLen)) > 0 )
+        {
+            num_errors += (ref_source.Read(ref_block, n) != n);
+            num_errors += (memcmp(block, ref_block, n * sizeof(int16_t)) != 0);
+            num_read += n;
+        }
+        num_errors += (num_read != clip.num_samples);
+        BenchLog("%-20s %7u -> %7u bytes (%5.1f%% saved), %u errors", clip.name, num_bytes,
+                (unsigned int)encoded.size(), 100.0 - 100.0 * encoded.size() / num_bytes, num_errors);
+
+        // throughput
+        char name[48];
+        snprintf(name, sizeof(name), "LzSource::Read() %s", clip.name);
+        double ns_per_sample = BenchRun(name, 8, clip.num_samples, [&]() {
+            source.Restart();
+            while( source.Read(block, kReadLen) == kReadLen )
+                bench_sink = block[0];
+        });
+        BenchLog("  %.0f MB/s decoded", (clip.bits_per_sample / 8) * 1000.0 / ns_per_sample);
+
+        // worst-case block: all of a block's decode lands in the one Read() that reaches it, so
+        // compare with the time the DAC takes to play out one 64-sample render block
+        // - per block, best of a few timed runs so a preemption doesn't pose as a slow block
+        const unsigned int kReps = 200;
+        const unsigned int kTrials = 3;
+        uint8_t window[kLzBlockBytes];
+        double worst_us = 0.0;
+        unsigned int pos = 0;
+        while( pos + 2 <= encoded.size() )
+        {
+            uint16_t header = encoded[pos] | (encoded[pos + 1] << 8);
+            unsigned int payload_len = header & ~kLzStoredFlag;
+            double block_us = 1e9;
+            for( unsigned int trial=0; trial<kTrials; trial++ )
+            {
+                uint32_t start_us = BenchMicros();
+                for( unsigned int i=0; i<kReps; i++ )
+                {
+                    if( header & kLzStoredFlag )
+                        memcpy(window, &encoded[pos + 2], payload_len);
+                    else
+                        bench_sink = LzDecodeBlock(&encoded[pos + 2], payload_len, window, kLzBlockBytes);
+                }
+                double trial_us = (BenchMicros() - start_us) / (double)kReps;
+                if( trial_us < block_us )
+                    block_us = trial_us;
+            }
+            if( block_us > worst_us )
+                worst_us = block_us;
+            pos += 2 + payload_len;
+        }
+        double deadline_us = kReadLen * 1e6 / clip.samplerate;
+        BenchLog("  worst block decode %.2f us, %.2f%% of a %u-sample deadline (%.0f us)",
+                worst_us, 100.0 * worst_us / deadline_us, kReadLen, deadline_us);
+    }
+}
+
+//-----------------------------------------------------------------
+// Silence trimming & RLE: savings, correctness & decode cost
+
+void BenchSilence()
+{
+    BenchLog("--- Silence trim/RLE ---");
+
+    struct Clip
+    {
+        const char *name;
+        const void *data;
+        unsigned int num_samples;
+        unsigned int bits_per_sample;
+        unsigned int samplerate;
+    };
+    const Clip clips[] = {
+        { "gameOverMan 8k/8",   gameOverManBuf, sizeof(gameOverManBuf), 8, 8000 },
+        { "surelyShirley 8k/8", surelyShirleyBuf, sizeof(surelyShirleyBuf), 8, 8000 },
+        { "viola 44k/8",        viola4408Buf, kViola44Len08, 8, 44100 },
+        { "viola 44k/16",       viola4416Buf, kViola44Len16, 16, 44100 },
+    };
+
+    const unsigned int kReadLen = 64;
+    const int threshold = SilenceThreshold(kSilence_dBFS);
+    for( const Clip & clip : clips )
+    {
+        unsigned int num_bytes = clip.num_samples * clip.bits_per_sample / 8;
+        SilenceEncoded encoded = SilenceEncode(clip.data, clip.num_samples, clip.bits_per_sample);
+        BenchLog("%-20s %7u -> %7u bytes (%4.1f%% saved), lead %5.1f ms, tail %5.1f ms trimmed, %u runs",
+                clip.name, num_bytes, (unsigned int)encoded.data.size(),
+                100.0 - 100.0 * encoded.data.size() / num_bytes,
+                encoded.lead_trimmed * 1000.0 / clip.samplerate, encoded.tail_trimmed * 1000.0 / clip.samplerate,
+                encoded.num_runs);
+
+        // decoded clip == trimmed original, exactly outside runs & within threshold inside them
+        SilenceSource source(encoded.data.empty() ? nullptr : &encoded.data[0], encoded.data.size(),
+                encoded.num_samples, clip.bits_per_sample);
+        BufferSource ref_source(clip.data, clip.num_samples, clip.bits_per_sample);
+        int16_t block[kReadLen];
+        int16_t ref_block[kReadLen];
+        for( unsigned int i=0; i<encoded.lead_trimmed; i++ )
+            ref_source.Read(ref_block, 1);
+        unsigned int num_errors = 0;
+        unsigned int num_inexact = 0;
+        unsigned int num_read = 0;
+        unsigned int n;
+        while( (n = source.Read(block, kReadLen)) > 0 )
+        {
+            num_errors += (ref_source.Read(ref_block, n) != n);
+            for( unsigned int i=0; i<n; i++ )
+            {
+                if( block[i] != ref_block[i] )
+                {
+                    num_inexact++;
+                    int diff = block[i] - ref_block[i];
+                    num_errors += (diff > 2 * threshold) || (diff < -2 * threshold);
+                }
+            }
+            num_read += n;
+        }
+        num_errors += (num_read != encoded.num_samples);
+        BenchLog("  %u samples decoded, %u within-threshold differences, %u errors", num_read, num_inexact, num_errors);
+
+        char name[48];
+        snprintf(name, sizeof(name), "SilenceSource::Read() %s", clip.name);
+        BenchRun(name, 8, encoded.num_samples, [&]() {
+            source.Restart();
+            while( source.Read(block, kReadLen) == kReadLen )
+                bench_sink = block[0];
+        });
+    }
+
+    // all-silent clip: trims to nothing
+    {
+        std::vector<uint8_t> quiet(4000, 0x80);
+        SilenceEncoded encoded = SilenceEncode(&quiet[0], quiet.size(), 8);
+        BenchLog("silent clip: %u samples, %u bytes after trimming", encoded.num_samples, (unsigned int)encoded.data.size());
+    }
+}
+
+//-----------------------------------------------------------------
+// Hot-clip RAM cache: hit rates, pinning, correctness & fetch cost
+
+void BenchClipCache()
+{
+    BenchLog("--- ClipCache ---");
+
+    const ClipView clips[] = {
+        ClipView(gameOverManBuf, 8000),
+        ClipView(surelyShirleyBuf, 8000),
+        ClipView(viola4408Buf, 44100),
+        ClipView(viola4416Buf, 44100),
+    };
+    const unsigned int kNumClips = sizeof(clips) / sizeof(clips[0]);
+    size_t total_bytes = 0;
+    for( const ClipView & clip : clips )
+        total_bytes += clip.GetLen() * clip.GetBitsPerSample() / 8;
+    BenchLog("%u clips, %u bytes", kNumClips, (unsigned int)total_bytes);
+
+    // skewed play pattern: mostly the two speech clips, occasionally the violas
+    const unsigned int kNumPlays = 1000;
+    std::vector<unsigned int> plays;
+    uint32_t lcg = 12345;
+    for( unsigned int i=0; i<kNumPlays; i++ )
+    {
+        lcg = lcg * 1664525u + 1013904223u;
+        unsigned int r = (lcg >> 16) % 100;
+        plays.push_back((r < 45) ? 0 : (r < 85) ? 1 : (r < 95) ? 2 : 3);
+    }
+
+    struct Config
+    {
+        size_t budget_bytes;
+        unsigned int prefix_ms;
+    };
+    const Config configs[] = {
+        { 16 * 1024, 0 },
+        { 32 * 1024, 0 },
+        { 96 * 1024, 0 },
+        { 16 * 1024, 100 },
+        { 32 * 1024, 100 },
+    };
+    for( const Config & config : configs )
+    {
+        ClipCache cache(config.budget_bytes, config.prefix_ms);
+        for( unsigned int idx : plays )
+        {
+            unsigned int cached_len;
+            if( cache.Acquire(clips[idx], cached_len) != nullptr )
+                cache.Release(clips[idx]);
+        }
+        ClipCache::Stats stats = cache.GetStats();
+        BenchLog("budget %3u KB, %s: %4u hits, %3u misses (%3u rejected), %3u evictions, hit rate %5.1f%%, %6u bytes used",
+                (unsigned int)(config.budget_bytes / 1024), config.prefix_ms ? "100 ms prefix" : "whole clips  ",
+                stats.hits, stats.misses, stats.rejected, stats.evictions,
+                100.0 * stats.hits / kNumPlays, (unsigned int)stats.bytes_used);
+    }
+
+    // pinned entries are never evicted
+    {
+        // room for either speech clip, not both
+        size_t budget_bytes = (clips[0].GetLen() > clips[1].GetLen()) ? clips[0].GetLen() : clips[1].GetLen();
+        ClipCache cache(budget_bytes);
+        unsigned int len0, len1, len2;
+        const void *copy0 = cache.Acquire(clips[0], len0);   // pinned
+        const void *copy1 = cache.Acquire(clips[1], len1);   // needs clip 0's space
+        cache.Release(clips[0]);
+        const void *copy2 = cache.Acquire(clips[1], len2);   // now evicts clip 0
+        unsigned int num_errors = (copy0 == nullptr) || (copy1 != nullptr) || (copy2 == nullptr) ||
+                cache.Contains(clips[0]) || (len2 != clips[1].GetLen()) ||
+                (memcmp(copy2, clips[1].GetData(), len2) != 0);
+        cache.Release(clips[1]);
+        BenchLog("pinning: %u errors", num_errors);
+    }
+
+    // prefix + flash remainder plays the same samples as the flash clip
+    const unsigned int kReadLen = 64;
+    int16_t block[kReadLen];
+    int16_t ref_block[kReadLen];
+    {
+        unsigned int num_errors = 0;
+        ClipCache cache(64 * 1024, 100);
+        for( const ClipView & clip : clips )
+        {
+            unsigned int cached_len;
+            const void *cached = cache.Acquire(clip, cached_len);
+            CachedClipSource source;
+            source.SetClip(clip, cached, cached_len);
+            BufferSource ref_source(clip);
+            unsigned int num_read = 0;
+            unsigned int n;
+            while( (n = source.Read(block, kReadLen)) > 0 )
+            {
+                num_errors += (ref_source.Read(ref_block, n) != n);
+                num_errors += (memcmp(block, ref_block, n * sizeof(int16_t)) != 0);
+                num_read += n;
+            }
+            num_errors += (num_read != clip.GetLen());
+            cache.Release(clip);
+        }
+        BenchLog("CachedClipSource vs. flash: %u errors", num_errors);
+    }
+
+    // fetch cost: lookup & promotion, then reads from the RAM copy vs. in place
+    // - on target, the flash numbers also depend on what else has been through the flash cache
+    {
+        ClipCache cache(32 * 1024);
+        unsigned int cached_len;
+        BenchRun("Acquire()+Release() miss, 8k/8 clip (per call)", 100, 1, [&]() {
+            cache.Clear();
+            bench_sink = (cache.Acquire(clips[0], cached_len) != nullptr);
+            cache.Release(clips[0]);
+        });
+        BenchRun("Acquire()+Release() hit (per call)", 10000, 1, [&]() {
+            bench_sink = (cache.Acquire(clips[0], cached_len) != nullptr);
+            cache.Release(clips[0]);
+        });
+
+        ClipCache viola_cache(256 * 1024);
+        const void *cached = viola_cache.Acquire(clips[2], cached_len);
+        CachedClipSource ram_source;
+        ram_source.SetClip(clips[2], cached, cached_len);
+        CachedClipSource flash_source;
+        flash_source.SetClip(clips[2], nullptr, 0);
+        BenchRun("CachedClipSource::Read() RAM viola 44k/8", 8, clips[2].GetLen(), [&]() {
+            ram_source.Restart();
+            while( ram_source.Read(block, kReadLen) == kReadLen )
+                bench_sink = block[0];
+        });
+        BenchRun("CachedClipSource::Read() flash viola 44k/8", 8, clips[2].GetLen(), [&]() {
+            flash_source.Restart();
+            while( flash_source.Read(block, kReadLen) == kReadLen )
+                bench_sink = block[0];
+        });
+        viola_cache.Release(clips[2]);
+    }
+}
+
+//-----------------------------------------------------------------
+// Envelope tracks vs. per-interval window scans (as DacVisualizer::_CalcValue())
+
+void BenchEnvelope()
+{
+    BenchLog("--- Envelope tracks ---");
+
+    struct Clip
+    {
+        const char *name;
+        const void *data;
+        unsigned int num_samples;
+        unsigned int bits_per_sample;
+        unsigned int samplerate;
+    };
+    const Clip clips[] = {
+        { "gameOverMan 8k/8",   gameOverManBuf, sizeof(gameOverManBuf), 8, 8000 },
+        { "surelyShirley 8k/8", surelyShirleyBuf, sizeof(surelyShirleyBuf), 8, 8000 },
+        { "viola 44k/8",        viola4408Buf, kViola44Len08, 8, 44100 },
+        { "viola 44k/16",       viola4416Buf, kViola44Len16, 16, 44100 },
+    };
+    const unsigned int kNumLevels = 6;
+    for( const Clip & clip : clips )
+    {
+        unsigned int hop_len = EnvelopeHopLen(clip.samplerate);
+        unsigned int window_len = EnvelopeWindowLen(clip.samplerate);
+        std::vector<uint8_t> track_data = EnvelopeBuild(clip.data, clip.num_samples, clip.bits_per_sample, hop_len, window_len);
+        EnvelopeTrack track(&track_data[0], track_data.size());
+
+        // visualizer levels, scanned vs. from the track
+        unsigned int max_amp = (clip.bits_per_sample == 8) ? 128 : 32768;
+        int dc_ofs = (clip.bits_per_sample == 8) ? 128 : 0;
+        unsigned int iscale = (max_amp / kNumLevels) + (max_amp % kNumLevels != 0);
+        auto scan_level = [&](uint32_t idx) {
+            int end = (int)((idx + 1) * hop_len);
+            int start = end - (int)window_len;
+            start = (start > 0) ? start : 0;
+            end = (end < (int)clip.num_samples) ? end : (int)clip.num_samples;
+            int peak = 0;
+            for( int i=start; i<end; i++ )
+            {
+                int val = (clip.bits_per_sample == 8) ? ((const uint8_t *)clip.data)[i] : ((const int16_t *)clip.data)[i];
+                val -= dc_ofs;
+                peak = (abs(val) > peak) ? abs(val) : peak;
+            }
+            return (unsigned int)peak / iscale;
+        };
+        unsigned int num_equal = 0;
+        unsigned int num_off_by_one = 0;
+        for( uint32_t idx=0; idx<track.GetNumFrames(); idx++ )
+        {
+            unsigned int scanned = scan_level(idx);
+            unsigned int tracked = track.GetPeak(idx) * kNumLevels / 16;
+            num_equal += (scanned == tracked);
+            num_off_by_one += (scanned == tracked + 1) || (tracked == scanned + 1);
+        }
+        BenchLog("%-20s %4u frames (%4u bytes, %4.2f%% of clip), levels: %u equal, %u off by one, %u worse",
+                clip.name, track.GetNumFrames(), (unsigned int)track_data.size(),
+                100.0 * track_data.size() / (clip.num_samples * clip.bits_per_sample / 8),
+                num_equal, num_off_by_one, track.GetNumFrames() - num_equal - num_off_by_one);
+
+        char name[64];
+        snprintf(name, sizeof(name), "level per interval, scan %s", clip.name);
+        BenchRun(name, 16, track.GetNumFrames(), [&]() {
+            for( uint32_t idx=0; idx<track.GetNumFrames(); idx++ )
+                bench_sink = scan_level(idx);
+        });
+        snprintf(name, sizeof(name), "level per interval, track %s", clip.name);
+        BenchRun(name, 1024, track.GetNumFrames(), [&]() {
+            for( uint32_t idx=0; idx<track.GetNumFrames(); idx++ )
+                bench_sink = track.GetPeak(idx) * kNumLevels / 16;
+        });
+    }
+}
+
+//-----------------------------------------------------------------
+// Visualizer level tracking: window rescan per interval vs. incremental sliding extrema
+
+// DacVisualizer's interval logic (start progress point, 6 levels), minus the pins
+// - rescan: the previous _FindExtrema() over the whole window when an interval is due
+// - incremental: SlidingExtrema fed up to kMaxFeedPerLoop samples per ::Loop()
+struct VisualizerModel
+{
+    static const unsigned int kNumLevels = 6;
+    static const unsigned int kMaxFeedPerLoop = 16;
+
+    VisualizerModel(const void *buffer, unsigned int buffer_len, unsigned int bits_per_sample, unsigned int samplerate, bool incremental)
+        : buffer(buffer), buffer_len(buffer_len), bits_per_sample(bits_per_sample), incremental(incremental)
+    {
+        duration = (unsigned int)(0.05f * samplerate);
+        interval = duration - (unsigned int)(0.5f * duration);
+        dc_ofs = (bits_per_sample == 8) ? 128 : 0;
+        unsigned int max_amp = (bits_per_sample == 8) ? 128 : 32768;
+        iscale = (max_amp / kNumLevels) + (max_amp % kNumLevels != 0);
+        Restart();
+    }
+
+    void Restart()
+    {
+        interval_index = 0;
+        fed_pos = 0;
+        max_touched = 0;
+        extrema.Reset(duration);
+        levels.clear();
+    }
+
+    int Sample(unsigned int idx) const
+    {
+        if( idx >= buffer_len )
+            return dc_ofs;
+        return (bits_per_sample == 8) ? ((const uint8_t *)buffer)[idx] : ((const int16_t *)buffer)[idx];
+    }
+
+    void Loop(unsigned int cur_pos)
+    {
+        unsigned int end = (interval_index + 1) * interval;
+        int start = (int)end - (int)duration;
+        unsigned int touched = 0;
+        bool is_fed = true;
+        if( incremental )
+        {
+            for( ; (fed_pos < end) && (touched < kMaxFeedPerLoop); fed_pos++, touched++ )
+                extrema.Push(Sample(fed_pos));
+            is_fed = (fed_pos >= end);
+        }
+        if( ((int)cur_pos >= start) && is_fed )
+        {
+            int max_val;
+            int min_val;
+            if( incremental )
+            {
+                max_val = extrema.GetMax();
+                min_val = extrema.GetMin();
+            }
+            else
+            {
+                unsigned int start_idx = (start > 0) ? start : 0;
+                unsigned int end_idx = (end < buffer_len) ? end : buffer_len;
+                max_val = dc_ofs;
+                min_val = dc_ofs;
+                if( start_idx < end_idx )
+                {
+                    max_val = -100000;
+                    min_val = 100000;
+                }
+                for( unsigned int i=start_idx; i<end_idx; i++ )
+                {
+                    int val = Sample(i);
+                    max_val = (val > max_val) ? val : max_val;
+                    min_val = (val < min_val) ? val : min_val;
+                }
+                touched += (end_idx > start_idx) ? end_idx - start_idx : 0;
+            }
+            int max_amp = std::max(max_val - dc_ofs, abs(min_val - dc_ofs));
+            levels.push_back(max_amp / iscale);
+            interval_index++;
+        }
+        max_touched = (touched > max_touched) ? touched : max_touched;
+    }
+
+    const void *buffer;
+    unsigned int buffer_len;
+    unsigned int bits_per_sample;
+    bool incremental;
+    unsigned int duration;
+    unsigned int interval;
+    int dc_ofs;
+    unsigned int iscale;
+
+    unsigned int interval_index;
+    unsigned int fed_pos;
+    SlidingExtrema extrema;
+    unsigned int max_touched;       // samples, in any one ::Loop()
+    std::vector<unsigned int> levels;
+};
+
+void BenchVisualizer()
+{
+    BenchLog("--- Visualizer: rescan vs. incremental extrema, one Loop() per sample played ---");
+
+    struct Clip
+    {
+        const char *name;
+        const void *data;
+        unsigned int num_samples;
+        unsigned int bits_per_sample;
+        unsigned int samplerate;
+    };
+    const Clip clips[] = {
+        { "gameOverMan 8k/8",   gameOverManBuf, sizeof(gameOverManBuf), 8, 8000 },
+        { "viola 44k/8",        viola4408Buf, kViola44Len08, 8, 44100 },
+        { "viola 44k/16",       viola4416Buf, kViola44Len16, 16, 44100 },
+    };
+    for( const Clip & clip : clips )
+    {
+        VisualizerModel rescan(clip.data, clip.num_samples, clip.bits_per_sample, clip.samplerate, false);
+        VisualizerModel incremental(clip.data, clip.num_samples, clip.bits_per_sample, clip.samplerate, true);
+        for( unsigned int pos=0; pos<clip.num_samples; pos++ )
+        {
+            rescan.Loop(pos);
+            incremental.Loop(pos);
+        }
+        BenchLog("%-18s %u intervals, levels %s, worst Loop() touches %u samples (rescan) vs. %u (incremental)",
+                clip.name, (unsigned int)rescan.levels.size(),
+                (rescan.levels == incremental.levels) ? "identical" : "DIFFER",
+                rescan.max_touched, incremental.max_touched);
+
+        // worst single Loop(): a due interval, i.e. a full window scan vs. one feed & lookup
+        char name[64];
+        snprintf(name, sizeof(name), "worst Loop() rescan %s (per call)", clip.name);
+        unsigned int due_pos = clip.num_samples / 2;
+        BenchRun(name, 2000, 1, [&]() {
+            rescan.interval_index = due_pos / rescan.interval;
+            rescan.Loop(due_pos);
+            bench_sink = rescan.levels.back();
+            rescan.levels.pop_back();
+        });
+        snprintf(name, sizeof(name), "worst Loop() incremental %s (per call)", clip.name);
+        BenchRun(name, 2000, 1, [&]() {
+            // refeed the window's last kMaxFeedPerLoop samples, then evaluate
+            incremental.interval_index = due_pos / incremental.interval;
+            incremental.fed_pos = (incremental.interval_index + 1) * incremental.interval - VisualizerModel::kMaxFeedPerLoop;
+            incremental.Loop(due_pos);
+            bench_sink = incremental.levels.back();
+            incremental.levels.pop_back();
+        });
+    }
+}
+
+//-----------------------------------------------------------------
+// VU mode (DacVisualizer): running RMS, fixed-point dB & ballistics
+
+void BenchVu()
+{
+    BenchLog("--- VU: running RMS & fixed-point dB/ballistics vs. double reference, cost per Loop() ---");
+
+    // dB conversion over the whole range
+    double max_db_err = 0.0;
+    for( double ms=1.0; ms<(double)(1ull << 31); ms*=1.0137 )
+    {
+        double err = fabs(VuDbQ8((uint64_t)ms) / 256.0 - 10.0 * log10((double)(uint64_t)ms / 1073741824.0));
+        max_db_err = (err > max_db_err) ? err : max_db_err;
+    }
+    BenchLog("VuDbQ8() vs. 10 log10(): max error %.4f dB, 1 .. 2^31", max_db_err);
+
+    // sines at known levels, 1 kHz at 44.1 kHz, 50 ms window
+    const double kPi = 3.14159265358979323846;
+    const unsigned int kWindow = EnvelopeWindowLen(44100);
+    for( int level_dB=0; level_dB>=-42; level_dB-=6 )
+    {
+        SlidingRms rms(kWindow);
+        double amp = 32767.0 * pow(10.0, level_dB / 20.0);
+        std::vector<int> sine(3 * kWindow);
+        for( unsigned int i=0; i<sine.size(); i++ )
+        {
+            sine[i] = (int)lround(amp * sin(2.0 * kPi * 1000.0 * i / 44100.0));
+            rms.Push(sine[i], (i >= kWindow) ? sine[i - kWindow] : 0);
+        }
+        int32_t db_q8 = rms.GetDbQ8();
+        BenchLog("sine peak %3d dBFS: RMS %7.2f dBFS (expect %7.2f), bar level %u",
+                level_dB, db_q8 / 256.0, level_dB - 3.0103, VuLevel(db_q8, 6, 30));
+    }
+
+    struct Clip
+    {
+        const char *name;
+        const void *data;
+        unsigned int num_samples;
+        unsigned int bits_per_sample;
+        unsigned int samplerate;
+    };
+    const Clip clips[] = {
+        { "gameOverMan 8k/8",   gameOverManBuf, sizeof(gameOverManBuf), 8, 8000 },
+        { "surelyShirley 8k/8", surelyShirleyBuf, sizeof(surelyShirleyBuf), 8, 8000 },
+        { "viola 44k/16",       viola4416Buf, kViola44Len16, 16, 44100 },
+    };
+    for( const Clip & clip : clips )
+    {
+        auto sample = [&](int idx) {
+            if( (idx < 0) || (idx >= (int)clip.num_samples) )
+                return 0;
+            if( clip.bits_per_sample == 8 )
+                return ((int)((const uint8_t *)clip.data)[idx] - 128) * 256;
+            return (int)((const int16_t *)clip.data)[idx];
+        };
+        unsigned int window = EnvelopeWindowLen(clip.samplerate);
+        unsigned int hop = EnvelopeHopLen(clip.samplerate);
+
+        // per interval: incremental vs. a double-precision rescan, then ballistics on each
+        SlidingRms rms(window);
+        VuBallistics ballistics;
+        ballistics.Reset(0.01f, 0.3f, (float)hop / clip.samplerate);
+        double ref_level = kVuMinDbQ8 / 256.0;
+        double max_rms_err = 0.0;
+        double max_vu_err = 0.0;
+        unsigned int num_intervals = 0;
+        unsigned int same_bar = 0;
+        unsigned int pos = 0;
+        for( unsigned int end=hop; end<clip.num_samples + window; end+=hop )
+        {
+            for( ; pos<end; pos++ )
+                rms.Push(sample(pos), sample((int)pos - (int)window));
+            double sum_sq = 0.0;
+            for( int i=(int)end - (int)window; i<(int)end; i++ )
+                sum_sq += (double)sample(i) * sample(i);
+            double ref_db = (sum_sq > 0.0) ? 10.0 * log10(sum_sq / window / 1073741824.0) : kVuMinDbQ8 / 256.0;
+            ref_db = (ref_db < kVuMinDbQ8 / 256.0) ? kVuMinDbQ8 / 256.0 : ref_db;
+            int32_t db_q8 = rms.GetDbQ8();
+            double rms_err = fabs(db_q8 / 256.0 - ref_db);
+            // integer mean square truncation matters only near the floor
+            if( ref_db > -80.0 )
+                max_rms_err = (rms_err > max_rms_err) ? rms_err : max_rms_err;
+
+            double coeff = ((ref_db > ref_level) ? ballistics.GetAttackCoeff() : ballistics.GetReleaseCoeff()) / 32768.0;
+            ref_level += (ref_db - ref_level) * coeff;
+            int32_t level_q8 = ballistics.Update(db_q8);
+            double vu_err = fabs(level_q8 / 256.0 - ref_level);
+            max_vu_err = (vu_err > max_vu_err) ? vu_err : max_vu_err;
+            same_bar += (VuLevel(level_q8, 6, 30) == VuLevel((int32_t)floor(ref_level * 256.0), 6, 30));
+            num_intervals++;
+        }
+        BenchLog("%-18s %u intervals: RMS max error %.3f dB, after ballistics %.3f dB, bar level identical %u/%u",
+                clip.name, num_intervals, max_rms_err, max_vu_err, same_bar, num_intervals);
+
+        // worst single Loop(): a due interval, kMaxFeedPerLoop pushes & the level vs. a window rescan
+        char name[64];
+        unsigned int due_end = (clip.num_samples / 2 / hop) * hop;
+        SlidingRms due_rms(window);     // fed up to the interval's last kMaxFeedPerLoop samples
+        for( unsigned int i=0; i<due_end-VisualizerModel::kMaxFeedPerLoop; i++ )
+            due_rms.Push(sample(i), sample((int)i - (int)window));
+        snprintf(name, sizeof(name), "VU Loop() incremental %s (per call)", clip.name);
+        BenchRun(name, 2000, 1, [&]() {
+            SlidingRms loop_rms = due_rms;
+            for( unsigned int i=due_end-VisualizerModel::kMaxFeedPerLoop; i<due_end; i++ )
+                loop_rms.Push(sample(i), sample((int)i - (int)window));
+            bench_sink = VuLevel(ballistics.Update(loop_rms.GetDbQ8()), 6, 30);
+        });
+        snprintf(name, sizeof(name), "VU Loop() rescan %s (per call)", clip.name);
+        BenchRun(name, 200, 1, [&]() {
+            uint64_t sum_sq = 0;
+            for( int i=(int)due_end - (int)window; i<(int)due_end; i++ )
+                sum_sq += (uint64_t)((int64_t)sample(i) * sample(i));
+            bench_sink = VuLevel(ballistics.Update(VuDbQ8(sum_sq / window)), 6, 30);
+        });
+    }
+}
+
+//-----------------------------------------------------------------
+// Fixed-point FFT (DacVisualizer spectrum mode)
+
+// Against a double-precision DFT of the same Hann-windowed input, same 1/2N scale
+// - returns the SNR of the bins, dB
+template<unsigned int N>
+double FftCheck(const char *name, RealFft<N> & fft, const int16_t *in)
+{
+    const double kPi = 3.14159265358979323846;
+    for( unsigned int n=0; n<N; n++ )
+        fft.GetInput()[n] = in[n];
+    fft.Compute();
+
+    double sig_pow = 0.0;
+    double err_pow = 0.0;
+    double max_err = 0.0;
+    unsigned int ref_peak = 0;
+    unsigned int peak = 0;
+    double ref_peak_mag = -1.0;
+    uint32_t peak_pow = 0;
+    for( unsigned int k=0; k<=N/2; k++ )
+    {
+        double ref_re = 0.0;
+        double ref_im = 0.0;
+        for( unsigned int n=0; n<N; n++ )
+        {
+            double x = in[n] * (0.5 - 0.5 * cos(2.0 * kPi * n / N));
+            ref_re += x * cos(2.0 * kPi * k * n / N);
+            ref_im -= x * sin(2.0 * kPi * k * n / N);
+        }
+        ref_re /= 2.0 * N;
+        ref_im /= 2.0 * N;
+        int32_t re;
+        int32_t im;
+        fft.GetBin(k, re, im);
+        double err = hypot(re - ref_re, im - ref_im);
+        sig_pow += ref_re * ref_re + ref_im * ref_im;
+        err_pow += err * err;
+        max_err = (err > max_err) ? err : max_err;
+        double ref_mag = hypot(ref_re, ref_im);
+        if( ref_mag > ref_peak_mag )
+        {
+            ref_peak_mag = ref_mag;
+            ref_peak = k;
+        }
+        if( fft.GetPower(k) > peak_pow )
+        {
+            peak_pow = fft.GetPower(k);
+            peak = k;
+        }
+    }
+    double snr = 10.0 * log10(sig_pow / ((err_pow > 0.0) ? err_pow : 1e-12));
+    BenchLog("RealFft<%u> %-22s SNR %5.1f dB, max bin error %5.2f LSB, peak bin %u (ref %u)%s",
+            N, name, snr, max_err, peak, ref_peak, (peak == ref_peak) ? "" : " MISMATCH");
+    return snr;
+}
+
+template<unsigned int N>
+void BenchFftLen()
+{
+    static RealFft<N> fft;
+    const double kPi = 3.14159265358979323846;
+
+    // correctness
+    int16_t in[N];
+    for( unsigned int n=0; n<N; n++ )
+        in[n] = (int16_t)lround(32767.0 * sin(2.0 * kPi * (N / 8) * n / N));
+    FftCheck<N>("full-scale sine", fft, in);
+    for( unsigned int n=0; n<N; n++ )
+        in[n] = (int16_t)lround(16000.0 * sin(2.0 * kPi * 3.3 * n / N) + 8000.0 * cos(2.0 * kPi * (N / 4 + 0.5) * n / N));
+    FftCheck<N>("two tones", fft, in);
+    for( unsigned int n=0; n<N; n++ )
+        in[n] = (n & 1) ? -32768 : 32767;
+    FftCheck<N>("full-scale Nyquist", fft, in);
+    uint32_t lcg = 12345;
+    for( unsigned int n=0; n<N; n++ )
+    {
+        lcg = lcg * 1664525u + 1013904223u;
+        in[n] = (int16_t)(lcg >> 16);
+    }
+    FftCheck<N>("full-scale noise", fft, in);
+    for( unsigned int n=0; n<N; n++ )
+        in[n] = (int16_t)viola4416Buf[kViola44Len16 / 2 + n];
+    FftCheck<N>("viola 44k/16", fft, in);
+    for( unsigned int n=0; n<N; n++ )
+        in[n] = (int16_t)(((int)gameOverManBuf[sizeof(gameOverManBuf) / 2 + n] - 128) << 8);
+    FftCheck<N>("gameOverMan 8k/8", fft, in);
+
+    // cost: all at once, then per piece as DacVisualizer spreads it over Loop() calls
+    char name[64];
+    unsigned int num_stages = 0;
+    for( unsigned int m=1; m<N/2; m*=2 )
+        num_stages++;
+    snprintf(name, sizeof(name), "RealFft<%u> Compute (per FFT)", N);
+    double compute_ns = BenchRun(name, 2000, 1, [&]() {
+        for( unsigned int n=0; n<N; n++ )
+            fft.GetInput()[n] = in[n];
+        fft.Compute();
+        bench_sink = fft.GetPower(1);
+    });
+    snprintf(name, sizeof(name), "RealFft<%u> load+Start (per call)", N);
+    double start_ns = BenchRun(name, 2000, 1, [&]() {
+        for( unsigned int n=0; n<N; n++ )
+            fft.GetInput()[n] = in[n];
+        fft.Start();
+        bench_sink = fft.GetInput()[1];
+    });
+    fft.Compute();
+    snprintf(name, sizeof(name), "RealFft<%u> all bins' power (per call)", N);
+    double bins_ns = BenchRun(name, 2000, 1, [&]() {
+        uint32_t sum = 0;
+        for( unsigned int k=0; k<=N/2; k++ )
+            sum += fft.GetPower(k);
+        bench_sink = sum;
+    });
+    double stage_ns = (compute_ns - start_ns) / num_stages;
+    double worst_ns = std::max(std::max(start_ns, stage_ns), bins_ns);
+    BenchLog("RealFft<%u>: %.1f us per FFT, %.2f%% of a 25 ms visualizer frame; worst Loop() piece %.1f us "
+            "(%.0f%% of a 44.1 kHz sample period)",
+            N, compute_ns / 1000.0, compute_ns / 250000.0, worst_ns / 1000.0, worst_ns * 44100.0 / 1e7);
+}
+
+void BenchFft()
+{
+    BenchLog("--- Fixed-point FFT: accuracy vs. double DFT, cost vs. the visualizer frame ---");
+    BenchFftLen<64>();
+    BenchFftLen<128>();
+    BenchFftLen<256>();
+}
+
+//-----------------------------------------------------------------
+// LED bar output: digitalWrite() per pin vs. single-register set/clear masks
+
+void BenchGpio()
+{
+    BenchLog("--- GPIO: visualizer LED bar, digitalWrite() per pin vs. W1TS/W1TC masks ---");
+
+    // DacVisualizer's LED pins, level 1 .. 5
+    const uint8_t kPins[] = { 16, 17, 18, 19, 21 };
+    const unsigned int kNumPins = sizeof(kPins);
+    GpioGroup leds(kPins, kNumPins);
+
+    // masks vs. per-pin expectation, every pattern
+    unsigned int num_bad = 0;
+    for( uint32_t pattern=0; pattern<(1u << kNumPins); pattern++ )
+    {
+        uint32_t set_mask;
+        uint32_t clear_mask;
+        leds.GetMasks(pattern, set_mask, clear_mask);
+        for( unsigned int i=0; i<kNumPins; i++ )
+        {
+            bool is_high = (pattern >> i) & 1;
+            bool is_set = (set_mask >> kPins[i]) & 1;
+            bool is_clear = (clear_mask >> kPins[i]) & 1;
+            num_bad += (is_set != is_high) || (is_clear == is_high);
+        }
+        num_bad += ((set_mask | clear_mask) != leds.GetAllMask()) || ((set_mask & clear_mask) != 0);
+    }
+    BenchLog("GpioGroup masks, %u patterns: %s", 1u << kNumPins, (num_bad == 0) ? "ok" : "BAD");
+
+#ifdef ARDUINO
+    // one bar update per call, cycling through the levels
+    const unsigned int kNumLevels = kNumPins + 1;
+    uint32_t set_masks[kNumLevels];
+    uint32_t clear_masks[kNumLevels];
+    for( unsigned int level=0; level<kNumLevels; level++ )
+        leds.GetMasks((1u << level) - 1, set_masks[level], clear_masks[level]);
+    unsigned int level = 0;
+    double digital_ns = BenchRun("bar digitalWrite() x5 (per update)", 10000, 1, [&]() {
+        // as DacVisualizer::_Visualize() previously
+        unsigned int i=0;
+        for( ; i<level; i++ )
+            digitalWrite(kPins[i], HIGH);
+        for( ; i<kNumPins; i++ )
+            digitalWrite(kPins[i], LOW);
+        level = (level + 1 < kNumLevels) ? level + 1 : 0;
+    });
+    level = 0;
+    double masks_ns = BenchRun("bar W1TS/W1TC precomputed (per update)", 10000, 1, [&]() {
+        GpioGroup::WriteMasks(set_masks[level], clear_masks[level]);
+        level = (level + 1 < kNumLevels) ? level + 1 : 0;
+    });
+    uint32_t pattern = 0;
+    BenchRun("bar W1TS/W1TC from pattern (per update)", 10000, 1, [&]() {
+        leds.Write(pattern);
+        pattern = (pattern + 1) & ((1u << kNumPins) - 1);
+    });
+    BenchLog("bar update: masks %.1fx faster than digitalWrite()", digital_ns / masks_ns);
+    GpioGroup::WriteMasks(0, leds.GetAllMask());
+#else
+    BenchLog("GPIO register writes: target only");
+#endif
+}
+
+//-----------------------------------------------------------------
+// LED bar output: on/off vs. LEDC PWM brightness-graded
+
+void BenchPwm()
+{
+    BenchLog("--- PWM: brightness-graded LED bar vs. on/off, resolution & update cost ---");
+
+    // bar duties: full LEDs below the level, fraction on the next, monotonic in level
+    const unsigned int kNumLeds = 5;
+    uint32_t duties[kNumLeds];
+    uint32_t prev_duties[kNumLeds] = {};
+    unsigned int num_bad = 0;
+    for( unsigned int value_q8=0; value_q8<=kNumLeds * 256; value_q8++ )
+    {
+        LedcBarDuties(value_q8, kNumLeds, duties);
+        for( unsigned int i=0; i<kNumLeds; i++ )
+        {
+            num_bad += (duties[i] < prev_duties[i]) || (duties[i] > kLedcMaxDuty);
+            num_bad += (value_q8 >= (i + 1) * 256) && (duties[i] != kLedcMaxDuty);
+            num_bad += (value_q8 <= i * 256) && (duties[i] != 0);
+            prev_duties[i] = duties[i];
+        }
+    }
+    BenchLog("LedcBarDuties(), %u levels: %s", kNumLeds * 256 + 1, (num_bad == 0) ? "ok" : "BAD");
+
+    // displayed vs. exact peak level per visualizer interval, in LEDs
+    struct Clip
+    {
+        const char *name;
+        const void *data;
+        unsigned int num_samples;
+        unsigned int bits_per_sample;
+        unsigned int samplerate;
+    };
+    const Clip clips[] = {
+        { "gameOverMan 8k/8",   gameOverManBuf, sizeof(gameOverManBuf), 8, 8000 },
+        { "surelyShirley 8k/8", surelyShirleyBuf, sizeof(surelyShirleyBuf), 8, 8000 },
+        { "viola 44k/16",       viola4416Buf, kViola44Len16, 16, 44100 },
+    };
+    for( const Clip & clip : clips )
+    {
+        VisualizerModel model(clip.data, clip.num_samples, clip.bits_per_sample, clip.samplerate, false);
+        double onoff_err = 0.0;
+        double pwm_err = 0.0;
+        unsigned int num_intervals = 0;
+        for( unsigned int end=model.interval; end<clip.num_samples + model.duration; end+=model.interval )
+        {
+            int start = (int)end - (int)model.duration;
+            int max_amp = 0;
+            for( int i=(start > 0) ? start : 0; (i<(int)end) && (i<(int)clip.num_samples); i++ )
+            {
+                int amp = abs(model.Sample(i) - model.dc_ofs);
+                max_amp = (amp > max_amp) ? amp : max_amp;
+            }
+            // on DacVisualizer::_CalcValueQ8()'s scale
+            double exact = (double)max_amp / model.iscale;
+            unsigned int value_q8 = (unsigned int)max_amp * 256 / model.iscale;
+            value_q8 = (value_q8 < kNumLeds * 256) ? value_q8 : kNumLeds * 256;
+            exact = (exact < kNumLeds) ? exact : kNumLeds;
+            onoff_err += fabs((value_q8 >> 8) - exact);
+            pwm_err += fabs(value_q8 / 256.0 - exact);
+            num_intervals++;
+        }
+        BenchLog("%-18s %u intervals: mean bar error %.3f LEDs on/off vs. %.3f LEDs PWM",
+                clip.name, num_intervals, onoff_err / num_intervals, pwm_err / num_intervals);
+    }
+
+#ifdef ARDUINO
+    // one bar update per call, as DacVisualizer::_VisualizeQ8(), sweeping the level up then down
+    const uint8_t kPins[kNumLeds] = { 16, 17, 18, 19, 21 };
+    LedcGroup pwm;
+    if( !pwm.Init(kPins, kNumLeds) )
+    {
+        BenchLog("LEDC setup failed");
+        return;
+    }
+    int value_q8 = 0;
+    int step = 37;
+    BenchRun("bar LEDC duties, changed only (per update)", 2000, 1, [&]() {
+        uint32_t bar[kNumLeds];
+        LedcBarDuties(value_q8, kNumLeds, bar);
+        pwm.Write(bar, 0);
+        value_q8 += step;
+        if( (value_q8 < 0) || (value_q8 > (int)kNumLeds * 256) )
+        {
+            step = -step;
+            value_q8 += 2 * step;
+        }
+    });
+    LedcBarDuties(0, kNumLeds, duties);
+    pwm.Write(duties, 0);
+    pwm.Detach();
+    GpioGroup leds(kPins, kNumLeds);
+    GpioGroup::WriteMasks(0, leds.GetAllMask());
+#else
+    BenchLog("LEDC update cost: target only");
+#endif
+}
+
+//-----------------------------------------------------------------
+
+// This runs on powerup
+// - put your setup code here, to run once:
+void setup()
+{
+#ifdef ARDUINO
+    Serial.begin(115200); // for serial link back to computer
+    SerialLog::Log(__FILE__);
+#endif
+
+    BenchBlockRender();
+    BenchStaticDac();
+    BenchSampleRing();
+    BenchDmaFiller();
+    BenchSampleClock();
+    BenchSampleConvert();
+    BenchResampler();
+    BenchMixer();
+    BenchAssetBank();
+    BenchAdpcm();
+    BenchCompanding();
+    BenchLz();
+    BenchSilence();
+    BenchClipCache();
+    BenchEnvelope();
+    BenchVisualizer();
+    BenchVu();
+    BenchFft();
+    BenchGpio();
+    BenchPwm();
+
+    BenchLog("DacBench done");
+}
+
+// Then this loop runs forever
+// - put your main code here, to run repeatedly:
+void loop()
+{
+}
+
+#ifndef ARDUINO
+int main()
+{
+    setup();
+    return 0;
+}
+#endif
+
+// vim: sw=4:ts=4
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+#ifdef ARDUINO
+#   include <Arduino.h>
+#   include <soc/gpio_reg.h>
+#endif
+
+// Single-register GPIO output writes
+// - a group of output pins updated with one write-1-to-set & one write-1-to-clear register store,
+// instead of a digitalWrite() (through the Arduino HAL) per pin
+//  - pins outside the group are untouched, the group's pins all change within two consecutive
+//  stores
+// - set/clear masks are plain bit ops on per-pin masks, callers precompute them for fixed patterns
+// (e.g. DacVisualizer's bar levels)
+// - GPIO0-31 only (the GPIO_OUT bank), which covers the output-capable pins but 32 & 33
+// - the mask helpers have no Arduino dependencies, the register writes are target only
+
+// Group of output pins
+// - bit i of a pattern drives pins[i]: 1 HIGH, 0 LOW
+class GpioGroup
+{
+public:
+    static const unsigned int kMaxPins = 8;
+
+    GpioGroup()
+    {
+        num_pins_ = 0;
+        all_mask_ = 0;
+    }
+
+    GpioGroup(const uint8_t *pins, unsigned int num_pins)
+    {
+        Init(pins, num_pins);
+    }
+
+    // Also sets the pins to OUTPUT, on target
+    void Init(const uint8_t *pins, unsigned int num_pins)
+    {
+        assert( num_pins <= kMaxPins );
+        num_pins_ = num_pins;
+        all_mask_ = 0;
+        for( unsigned int i=0; i<num_pins; i++ )
+        {
+            assert( pins[i] < 32 );
+            pin_masks_[i] = 1u << pins[i];
+            all_mask_ |= pin_masks_[i];
+#ifdef ARDUINO
+            pinMode(pins[i], OUTPUT);
+#endif
+        }
+    }
+
+    unsigned int GetNumPins() const
+    {
+        return num_pins_;
+    }
+
+    uint32_t GetPinMask(unsigned int idx) const
+    {
+        assert( idx < num_pins_ );
+        return pin_masks_[idx];
+    }
+
+    uint32_t GetAllMask() const
+    {
+        return all_mask_;
+    }
+
+    // Register masks for a pattern
+    void GetMasks(uint32_t pattern, uint32_t & set_mask, uint32_t & clear_mask) const
+    {
+        set_mask = 0;
+        for( unsigned int i=0; i<num_pins_; i++ )
+        {
+            if( pattern & (1u << i) )
+                set_mask |= pin_masks_[i];
+        }
+        clear_mask = all_mask_ & ~set_mask;
+    }
+
+#ifdef ARDUINO
+    void Write(uint32_t pattern) const
+    {
+        uint32_t set_mask;
+        uint32_t clear_mask;
+        GetMasks(pattern, set_mask, clear_mask);
+        WriteMasks(set_mask, clear_mask);
+    }
+
+    // Drive set_mask's pins HIGH, then clear_mask's LOW
+    static inline void WriteMasks(uint32_t set_mask, uint32_t clear_mask)
+    {
+        REG_WRITE(GPIO_OUT_W1TS_REG, set_mask);
+        REG_WRITE(GPIO_OUT_W1TC_REG, clear_mask);
+    }
+#endif
+
+private:
+    unsigned int num_pins_;
+    uint32_t all_mask_;
+    uint32_t pin_masks_[kMaxPins];
+};
+
+// vim: sw=4:ts=4
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+#ifdef ARDUINO
+#   include <Arduino.h>
+#   include <driver/ledc.h>
+#endif
+
+// LEDC PWM outputs
+// - a group of LED pins driven by LEDC channels, so each LED has a brightness rather than on/off
+// - falling duties fade in hardware (no CPU involvement once started), rising ones are immediate,
+// unchanged ones aren't touched
+//  - a fade must be done before its channel is written again (the driver waits for it otherwise),
+//  so callers keep fade_ms below their update interval
+// - uses the ESP-IDF LEDC driver directly (high speed channels, one timer, 10-bit duty at 5 kHz)
+// - the duty helpers have no Arduino dependencies, the driver calls are target only
+
+static const unsigned int kLedcDutyBits = 10;
+static const uint32_t kLedcMaxDuty = (1u << kLedcDutyBits) - 1;
+
+// Duty for a perceived brightness in [0, 256], gamma 2
+inline uint32_t LedcBrightnessDuty(unsigned int brightness_q8)
+{
+    if( brightness_q8 >= 256 )
+        return kLedcMaxDuty;
+    return (brightness_q8 * brightness_q8 * kLedcMaxDuty) >> 16;
+}
+
+// Duties for a bar of num_leds with a fractional top LED
+// - value_q8: bar level in 1/256 LEDs, clipped to num_leds * 256
+// - LEDs below the level fully on, the next one at the fraction's brightness, the rest off
+inline void LedcBarDuties(unsigned int value_q8, unsigned int num_leds, uint32_t *duties)
+{
+    for( unsigned int i=0; i<num_leds; i++ )
+    {
+        unsigned int led_q8 = i * 256;
+        duties[i] = (value_q8 <= led_q8) ? 0 : LedcBrightnessDuty(value_q8 - led_q8);
+    }
+}
+
+// Group of LEDC-driven pins
+// - pins[i] on channel first_channel + i
+class LedcGroup
+{
+public:
+    static const unsigned int kMaxPins = 8;
+    static const uint32_t kFreq_Hz = 5000;
+
+    LedcGroup()
+    {
+        num_pins_ = 0;
+    }
+
+#ifdef ARDUINO
+    static const ledc_mode_t kSpeedMode = LEDC_HIGH_SPEED_MODE;
+    static const ledc_timer_t kTimer = LEDC_TIMER_0;
+
+    // Route the pins to their channels, all off
+    // - returns false if the driver rejects the timer or a channel config (the group is then
+    // empty, ::Write() does nothing)
+    bool Init(const uint8_t *pins, unsigned int num_pins, unsigned int first_channel=0)
+    {
+        assert( (num_pins <= kMaxPins) && (first_channel + num_pins <= 8) );
+        num_pins_ = 0;
+        ledc_timer_config_t timer = {};
+        timer.speed_mode = kSpeedMode;
+        timer.duty_resolution = (ledc_timer_bit_t)kLedcDutyBits;
+        timer.timer_num = kTimer;
+        timer.freq_hz = kFreq_Hz;
+        if( ledc_timer_config(&timer) != ESP_OK )
+            return false;
+
+        first_channel_ = first_channel;
+        for( unsigned int i=0; i<num_pins; i++ )
+        {
+            pins_[i] = pins[i];
+            duties_[i] = 0;
+            ledc_channel_config_t channel = {};
+            channel.gpio_num = pins[i];
+            channel.speed_mode = kSpeedMode;
+            channel.channel = _Channel(i);
+            channel.intr_type = LEDC_INTR_DISABLE;
+            channel.timer_sel = kTimer;
+            channel.duty = 0;
+            channel.hpoint = 0;
+            if( ledc_channel_config(&channel) != ESP_OK )
+            {
+                Detach();
+                return false;
+            }
+            num_pins_ = i + 1;
+        }
+
+        // the fade service is shared by all groups, installed once
+        // - (ESP_ERR_INVALID_STATE: already installed by other code, usable as is)
+        static bool fade_installed = false;
+        if( !fade_installed )
+        {
+            esp_err_t err = ledc_fade_func_install(0);
+            if( (err != ESP_OK) && (err != ESP_ERR_INVALID_STATE) )
+            {
+                Detach();
+                return false;
+            }
+            fade_installed = true;
+        }
+        return true;
+    }
+
+    // Stop the channels & hand the pins back to plain GPIO (pinMode() them again to use them)
+    void Detach()
+    {
+        for( unsigned int i=0; i<num_pins_; i++ )
+        {
+            ledc_stop(kSpeedMode, _Channel(i), 0);
+            pinMatrixOutDetach(pins_[i], false, false);
+        }
+        num_pins_ = 0;
+    }
+
+    // One duty per pin, [0, kLedcMaxDuty]
+    void Write(const uint32_t *duties, unsigned int fade_ms)
+    {
+        for( unsigned int i=0; i<num_pins_; i++ )
+        {
+            uint32_t duty = duties[i];
+            if( duty == duties_[i] )
+                continue;
+            if( (duty < duties_[i]) && (fade_ms > 0) )
+            {
+                ledc_set_fade_with_time(kSpeedMode, _Channel(i), duty, fade_ms);
+                ledc_fade_start(kSpeedMode, _Channel(i), LEDC_FADE_NO_WAIT);
+            }
+            else
+            {
+                ledc_set_duty(kSpeedMode, _Channel(i), duty);
+                ledc_update_duty(kSpeedMode, _Channel(i));
+            }
+            duties_[i] = duty;
+        }
+    }
+#endif
+
+    unsigned int GetNumPins() const
+    {
+        return num_pins_;
+    }
+
+private:
+#ifdef ARDUINO
+    ledc_channel_t _Channel(unsigned int idx) const
+    {
+        return (ledc_channel_t)(first_channel_ + idx);
+    }
+#endif
+
+    unsigned int num_pins_;
+    unsigned int first_channel_;
+    uint8_t pins_[kMaxPins];
+    uint32_t duties_[kMaxPins];     // last written
+};
+
+// vim: sw=4:ts=4
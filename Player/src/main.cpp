@@ -11,72 +11,211 @@
 #include "../../LoopTimer/include/LoopTimer.h"
 #include "../../SerialLog/include/SerialLog.h"
 
+#include "../../DAC/include/AssetBank.h"
+#include "../../DAC/include/ClipSource.h"
+#include "../../DAC/include/ClipCache.h"
+#include "../../DAC/include/Envelope.h"
+
 //-----------------------------------------------------------------
 
+// Clip storage
+// - 0: PCM data files compiled into the sketch
+// - 1: clips read in place from an asset bank in the "assets" flash partition (see partitions.csv)
+//  - build the bank with AssetTool, e.g. from Player/src/data:
+//      AssetTool pack player.bank meepmeep=meepmeep.dat:8000:8 surely=surely.dat:8000:8 ...
+//  - append :adpcm, :ulaw, :alaw, :lz or :rle to a clip spec to store it compressed/companded/
+//  silence-trimmed (decoded as it plays)
+//  - and flash it to the partition: esptool.py write_flash 0x190000 player.bank
+//  - clips play through a ClipSource, so no visualization in this mode
+#define USE_ASSET_BANK (0)
+
+#if USE_ASSET_BANK
+//-----------------------------------
+// Clips by name, looked up in the bank in setup()
+AssetBank bank;
+const char *kClipNames[] =
+{
+    "meepmeep",
+    "surely",
+    "surelySerious",
+    "surelyShirley",
+    "sorryDave",
+    "pacman",
+    "gameOverMan",
+};
+const unsigned int kNumBufs = sizeof(kClipNames)/sizeof(kClipNames[0]);
+
+ClipSource bank_sources[kNumBufs];
+
+void LoadClips()
+{
+    bool ok = bank.OpenPartition("assets");
+    assert(ok);
+    for( unsigned int i=0; i<kNumBufs; i++ )
+    {
+        const AssetClipEntry *clip = bank.Find(kClipNames[i]);
+        assert(clip);
+        ok = bank_sources[i].SetClip(clip, bank.GetData(clip));
+        assert(ok);     // codec supported
+    }
+}
+#else
 //-----------------------------------
 // PCM data files
-uint8_t buf_meepmeep[] = {
+// - const, so they stay in flash and are played in place (see ClipView.h)
+const uint8_t buf_meepmeep[] = {
 #include "data/meepmeep.dat"
 };
-uint8_t buf_surely[] = {
+const uint8_t buf_surely[] = {
 #include "data/surely.dat"
 };
-uint8_t buf_surelySerious[] = {
+const uint8_t buf_surelySerious[] = {
 #include "data/surelySerious.dat"
 };
-uint8_t buf_surelyShirley[] = {
+const uint8_t buf_surelyShirley[] = {
 #include "data/surelyShirley.dat"
 };
-uint8_t buf_sorryDave[] = {
+const uint8_t buf_sorryDave[] = {
 #include "data/sorryDave.dat"
 };
-uint8_t buf_pacman[] = {
+const uint8_t buf_pacman[] = {
 #include "data/pacman.dat"
 };
-uint8_t buf_gameOverMan[] = {
+const uint8_t buf_gameOverMan[] = {
 #include "data/gameOverMan.dat"
 };
-const unsigned int kBitDepth = 8;
+
+//-----------------------------------
+// Envelope tracks for the visualizer, built along with the clips (see data/player.manifest)
+const uint8_t env_meepmeep[] = {
+#include "data/meepmeep.env.dat"
+};
+const uint8_t env_surely[] = {
+#include "data/surely.env.dat"
+};
+const uint8_t env_surelySerious[] = {
+#include "data/surelySerious.env.dat"
+};
+const uint8_t env_surelyShirley[] = {
+#include "data/surelyShirley.env.dat"
+};
+const uint8_t env_sorryDave[] = {
+#include "data/sorryDave.env.dat"
+};
+const uint8_t env_pacman[] = {
+#include "data/pacman.env.dat"
+};
+const uint8_t env_gameOverMan[] = {
+#include "data/gameOverMan.env.dat"
+};
 //-----------------------------------
 
-uint8_t *pcm_bufs[] =
+const ClipView kClips[] =
 {
-    buf_meepmeep,
-    buf_surely,
-    buf_surelySerious,
-    buf_surelyShirley,
-    buf_sorryDave,
-    buf_pacman,
-    buf_gameOverMan,
+    ClipView(buf_meepmeep, 8000),
+    ClipView(buf_surely, 8000),
+    ClipView(buf_surelySerious, 8000),
+    ClipView(buf_surelyShirley, 8000),
+    ClipView(buf_sorryDave, 8000),
+    ClipView(buf_pacman, 8000),
+    ClipView(buf_gameOverMan, 8000),
 };
 
-unsigned int pcm_buf_szs[] =
+const unsigned int kNumBufs = sizeof(kClips)/sizeof(kClips[0]);
+
+// Same order as kClips
+const EnvelopeTrack kEnvelopes[kNumBufs] =
 {
-    sizeof(buf_meepmeep),
-    sizeof(buf_surely),
-    sizeof(buf_surelySerious),
-    sizeof(buf_surelyShirley),
-    sizeof(buf_sorryDave),
-    sizeof(buf_pacman),
-    sizeof(buf_gameOverMan),
+    EnvelopeTrack(env_meepmeep, sizeof(env_meepmeep)),
+    EnvelopeTrack(env_surely, sizeof(env_surely)),
+    EnvelopeTrack(env_surelySerious, sizeof(env_surelySerious)),
+    EnvelopeTrack(env_surelyShirley, sizeof(env_surelyShirley)),
+    EnvelopeTrack(env_sorryDave, sizeof(env_sorryDave)),
+    EnvelopeTrack(env_pacman, sizeof(env_pacman)),
+    EnvelopeTrack(env_gameOverMan, sizeof(env_gameOverMan)),
 };
 
-const unsigned int kNumBufs = sizeof(pcm_buf_szs)/sizeof(pcm_buf_szs[0]);
+void LoadClips()
+{
+}
+#endif
 
 //-----------------------------------
 
 // Pick DAC variant to use
 // - only define one
-// - use of Dac or DacT will default to DAC1 pin output
+// - use of Dac, DacDMA or DacT will default to DAC1 pin output
 
 //#define DAC DacDS
+//#define DAC DacDSTask
+//#define DAC DacDMA
 //#define DAC DacT
 #define DAC Dac
 
+// Mixed playback
+// - clips play through a Mixer, so a button press starts the next clip on top of any that are
+// still playing rather than cutting them off
+// - no visualization in this mode since the DAC doesn't play a data buffer directly
+#define USE_MIXER (0)
+
+// Hot-clip RAM cache (compiled-in clips, unmixed playback)
+// - recently played clips are copied into internal RAM & played from there, so their sample
+// fetches don't wait on the flash cache
+// - hit/miss counts are logged every kNumBufs plays
+#define USE_CLIP_CACHE (0)
+
+// Visualizer mode
+// - Level: bar shows the window's peak
+// - Vu: bar shows the window's RMS in dB steps, with attack/release ballistics, steadier than the peak
+// - Spectrum: the LEDs show 5 log-spaced frequency bands (FFT of the samples at the play position)
+#define VISUALIZER_MODE VisualizerMode::Level
+//#define VISUALIZER_MODE VisualizerMode::Vu
+//#define VISUALIZER_MODE VisualizerMode::Spectrum
+
+// Visualizer output
+// - Gpio: LEDs on/off
+// - Pwm: LEDs dimmed by LEDC, the bar's top LED shows the fractional level, hardware fades on decay
+#define VISUALIZER_OUTPUT VisualizerOutput::Gpio
+//#define VISUALIZER_OUTPUT VisualizerOutput::Pwm
+
 //-----------------------------------
 
 DAC dac(8000, false /* looped */);
 DacVisualizer viz(&dac);
+#if USE_MIXER
+Mixer<4> mixer;
+ISampleSource *clip_sources[kNumBufs];
+
+void OnClipDone(int voice, void *arg)
+{
+    SerialLog::Log("clip done: " + String((int)(intptr_t)arg) + " (voice " + String(voice) + ")");
+}
+#elif USE_CLIP_CACHE && !USE_ASSET_BANK
+ClipCache clip_cache(32 * 1024);
+
+// Play a clip from its RAM copy if it's cached (or can be), from flash otherwise
+// - the previous clip stays pinned until the DAC has switched away from it
+void PlayCached(unsigned int index)
+{
+    static int playing = -1;    // pinned clip, if any
+    unsigned int cached_len;
+    const void *cached = clip_cache.Acquire(kClips[index], cached_len);
+    if( cached != nullptr )
+        dac.SetBuffer(cached, cached_len, kClips[index].GetBitsPerSample());
+    else
+        dac.SetBuffer(kClips[index]);
+    if( playing >= 0 )
+        clip_cache.Release(kClips[playing]);
+    playing = (cached != nullptr) ? (int)index : -1;
+
+    ClipCache::Stats stats = clip_cache.GetStats();
+    if( (stats.hits + stats.misses) % kNumBufs == 0 )
+    {
+        SerialLog::Log("clip cache: " + String(stats.hits) + " hits, " + String(stats.misses) + " misses, " +
+                String(stats.evictions) + " evictions, " + String((unsigned int)stats.bytes_used) + " bytes");
+    }
+}
+#endif
 Switch button_switch(T0); // Touch0 = GPIO04
 LoopTimer loop_timer;
 
@@ -87,6 +226,22 @@ void setup()
     Serial.begin(115200); // for serial link back to computer
     SerialLog::Log(__FILE__);
     pinMode(LED_BUILTIN, OUTPUT); // LED will follow switch state
+    LoadClips();
+    viz.SetMode(VISUALIZER_MODE);
+    viz.SetOutput(VISUALIZER_OUTPUT);
+
+#if USE_MIXER
+    for( unsigned int i=0; i<kNumBufs; i++ )
+    {
+#if USE_ASSET_BANK
+        clip_sources[i] = &bank_sources[i];
+#else
+        clip_sources[i] = new BufferSource(kClips[i]);
+#endif
+    }
+    dac.SetSource(&mixer);
+    dac.Restart();
+#endif
 }
 
 void loop()
@@ -124,9 +279,25 @@ void loop()
                 {
                     index++;
                     index = index % kNumBufs;
-                    dac.SetBuffer(pcm_bufs[index], pcm_buf_szs[index], kBitDepth);
+#if USE_MIXER
+                    // gain: leave headroom for overlapping clips
+                    if( mixer.Play(clip_sources[index], Mixer<4>::kUnityGain / 2, false, OnClipDone, (void *)(intptr_t)index) < 0 )
+                    {
+                        SerialLog::Log("clip still playing, or all voices busy");
+                    }
+#elif USE_ASSET_BANK
+                    bank_sources[index].Restart();
+                    dac.SetSource(&bank_sources[index]);
+                    dac.Restart();
+#elif USE_CLIP_CACHE
+                    PlayCached(index);
+                    dac.Restart();
+                    viz.Reset(&dac, &kEnvelopes[index]);
+#else
+                    dac.SetBuffer(kClips[index]);
                     dac.Restart();
-                    viz.Reset(&dac);
+                    viz.Reset(&dac, &kEnvelopes[index]);
+#endif
                     digitalWrite(LED_BUILTIN, LOW);
                     state = kLow;
                 }
@@ -135,7 +306,11 @@ void loop()
                 assert(false);  // Bad State
         };
         dac.Loop();
+#if USE_MIXER
+        mixer.Loop();
+#elif !USE_ASSET_BANK
         viz.Loop();
+#endif
     }
 }
 
@@ -66,9 +66,11 @@ SPKR   ▽     │      ┌───║BYPASS        IN-║
 
 // Pick DAC variant to use
 // - only define one
-// - use of Dac or DacT will default to DAC1 pin output
+// - use of Dac, DacDMA or DacT will default to DAC1 pin output
 
 //#define DAC DacDS
+//#define DAC DacDSTask
+//#define DAC DacDMA
 //#define DAC DacT
 #define DAC Dac
 
@@ -230,7 +232,7 @@ void loop() {
         prev_attempt = now;
     }
 
-    dac.Loop();
+    dac.Loop();     // no-op for task/timer-driven variants
     viz.Loop();
 }
 
@@ -0,0 +1,60 @@
+/*
+  AudioOutputRing
+  - streaming output sink for ESP8266SAM
+  - queues samples into a SampleRing that a DacT in streaming mode drains (see DacT::SetRing())
+  - ConsumeSample() returns false while the ring is full; ESP8266SAM retries (yielding) until
+  the DAC has made room, so playback overlaps with speech generation and memory use is bounded
+  by the ring capacity rather than the utterance length
+*/
+
+#ifndef _AUDIOOUTPUTRING_H
+#define _AUDIOOUTPUTRING_H
+
+#include "AudioOutput.h"
+#include "../../DAC/include/SampleRing.h"
+
+
+class AudioOutputRing : public AudioOutput
+{
+  public:
+    AudioOutputRing(SampleRing<uint8_t> *ring)
+      : ring_(ring)
+    {
+      assert(ring_);
+    }
+
+    virtual ~AudioOutputRing() override {}
+
+    virtual bool SetBitsPerSample(int bits) override
+    {
+      assert(bits == 8);    // TODO: extend support to 16 bits
+      return Super::SetBitsPerSample(bits);
+    }
+
+    virtual bool SetChannels(int channels) override
+    {
+      assert(channels == 1);    // Only supports 1 channel
+      return Super::SetChannels(channels);
+    }
+
+    virtual bool ConsumeSample(int16_t sample[2]) override
+    {
+      // clamp to 8-bit range
+      uint8_t samp8;
+      if( sample[LEFTCHANNEL] < 0 )
+          samp8 = 0;
+      else if( sample[LEFTCHANNEL] > 255 )
+          samp8 = 255;
+      else
+          samp8 = sample[LEFTCHANNEL];
+
+      // false => ring full, caller retries
+      return ring_->Push(samp8);
+    }
+
+  protected:
+    typedef AudioOutput Super;
+    SampleRing<uint8_t> *ring_;
+};
+
+#endif
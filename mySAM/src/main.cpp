@@ -2,6 +2,7 @@
 #include <ESP8266SAM.h>
 
 #include "AudioOutputMonoBuffer.h"
+#include "AudioOutputRing.h"
 #include "../../SerialLog/include/SerialLog.h"
 #include "../../LoopTimer/include/LoopTimer.h"
 #include "../../Switch/include/Switch.h"
@@ -12,18 +13,49 @@
 
 // Pick DAC variant to use
 // - only define one
-// - use of Dac or DacT will default to DAC1 pin output
+// - use of Dac, DacDMA or DacT will default to DAC1 pin output
 
 //#define DAC DacDS
+//#define DAC DacDSTask
+//#define DAC DacDMA
 //#define DAC DacT
 #define DAC Dac
 
+// Streaming playback
+// - SAM output is queued into a SampleRing that DacT drains from its timer callback
+// - playback starts as soon as SAM starts producing, and only needs a small ring rather than a
+// buffer for the whole phrase
+// - no visualization in this mode since there is no data buffer to inspect
+#define USE_STREAMING (0)
+
+#if USE_STREAMING
+#   undef DAC
+#   define DAC DacT
+#endif
+
+// Resampled playback
+// - SAM always generates 22050 Hz, which DacT can't sustain
+// - non-zero: SAM output is played through a Resampler at this DAC rate instead, e.g. 16000
+// - no visualization in this mode since the DAC doesn't play the data buffer directly
+#define RESAMPLE_RATE (0)
+
+#if RESAMPLE_RATE
+DAC dac(RESAMPLE_RATE, false /* looped */);
+BufferSource sam_source;
+Resampler resampler(&sam_source, 22050, RESAMPLE_RATE, ResampleQuality::Taps8);
+#else
 DAC dac(22050, false /* looped */);
+#endif
 DacVisualizer viz;
 LoopTimer loop_timer;
 Switch button_switch(T0); // Touch0 = GPIO04
 
+#if USE_STREAMING
+SampleRing<uint8_t> ring(8192);     // ~370 ms @ 22050 Hz
+AudioOutputRing *out = nullptr;
+#else
 AudioOutputMonoBuffer *out = nullptr;
+#endif
 ESP8266SAM *sam = nullptr;
 
 const ESP8266SAM::SAMVoice voices[] = {
@@ -55,7 +87,12 @@ void setup() {
     pinMode(LED_BUILTIN, OUTPUT); // LED will follow switch state
 
     // SAM generates 22050 Hz, 8 bit, 1 channel
+#if USE_STREAMING
+    out = new AudioOutputRing(&ring);
+    dac.SetRing(&ring);
+#else
     out = new AudioOutputMonoBuffer(90000 /* buffSizeSamples */);   // TODO: crappy that we need to set bufSz up front. Better if the TTS lib returned a buffer of appropriate size
+#endif
     out->begin();
     sam = new ESP8266SAM;
 }
@@ -108,7 +145,9 @@ void loop() {
                 if(button_switch.IsLow())
                 {
                     //digitalWrite(LED_BUILTIN, LOW);
+#if !USE_STREAMING
                     out->Reset();
+#endif
                     phrase_index++;
                     phrase_index = phrase_index % kNumPhrases;
                     if(phrase_index == 0)
@@ -123,6 +162,11 @@ void loop() {
                     SerialLog::Log("--------------------");
                     SerialLog::Log("Phrase: " + String(phrases[phrase_index]));
 
+#if USE_STREAMING
+                    // Blocks until the last of the phrase is queued, DacT plays it out meanwhile
+                    sam->Say(out, phrases[phrase_index]);
+                    SerialLog::Log("ring underruns: " + String(dac.GetNumUnderruns()));
+#else
                     // This is a blocking call, i.e. buffer is complete upon return
                     sam->Say(out, phrases[phrase_index]);
                     SerialLog::Log("buf Hz, bsp, #ch: " + String(out->hertz) + ", " + String(out->bps) + ", " + String(out->channels));
@@ -130,9 +174,17 @@ void loop() {
                     SerialLog::Log("buf ovrflw: " + String(out->GetNumBufOverflows()));
                     SerialLog::Log("sample range: " + String(out->min_val_) + " -> " + String(out->max_val_));
 
+#if RESAMPLE_RATE
+                    sam_source.SetBuffer(out->GetBuf(), out->GetBufUsed(), out->bps);
+                    resampler.Restart();
+                    dac.SetSource(&resampler);
+                    dac.Restart();
+#else
                     dac.SetBuffer(out->GetBuf(), out->GetBufUsed(), out->bps);
                     dac.Restart();
                     viz.Reset(&dac);
+#endif
+#endif
                     state = kLow;
                 }
                 break;